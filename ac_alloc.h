@@ -23,14 +23,24 @@ typedef struct ac_mem {
 typedef ac_mem (*ac_alloc_fn2)(void* state, size_t cap);
 typedef void (*ac_free_fn2)(void* state, ac_mem);
 
+// Resizes 'm' to 'cap' bytes, possibly in place, preserving its contents up to
+// the smaller of the two sizes. On failure, returns an empty mem and leaves 'm'
+// untouched. Alignment beyond the default isn't preserved.
+typedef ac_mem (*ac_realloc_fn2)(void* state, ac_mem m, size_t cap);
+
+// Allocates 'cap' bytes aligned to 'align' (a power of two). Freed with 'free'.
+typedef ac_mem (*ac_alloc_aligned_fn2)(void* state, size_t align, size_t cap);
+
 typedef struct ac_allocator2 {
   void* state;
   ac_alloc_fn2 alloc;
   ac_free_fn2 free;
+  ac_realloc_fn2 realloc;              // Optional.
+  ac_alloc_aligned_fn2 alloc_aligned;  // Optional.
 } ac_allocator2;
 
 static inline bool ac_allocator2_is_empty(ac_allocator2 a) {
-  return (!a.state && !a.alloc && !a.free);
+  return (!a.state && !a.alloc && !a.free && !a.realloc && !a.alloc_aligned);
 }
 
 static inline ac_mem ac_alloc2(ac_allocator2 a, size_t cap) {
@@ -42,6 +52,28 @@ static inline void ac_free2(ac_allocator2 a, ac_mem m) {
   if (a.free) a.free(a.state, m);
 }
 
+// Resizes 'm', in place if the allocator supports it. Otherwise allocates,
+// copies and frees. On failure, returns an empty mem and 'm' is untouched.
+static inline ac_mem ac_realloc2(ac_allocator2 a, ac_mem m, size_t cap) {
+  if (a.realloc) return a.realloc(a.state, m, cap);
+
+  const ac_mem ret = ac_alloc2(a, cap);
+  if (ret.data && m.data) {
+    memcpy(ret.data, m.data, m.cap < cap ? m.cap : cap);
+    ac_free2(a, m);
+  }
+  return ret;
+}
+
+// Allocates aligned memory. Falls back to 'alloc' for alignments it already
+// guarantees (max_align_t), otherwise fails if the allocator has no support.
+static inline ac_mem ac_alloc2_aligned(ac_allocator2 a, size_t align,
+                                       size_t cap) {
+  if (a.alloc_aligned) return a.alloc_aligned(a.state, align, cap);
+  if (align <= _Alignof(max_align_t)) return ac_alloc2(a, cap);
+  return (ac_mem){};
+}
+
 //------------------------------------------------------------------------------
 // Mallocation.
 //------------------------------------------------------------------------------
@@ -56,10 +88,31 @@ static inline void ac_sys_free(void* state, ac_mem m) {
   if (m.data) free(m.data);
 }
 
+static inline ac_mem ac_sys_realloc(void* state, ac_mem m, size_t cap) {
+  (void)state;
+  // Zero-size realloc may free 'm' and return NULL, which reads as failure.
+  void* data = realloc(m.data, cap ? cap : 1);
+  if (!data) return (ac_mem){};
+  return (ac_mem){data, cap};
+}
+
+static inline ac_mem ac_sys_aligned_alloc(void* state, size_t align,
+                                          size_t cap) {
+  (void)state;
+  if (align < sizeof(void*)) align = sizeof(void*);
+  // The size passed to aligned_alloc must be a multiple of the alignment.
+  const size_t size = (cap + align - 1) / align * align;
+  void* data = aligned_alloc(align, size ? size : align);
+  if (!data) return (ac_mem){};
+  return (ac_mem){data, size};
+}
+
 static inline ac_allocator2 ac_mallocator2() {
   return (ac_allocator2){
       .alloc = &ac_sys_malloc,
       .free = &ac_sys_free,
+      .realloc = &ac_sys_realloc,
+      .alloc_aligned = &ac_sys_aligned_alloc,
   };
 }
 
@@ -78,18 +131,22 @@ static inline ac_allocator2 ac_mallocator2() {
   }                                        \
   ac_lista(element_type)
 
-// Extract a 'mem' struct from a lista.
+// Extract a 'mem' struct from a lista. 'cap' is in bytes.
 #define ac_lista_mem(lista_ptr) \
-  (ac_mem) { (lista_ptr)->data, (lista_ptr)->cap }
+  (ac_mem) { (lista_ptr)->data, (lista_ptr)->cap * sizeof(*(lista_ptr)->data) }
 
-// Free the list memory. Nop if null.
-#define ac_lista_free(lista_ptr) \
-  ac_free2((lista_ptr)->alloc, ac_lista_mem(lista_ptr))
+// Free the list memory. Nop if null or inline.
+#define ac_lista_free(lista_ptr)  \
+  (ac_lista_is_inline_(lista_ptr) \
+       ? (void)0                  \
+       : ac_free2((lista_ptr)->alloc, ac_lista_mem(lista_ptr)))
 
 // Reallocate a lista, copying the range [0, len) to the new memory.
 // If the 'new_cap' is smaller than 'len', only [0, new_cap) items are retained.
 // If the list has no 'data' and no 'alloc', the mallocator is assigned.
 // However, if the list has 'data' but no 'alloc', this operation does nothing.
+// If the allocator has a 'realloc' hook, it's used to grow in place if it can.
+// Lists with inline storage use it whenever 'new_cap' fits, and never free it.
 #define ac_lista_realloc(lista_ptr, new_cap)                                \
   do {                                                                      \
     if (ac_allocator2_is_empty((lista_ptr)->alloc) && !(lista_ptr)->data) { \
@@ -98,19 +155,35 @@ static inline ac_allocator2 ac_mallocator2() {
                                                                             \
     ac_allocator2 alloc = (lista_ptr)->alloc;                               \
     const size_t element_size = sizeof(__typeof__(*(lista_ptr)->data));     \
-    void* const new_data = ac_alloc2(alloc, element_size * new_cap).data;   \
+    const size_t len = (lista_ptr)->len;                                    \
+    const size_t new_len = len < new_cap ? len : new_cap;                   \
+    const size_t inline_cap = ac_lista_inline_cap_(lista_ptr);              \
+    const bool was_inline = ac_lista_is_inline_(lista_ptr);                 \
+    const size_t copy_size = element_size * new_len;                        \
+    void* new_data = NULL;                                                  \
                                                                             \
-    if (new_data) {                                                         \
-      const size_t len = (lista_ptr)->len;                                  \
-      const size_t new_len = len < new_cap ? len : new_cap;                 \
-      const size_t copy_size = element_size * new_len;                      \
-      if (new_data && (lista_ptr)->data && copy_size) {                     \
-        memcpy(new_data, (lista_ptr)->data, copy_size);                     \
+    if (inline_cap && new_cap <= inline_cap) {                              \
+      new_data = ac_lista_inline_(lista_ptr);                               \
+      if (!was_inline && (lista_ptr)->data) {                               \
+        if (copy_size) memcpy(new_data, (lista_ptr)->data, copy_size);      \
+        ac_free2(alloc, ac_lista_mem(lista_ptr));                           \
+      }                                                                     \
+    } else if (alloc.realloc && (lista_ptr)->data && !was_inline) {         \
+      new_data = ac_realloc2(alloc, ac_lista_mem(lista_ptr),                \
+                             element_size * new_cap)                        \
+                     .data;                                                 \
+    } else {                                                                \
+      new_data = ac_alloc2(alloc, element_size * new_cap).data;             \
+      if (new_data && (lista_ptr)->data) {                                  \
+        if (copy_size) memcpy(new_data, (lista_ptr)->data, copy_size);      \
+        if (!was_inline) ac_free2(alloc, ac_lista_mem(lista_ptr));          \
       }                                                                     \
-      ac_free2(alloc, ac_lista_mem(lista_ptr));                             \
+    }                                                                       \
+                                                                            \
+    if (new_data) {                                                         \
       (lista_ptr)->data = new_data;                                         \
       (lista_ptr)->len = new_len;                                           \
-      (lista_ptr)->cap = new_cap;                                           \
+      (lista_ptr)->cap = new_cap <= inline_cap ? inline_cap : new_cap;      \
     }                                                                       \
   } while (false)
 
@@ -139,6 +212,58 @@ static inline ac_allocator2 ac_mallocator2() {
 // Uses default 2x geometric growth.
 #define ac_lista_next_ex(lista_ptr) ac_lista_next_exg(lista_ptr, 2, 0, 1)
 
+//------------------------------------------------------------------------------
+// Lists With Inline Storage.
+//------------------------------------------------------------------------------
+
+#define ac_lista_sbo(element_type, n) ac_lista_sbo_##element_type##_##n
+
+// A lista that keeps up to 'n' elements inside the struct, and only allocates
+// when it grows past them. It works with all the lista macros, and a
+// zero-initialized one starts inline on the first push.
+// NOTE: 'data' may point into the struct, so don't copy it by value.
+#define ac_lista_sbo_define_type(element_type, n) \
+  typedef struct ac_lista_sbo(element_type, n) {  \
+    ac_allocator2 alloc;                          \
+    element_type* data;                           \
+    size_t len;                                   \
+    size_t cap;                                   \
+    element_type small[n];                        \
+  }                                               \
+  ac_lista_sbo(element_type, n)
+
+// The fields every lista starts with.
+typedef struct ac_lista_header_ {
+  ac_allocator2 alloc;
+  void* data;
+  size_t len;
+  size_t cap;
+} ac_lista_header_;
+
+// Offset of the inline elements, which directly follow the lista fields.
+#define ac_lista_inline_offset_(lista_ptr)                         \
+  ({                                                               \
+    const size_t align = _Alignof(__typeof__(*(lista_ptr)->data)); \
+    (sizeof(ac_lista_header_) + align - 1) / align * align;        \
+  })
+
+#define ac_lista_inline_(lista_ptr) \
+  ((void*)((char*)(lista_ptr) + ac_lista_inline_offset_(lista_ptr)))
+
+// Number of elements that fit inline, zero for plain listas. Trailing padding
+// of the struct counts too.
+#define ac_lista_inline_cap_(lista_ptr)                                \
+  (sizeof(*(lista_ptr)) > ac_lista_inline_offset_(lista_ptr)           \
+       ? (sizeof(*(lista_ptr)) - ac_lista_inline_offset_(lista_ptr)) / \
+             sizeof(*(lista_ptr)->data)                                \
+       : 0)
+
+// Whether 'data' points at the inline storage. Always false for plain listas,
+// even if their memory happens to follow them.
+#define ac_lista_is_inline_(lista_ptr)    \
+  (ac_lista_inline_cap_(lista_ptr) > 0 && \
+   (void*)(lista_ptr)->data == ac_lista_inline_(lista_ptr))
+
 // All basic data types.
 ac_lista_define_type(float);
 ac_lista_define_type(double);
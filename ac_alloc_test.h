@@ -0,0 +1,237 @@
+#ifndef AC_ALLOC_TEST_H_
+#define AC_ALLOC_TEST_H_
+
+#include "ac_alloc.h"
+#include "ac_str.h"
+#include "ac_test.h"
+
+//------------------------------------------------------------------------------
+// Counting Allocator
+//------------------------------------------------------------------------------
+
+// Forwards to the mallocator, counting calls.
+typedef struct ac_alloc_test_counts {
+  size_t allocs;
+  size_t frees;
+  size_t reallocs;
+} ac_alloc_test_counts;
+
+static inline ac_mem ac_alloc_test_alloc_(void* state, size_t cap) {
+  ++((ac_alloc_test_counts*)state)->allocs;
+  return ac_sys_malloc(NULL, cap);
+}
+
+static inline void ac_alloc_test_free_(void* state, ac_mem m) {
+  ++((ac_alloc_test_counts*)state)->frees;
+  ac_sys_free(NULL, m);
+}
+
+static inline ac_mem ac_alloc_test_realloc_(void* state, ac_mem m, size_t cap) {
+  ++((ac_alloc_test_counts*)state)->reallocs;
+  return ac_sys_realloc(NULL, m, cap);
+}
+
+//------------------------------------------------------------------------------
+// Allocator Hooks
+//------------------------------------------------------------------------------
+
+static inline void lista_realloc_prefers_realloc_hook(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_alloc_test_counts counts = {};
+  ac_lista(int32_t) list = {.alloc = {
+                                .state = &counts,
+                                .alloc = &ac_alloc_test_alloc_,
+                                .free = &ac_alloc_test_free_,
+                                .realloc = &ac_alloc_test_realloc_,
+                            }};
+  for (int32_t i = 0; i < 1000; ++i) *ac_lista_next_ex(&list) = i;
+
+  bool items_ok = true;
+  for (int32_t i = 0; i < 1000; ++i) items_ok &= list.data[i] == i;
+  ac_test_expect(items_ok, "Items changed after growing.");
+
+  // First allocation, then only in-place growth.
+  ac_test_equ(counts.allocs, 1);
+  ac_test_equ(counts.frees, 0);
+  ac_test_equ(counts.reallocs, 10);
+
+  ac_lista_free(&list);
+  ac_test_equ(counts.frees, 1);
+}
+
+static inline void lista_realloc_without_hook_copies(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_alloc_test_counts counts = {};
+  ac_lista(int32_t) list = {.alloc = {
+                                .state = &counts,
+                                .alloc = &ac_alloc_test_alloc_,
+                                .free = &ac_alloc_test_free_,
+                            }};
+  for (int32_t i = 0; i < 1000; ++i) *ac_lista_next_ex(&list) = i;
+
+  bool items_ok = true;
+  for (int32_t i = 0; i < 1000; ++i) items_ok &= list.data[i] == i;
+  ac_test_expect(items_ok, "Items changed after growing.");
+
+  ac_test_equ(counts.allocs, 11);
+  ac_test_equ(counts.frees, 10);
+
+  ac_lista_realloc(&list, 10);
+  ac_test_equ(list.len, 10);
+  ac_test_equ(list.cap, 10);
+  ac_test_eqi(list.data[9], 9);
+
+  ac_lista_free(&list);
+}
+
+static inline void alloc2_aligned(ac_test_state* s) {
+  ac_test_begin(s);
+
+  const ac_allocator2 a = ac_mallocator2();
+  const size_t aligns[] = {8, 16, 64, 4096};
+  for (size_t i = 0; i < sizeof(aligns) / sizeof(*aligns); ++i) {
+    const ac_mem m = ac_alloc2_aligned(a, aligns[i], 100);
+    ac_test_neu((uintptr_t)m.data, 0);
+    ac_test_equ((uintptr_t)m.data % aligns[i], 0);
+    ac_test_geu(m.cap, 100);
+    ac_free2(a, m);
+  }
+
+  // Without an aligned hook, only natural alignment is available.
+  const ac_allocator2 plain = {.alloc = &ac_sys_malloc, .free = &ac_sys_free};
+  const ac_mem natural = ac_alloc2_aligned(plain, 16, 100);
+  ac_test_neu((uintptr_t)natural.data, 0);
+  ac_free2(plain, natural);
+  ac_test_equ((uintptr_t)ac_alloc2_aligned(plain, 64, 100).data, 0);
+}
+
+//------------------------------------------------------------------------------
+// Inline Storage
+//------------------------------------------------------------------------------
+
+ac_lista_sbo_define_type(int32_t, 8);
+
+static inline void lista_sbo_spills_on_overflow(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_alloc_test_counts counts = {};
+  ac_lista_sbo(int32_t, 8) list = {.alloc = {
+                                       .state = &counts,
+                                       .alloc = &ac_alloc_test_alloc_,
+                                       .free = &ac_alloc_test_free_,
+                                       .realloc = &ac_alloc_test_realloc_,
+                                   }};
+  for (int32_t i = 0; i < 8; ++i) *ac_lista_next_ex(&list) = i;
+  ac_test_expect(list.data == list.small, "Not inline.");
+  ac_test_equ(list.cap, 8);
+  ac_test_equ(counts.allocs, 0);
+
+  // Spilling copies, and the realloc hook never sees the inline storage.
+  for (int32_t i = 8; i < 100; ++i) *ac_lista_next_ex(&list) = i;
+  bool items_ok = true;
+  for (int32_t i = 0; i < 100; ++i) items_ok &= list.data[i] == i;
+  ac_test_expect(items_ok, "Items changed after spilling.");
+  ac_test_equ(counts.allocs, 1);
+  ac_test_equ(counts.frees, 0);
+
+  // Shrinking to fit moves back inline.
+  ac_lista_realloc(&list, 5);
+  ac_test_expect(list.data == list.small, "Not inline.");
+  ac_test_equ(list.len, 5);
+  ac_test_equ(list.cap, 8);
+  ac_test_eqi(list.data[4], 4);
+  ac_test_equ(counts.frees, 1);
+
+  ac_lista_free(&list);
+  ac_test_equ(counts.frees, 1);
+}
+
+// Counts calls without freeing, for memory the test owns.
+static inline void ac_alloc_test_count_free_(void* state, ac_mem m) {
+  (void)m;
+  ++((ac_alloc_test_counts*)state)->frees;
+}
+
+static inline ac_mem ac_alloc_test_count_realloc_(void* state, ac_mem m,
+                                                  size_t cap) {
+  ++((ac_alloc_test_counts*)state)->reallocs;
+  const ac_mem ret = ac_sys_malloc(NULL, cap);
+  if (ret.data) memcpy(ret.data, m.data, m.cap < cap ? m.cap : cap);
+  return ret;
+}
+
+static inline void lista_buffer_after_plain_lista_is_not_inline(
+    ac_test_state* s) {
+  ac_test_begin(s);
+
+  // A plain lista whose memory directly follows it, as allocators that pack
+  // blocks can hand out.
+  ac_alloc_test_counts counts = {};
+  struct {
+    ac_lista(int32_t) list;
+    int32_t buf[4];
+  } packed = {.list = {.alloc = {
+                           .state = &counts,
+                           .alloc = &ac_alloc_test_alloc_,
+                           .free = &ac_alloc_test_count_free_,
+                           .realloc = &ac_alloc_test_count_realloc_,
+                       }}};
+  packed.list.data = packed.buf;
+  packed.list.cap = 4;
+  for (int32_t i = 0; i < 5; ++i) *ac_lista_next_ex(&packed.list) = i;
+  ac_test_equ(counts.reallocs, 1);
+  ac_test_eqi(packed.list.data[4], 4);
+
+  // Free the grown buffer, then check the original one is freed too.
+  ac_sys_free(NULL, ac_lista_mem(&packed.list));
+  packed.list.data = packed.buf;
+  ac_lista_free(&packed.list);
+  ac_test_equ(counts.frees, 1);
+}
+
+static inline void str_small_spills_on_overflow(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_alloc_test_counts counts = {};
+  ac_str_small small;
+  ac_str* str = ac_str_small_init(&small, (ac_allocator2){
+                                              .state = &counts,
+                                              .alloc = &ac_alloc_test_alloc_,
+                                              .free = &ac_alloc_test_free_,
+                                          });
+  ac_test_equ(ac_to_str(str, "tag-%d", 42), 6);
+  ac_test_expect(!strcmp(str->data, "tag-42"), "Got '%s'.", str->data);
+  ac_test_equ(ac_to_str(str, "%024d", 0), 24);
+  ac_test_equ(str->len, 30);
+  ac_test_expect(str->data == small.small, "Not inline.");
+  ac_test_equ(counts.allocs, 0);
+
+  ac_test_equ(ac_to_str(str, "%s", "past the inline bytes"), 21);
+  ac_test_equ(str->len, 51);
+  ac_test_expect(!strncmp(str->data, "tag-42000", 9), "Got '%s'.", str->data);
+  ac_test_equ(counts.allocs, 1);
+  ac_test_equ(counts.frees, 0);
+  ac_str_free(str);
+  ac_test_equ(counts.frees, 1);
+
+  // Freeing without spilling is a nop.
+  str = ac_str_small_init(&small, (ac_allocator2){});
+  ac_to_str(str, "short");
+  ac_str_free(str);
+  ac_test_equ(str->len, 0);
+}
+
+// Entry point for all the rest of the tests.
+static inline void ac_alloc_test(ac_test_state* s) {
+  ac_test_begin(s);
+  ac_test_run(lista_realloc_prefers_realloc_hook);
+  ac_test_run(lista_realloc_without_hook_copies);
+  ac_test_run(alloc2_aligned);
+  ac_test_run(lista_sbo_spills_on_overflow);
+  ac_test_run(lista_buffer_after_plain_lista_is_not_inline);
+  ac_test_run(str_small_spills_on_overflow);
+}
+
+#endif  // AC_ALLOC_TEST_H_
@@ -0,0 +1,451 @@
+#ifndef AC_BITSET_H_
+#define AC_BITSET_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ac_alloc.h"
+#include "ac_mem.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+//------------------------------------------------------------------------------
+// Bit Sets.
+//------------------------------------------------------------------------------
+
+// A growable array of bits, packed 64 to a word, for flags over many items
+// (e.g. which rows are present or valid).
+//  - Bits past 'len' in the last word are always clear, so whole words can be
+//    counted and scanned without masking.
+//  - Boolean operations and popcount work on spans of words, with AVX2 or NEON
+//    where the compiler targets them.
+//  - Set bits are iterated with count-trailing-zeros, a word at a time.
+//  - An 'ac_bitset_index' answers rank queries in O(1) and select queries in
+//    O(log n), and must be rebuilt after the bits change.
+//
+//   ac_bitset bits = {};  // Or {.words.alloc = some_allocator}.
+//   ac_bitset_resize(&bits, 1000);
+//   ac_bitset_set(&bits, 42);
+//   size_t i;
+//   for (ac_bitset_iter it = ac_bitset_iter_init(&bits);
+//        ac_bitset_iter_next(&it, &i);) {
+//     use(i);
+//   }
+//   ac_bitset_free(&bits);
+
+typedef struct ac_bitset {
+  ac_lista(uint64_t) words;  // 'words.len' is the number of words in use.
+  size_t len;                // Number of bits.
+} ac_bitset;
+
+// Frees the bits.
+static inline void ac_bitset_free(ac_bitset*);
+
+// Sets the number of bits. New bits are clear. Returns false if allocation
+// failed, leaving the set as it was.
+static inline bool ac_bitset_resize(ac_bitset*, size_t len);
+
+// Appends a bit. Returns false if allocation failed.
+static inline bool ac_bitset_push(ac_bitset*, bool value);
+
+// The words holding the bits.
+static inline ac_span(uint64_t) ac_bitset_span(const ac_bitset* x) {
+  return (ac_span(uint64_t)){x->words.data, x->words.len};
+}
+
+static inline bool ac_bitset_get(const ac_bitset* x, size_t i) {
+  return (x->words.data[i / 64] >> (i % 64)) & 1;
+}
+
+static inline void ac_bitset_set(ac_bitset* x, size_t i) {
+  x->words.data[i / 64] |= 1ull << (i % 64);
+}
+
+static inline void ac_bitset_clear(ac_bitset* x, size_t i) {
+  x->words.data[i / 64] &= ~(1ull << (i % 64));
+}
+
+static inline void ac_bitset_put(ac_bitset* x, size_t i, bool value) {
+  uint64_t* word = &x->words.data[i / 64];
+  *word = (*word & ~(1ull << (i % 64))) | ((uint64_t)value << (i % 64));
+}
+
+// Sets or clears all bits.
+static inline void ac_bitset_fill(ac_bitset*, bool value);
+
+// Number of set bits.
+static inline size_t ac_bitset_count(const ac_bitset*);
+
+// Index of the first set bit at or after 'from', or 'len' if there is none.
+static inline size_t ac_bitset_next(const ac_bitset*, size_t from);
+
+// Boolean operations on words: dst = dst op src, over the shorter span.
+static inline void ac_bits_and(ac_span(uint64_t) dst, ac_span(uint64_t) src);
+static inline void ac_bits_or(ac_span(uint64_t) dst, ac_span(uint64_t) src);
+static inline void ac_bits_xor(ac_span(uint64_t) dst, ac_span(uint64_t) src);
+// dst = dst & ~src.
+static inline void ac_bits_andnot(ac_span(uint64_t) dst, ac_span(uint64_t) src);
+
+// Number of set bits in the words.
+static inline size_t ac_bits_popcount(ac_span(uint64_t));
+
+// Boolean operations on sets: dst = dst op src. 'dst' keeps its length, and
+// bits of 'src' past its length count as clear.
+static inline void ac_bitset_and(ac_bitset* dst, const ac_bitset* src);
+static inline void ac_bitset_or(ac_bitset* dst, const ac_bitset* src);
+static inline void ac_bitset_xor(ac_bitset* dst, const ac_bitset* src);
+static inline void ac_bitset_andnot(ac_bitset* dst, const ac_bitset* src);
+
+// Iterator over set bits, in order.
+typedef struct ac_bitset_iter {
+  const uint64_t* words;
+  size_t len;     // Number of words.
+  size_t word;    // Index of the current word.
+  uint64_t bits;  // Bits of the current word not visited yet.
+} ac_bitset_iter;
+
+static inline ac_bitset_iter ac_bitset_iter_init(const ac_bitset* x) {
+  return (ac_bitset_iter){
+      .words = x->words.data,
+      .len = x->words.len,
+      .bits = x->words.len ? x->words.data[0] : 0,
+  };
+}
+
+// Stores the index of the next set bit in '*i'. Returns false when done.
+static inline bool ac_bitset_iter_next(ac_bitset_iter* it, size_t* i) {
+  while (!it->bits) {
+    if (++it->word >= it->len) return false;
+    it->bits = it->words[it->word];
+  }
+  *i = it->word * 64 + __builtin_ctzll(it->bits);
+  it->bits &= it->bits - 1;
+  return true;
+}
+
+// Counts of set bits for rank and select queries. Per 512 bits, a word holds
+// the count before the block, and another the counts within the block before
+// each of its words 1 to 7, in 9 bits each.
+typedef struct ac_bitset_index {
+  ac_lista(uint64_t) blocks;
+  size_t ones;  // Number of set bits.
+} ac_bitset_index;
+
+// Builds the index, reusing its memory. Returns false if allocation failed.
+static inline bool ac_bitset_index_build(ac_bitset_index*, const ac_bitset*);
+
+static inline void ac_bitset_index_free(ac_bitset_index* x) {
+  ac_lista_free(&x->blocks);
+  *x = (ac_bitset_index){.blocks.alloc = x->blocks.alloc};
+}
+
+// Number of set bits before bit 'i', for i <= len.
+static inline size_t ac_bitset_rank(const ac_bitset_index*, const ac_bitset*,
+                                    size_t i);
+
+// Index of the set bit with rank 'k', or 'len' if k >= the number of set bits.
+static inline size_t ac_bitset_select(const ac_bitset_index*,
+                                      const ac_bitset*, size_t k);
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+static inline size_t ac_bitset_words_for_(size_t len) {
+  return (len + 63) / 64;
+}
+
+// Clears the bits past 'len' in the last word.
+static inline void ac_bitset_trim_(ac_bitset* x) {
+  if (x->len % 64) {
+    x->words.data[x->len / 64] &= (1ull << (x->len % 64)) - 1;
+  }
+}
+
+static inline void ac_bitset_free(ac_bitset* x) {
+  ac_lista_free(&x->words);
+  *x = (ac_bitset){.words.alloc = x->words.alloc};
+}
+
+static inline bool ac_bitset_resize(ac_bitset* x, size_t len) {
+  const size_t words = ac_bitset_words_for_(len);
+  if (words > x->words.cap) {
+    const size_t cap = x->words.cap * 2 > words ? x->words.cap * 2 : words;
+    ac_lista_realloc(&x->words, cap);
+    if (x->words.cap < cap) return false;
+  }
+  if (words > x->words.len) {
+    memset(x->words.data + x->words.len, 0,
+           (words - x->words.len) * sizeof(uint64_t));
+  }
+  x->words.len = words;
+  x->len = len;
+  ac_bitset_trim_(x);
+  return true;
+}
+
+static inline bool ac_bitset_push(ac_bitset* x, bool value) {
+  if (!ac_bitset_resize(x, x->len + 1)) return false;
+  if (value) ac_bitset_set(x, x->len - 1);
+  return true;
+}
+
+static inline void ac_bitset_fill(ac_bitset* x, bool value) {
+  if (!x->words.len) return;
+  memset(x->words.data, value ? 0xFF : 0, x->words.len * sizeof(uint64_t));
+  ac_bitset_trim_(x);
+}
+
+static inline size_t ac_bitset_count(const ac_bitset* x) {
+  return ac_bits_popcount(ac_bitset_span(x));
+}
+
+static inline size_t ac_bitset_next(const ac_bitset* x, size_t from) {
+  if (from >= x->len) return x->len;
+  size_t w = from / 64;
+  uint64_t bits = x->words.data[w] & (~0ull << (from % 64));
+  while (!bits) {
+    if (++w >= x->words.len) return x->len;
+    bits = x->words.data[w];
+  }
+  return w * 64 + __builtin_ctzll(bits);
+}
+
+// Vectors of words for the boolean operations.
+#if defined(__AVX2__)
+
+typedef __m256i ac_bits_vec_;
+enum { AC_BITS_VEC_WORDS_ = 4 };
+
+static inline ac_bits_vec_ ac_bits_load_(const uint64_t* p) {
+  return _mm256_loadu_si256((const __m256i*)p);
+}
+static inline void ac_bits_store_(uint64_t* p, ac_bits_vec_ v) {
+  _mm256_storeu_si256((__m256i*)p, v);
+}
+static inline ac_bits_vec_ ac_bits_vand_(ac_bits_vec_ a, ac_bits_vec_ b) {
+  return _mm256_and_si256(a, b);
+}
+static inline ac_bits_vec_ ac_bits_vor_(ac_bits_vec_ a, ac_bits_vec_ b) {
+  return _mm256_or_si256(a, b);
+}
+static inline ac_bits_vec_ ac_bits_vxor_(ac_bits_vec_ a, ac_bits_vec_ b) {
+  return _mm256_xor_si256(a, b);
+}
+static inline ac_bits_vec_ ac_bits_vandnot_(ac_bits_vec_ a, ac_bits_vec_ b) {
+  return _mm256_andnot_si256(b, a);
+}
+
+#elif defined(__ARM_NEON)
+
+typedef uint64x2_t ac_bits_vec_;
+enum { AC_BITS_VEC_WORDS_ = 2 };
+
+static inline ac_bits_vec_ ac_bits_load_(const uint64_t* p) {
+  return vld1q_u64(p);
+}
+static inline void ac_bits_store_(uint64_t* p, ac_bits_vec_ v) {
+  vst1q_u64(p, v);
+}
+static inline ac_bits_vec_ ac_bits_vand_(ac_bits_vec_ a, ac_bits_vec_ b) {
+  return vandq_u64(a, b);
+}
+static inline ac_bits_vec_ ac_bits_vor_(ac_bits_vec_ a, ac_bits_vec_ b) {
+  return vorrq_u64(a, b);
+}
+static inline ac_bits_vec_ ac_bits_vxor_(ac_bits_vec_ a, ac_bits_vec_ b) {
+  return veorq_u64(a, b);
+}
+static inline ac_bits_vec_ ac_bits_vandnot_(ac_bits_vec_ a, ac_bits_vec_ b) {
+  return vbicq_u64(a, b);
+}
+
+#else
+
+typedef uint64_t ac_bits_vec_;
+enum { AC_BITS_VEC_WORDS_ = 1 };
+
+static inline ac_bits_vec_ ac_bits_load_(const uint64_t* p) { return *p; }
+static inline void ac_bits_store_(uint64_t* p, ac_bits_vec_ v) { *p = v; }
+static inline ac_bits_vec_ ac_bits_vand_(ac_bits_vec_ a, ac_bits_vec_ b) {
+  return a & b;
+}
+static inline ac_bits_vec_ ac_bits_vor_(ac_bits_vec_ a, ac_bits_vec_ b) {
+  return a | b;
+}
+static inline ac_bits_vec_ ac_bits_vxor_(ac_bits_vec_ a, ac_bits_vec_ b) {
+  return a ^ b;
+}
+static inline ac_bits_vec_ ac_bits_vandnot_(ac_bits_vec_ a, ac_bits_vec_ b) {
+  return a & ~b;
+}
+
+#endif
+
+// Defines 'ac_bits_<op>' with a vector loop, and a scalar one for the rest.
+#define ac_bits_define_op_(op, scalar_expr)                        \
+  static inline void ac_bits_##op(ac_span(uint64_t) dst,           \
+                                  ac_span(uint64_t) src) {         \
+    const size_t n = dst.len < src.len ? dst.len : src.len;        \
+    size_t i = 0;                                                  \
+    for (; i + AC_BITS_VEC_WORDS_ <= n; i += AC_BITS_VEC_WORDS_) { \
+      const ac_bits_vec_ a = ac_bits_load_(dst.data + i);          \
+      const ac_bits_vec_ b = ac_bits_load_(src.data + i);          \
+      ac_bits_store_(dst.data + i, ac_bits_v##op##_(a, b));        \
+    }                                                              \
+    for (; i < n; ++i) {                                           \
+      const uint64_t a = dst.data[i], b = src.data[i];             \
+      dst.data[i] = scalar_expr;                                   \
+    }                                                              \
+  }
+
+ac_bits_define_op_(and, a & b);
+ac_bits_define_op_(or, a | b);
+ac_bits_define_op_(xor, a ^ b);
+ac_bits_define_op_(andnot, a & ~b);
+
+#undef ac_bits_define_op_
+
+static inline size_t ac_bits_popcount(ac_span(uint64_t) words) {
+  const uint64_t* p = words.data;
+  size_t n = words.len, count = 0;
+#if defined(__AVX2__)
+  // Looks up the counts of both nibbles of each byte, then sums bytes in
+  // groups of 8 (Mula's method).
+  const __m256i lookup =
+      _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1,
+                       1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low = _mm256_set1_epi8(0x0F);
+  __m256i acc = _mm256_setzero_si256();
+  for (; n >= 4; n -= 4, p += 4) {
+    const __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    const __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low));
+    const __m256i hi = _mm256_shuffle_epi8(
+        lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+    acc = _mm256_add_epi64(
+        acc, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+  }
+  count += _mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1) +
+           _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3);
+#elif defined(__ARM_NEON)
+  uint64x2_t acc = vdupq_n_u64(0);
+  for (; n >= 2; n -= 2, p += 2) {
+    const uint8x16_t bytes = vcntq_u8(vreinterpretq_u8_u64(vld1q_u64(p)));
+    acc = vpadalq_u32(acc, vpaddlq_u16(vpaddlq_u8(bytes)));
+  }
+  count += vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1);
+#endif
+  for (; n; --n, ++p) count += __builtin_popcountll(*p);
+  return count;
+}
+
+static inline void ac_bitset_and(ac_bitset* dst, const ac_bitset* src) {
+  ac_bits_and(ac_bitset_span(dst), ac_bitset_span(src));
+  if (dst->words.len > src->words.len) {
+    memset(dst->words.data + src->words.len, 0,
+           (dst->words.len - src->words.len) * sizeof(uint64_t));
+  }
+}
+
+static inline void ac_bitset_or(ac_bitset* dst, const ac_bitset* src) {
+  ac_bits_or(ac_bitset_span(dst), ac_bitset_span(src));
+  ac_bitset_trim_(dst);
+}
+
+static inline void ac_bitset_xor(ac_bitset* dst, const ac_bitset* src) {
+  ac_bits_xor(ac_bitset_span(dst), ac_bitset_span(src));
+  ac_bitset_trim_(dst);
+}
+
+static inline void ac_bitset_andnot(ac_bitset* dst, const ac_bitset* src) {
+  ac_bits_andnot(ac_bitset_span(dst), ac_bitset_span(src));
+}
+
+static inline bool ac_bitset_index_build(ac_bitset_index* x,
+                                         const ac_bitset* bits) {
+  const size_t blocks = (bits->words.len + 7) / 8;
+  if (x->blocks.cap < 2 * blocks) {
+    ac_lista_realloc(&x->blocks, 2 * blocks);
+    if (x->blocks.cap < 2 * blocks) return false;
+  }
+  x->blocks.len = 2 * blocks;
+
+  size_t ones = 0;
+  for (size_t b = 0; b < blocks; ++b) {
+    const uint64_t* words = bits->words.data + b * 8;
+    const size_t n = bits->words.len - b * 8 < 8 ? bits->words.len - b * 8 : 8;
+    uint64_t within = 0, counts = 0;
+    for (size_t w = 0; w < n; ++w) {
+      if (w) counts |= within << (9 * (w - 1));
+      within += __builtin_popcountll(words[w]);
+    }
+    // Words past the end count as empty, for 'ac_bitset_select'.
+    for (size_t w = n ? n : 1; w < 8; ++w) counts |= within << (9 * (w - 1));
+    x->blocks.data[2 * b] = ones;
+    x->blocks.data[2 * b + 1] = counts;
+    ones += within;
+  }
+  x->ones = ones;
+  return true;
+}
+
+// Set bits in the block before its word 'w'.
+static inline size_t ac_bitset_index_within_(const ac_bitset_index* x,
+                                             size_t block, size_t w) {
+  return w ? (x->blocks.data[2 * block + 1] >> (9 * (w - 1))) & 0x1FF : 0;
+}
+
+static inline size_t ac_bitset_rank(const ac_bitset_index* x,
+                                    const ac_bitset* bits, size_t i) {
+  const size_t w = i / 64;
+  if (w >= bits->words.len) return x->ones;
+  const uint64_t before = bits->words.data[w] & ((1ull << (i % 64)) - 1);
+  return x->blocks.data[2 * (w / 8)] +
+         ac_bitset_index_within_(x, w / 8, w % 8) +
+         __builtin_popcountll(before);
+}
+
+// Index of the set bit of rank 'k' in a word.
+static inline size_t ac_bitset_select_word_(uint64_t word, size_t k) {
+#if defined(__BMI2__)
+  return __builtin_ctzll(_pdep_u64(1ull << k, word));
+#else
+  for (; k; --k) word &= word - 1;
+  return __builtin_ctzll(word);
+#endif
+}
+
+static inline size_t ac_bitset_select(const ac_bitset_index* x,
+                                      const ac_bitset* bits, size_t k) {
+  if (k >= x->ones) return bits->len;
+
+  // The last block with fewer than 'k' set bits before it.
+  size_t lo = 0, hi = x->blocks.len / 2;
+  while (hi - lo > 1) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (x->blocks.data[2 * mid] <= k) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  k -= x->blocks.data[2 * lo];
+
+  size_t w = 0;
+  while (w < 7 && ac_bitset_index_within_(x, lo, w + 1) <= k) ++w;
+  k -= ac_bitset_index_within_(x, lo, w);
+  return (lo * 8 + w) * 64 +
+         ac_bitset_select_word_(bits->words.data[lo * 8 + w], k);
+}
+
+#endif  // AC_BITSET_H_
@@ -0,0 +1,189 @@
+#ifndef AC_BITSET_TEST_H_
+#define AC_BITSET_TEST_H_
+
+#include <stdint.h>
+
+#include "ac_bitset.h"
+#include "ac_test.h"
+
+//------------------------------------------------------------------------------
+// Bit Sets
+//------------------------------------------------------------------------------
+
+// Deterministic pseudo-random bits, set with probability 'percent' / 100.
+static inline bool ac_bitset_test_bit_(size_t i, uint64_t seed, int percent) {
+  uint64_t h = (i + 1) * 0x9E3779B97F4A7C15ull ^ seed;
+  h ^= h >> 29;
+  h *= 0xBF58476D1CE4E5B9ull;
+  h ^= h >> 32;
+  return (int)(h % 100) < percent;
+}
+
+static inline void bitset_basics(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_bitset x = {};
+  ac_test_expect(ac_bitset_resize(&x, 130), "Resize failed.");
+  ac_test_equ(x.words.len, 3);
+  ac_test_equ(ac_bitset_count(&x), 0);
+  ac_test_equ(ac_bitset_next(&x, 0), 130);
+
+  ac_bitset_set(&x, 0);
+  ac_bitset_set(&x, 64);
+  ac_bitset_put(&x, 129, true);
+  ac_bitset_put(&x, 5, false);
+  ac_test_expect(ac_bitset_get(&x, 64) && !ac_bitset_get(&x, 63), "Get.");
+  ac_test_equ(ac_bitset_count(&x), 3);
+  ac_test_equ(ac_bitset_next(&x, 0), 0);
+  ac_test_equ(ac_bitset_next(&x, 1), 64);
+  ac_test_equ(ac_bitset_next(&x, 65), 129);
+  ac_test_equ(ac_bitset_next(&x, 130), 130);
+  ac_bitset_clear(&x, 64);
+  ac_test_equ(ac_bitset_next(&x, 1), 129);
+
+  // Shrinking drops bits, which stay clear when growing back.
+  ac_test_expect(ac_bitset_resize(&x, 100), "Resize failed.");
+  ac_test_equ(ac_bitset_count(&x), 1);
+  ac_test_expect(ac_bitset_resize(&x, 200), "Resize failed.");
+  ac_test_equ(ac_bitset_count(&x), 1);
+
+  ac_bitset_fill(&x, true);
+  ac_test_equ(ac_bitset_count(&x), 200);
+  ac_test_equ(x.words.data[3], (1ull << 8) - 1);
+  ac_bitset_fill(&x, false);
+  ac_test_equ(ac_bitset_count(&x), 0);
+
+  for (size_t i = 0; i < 1000; ++i) {
+    ac_test_expect(ac_bitset_push(&x, i % 3 == 0), "Push failed.");
+  }
+  ac_test_equ(x.len, 1200);
+  ac_test_equ(ac_bitset_count(&x), 334);
+
+  ac_bitset_free(&x);
+  ac_test_equ(x.len, 0);
+}
+
+static inline void bitset_boolean_ops(ac_test_state* s) {
+  ac_test_begin(s);
+
+  // Odd lengths exercise the vector loops and the scalar tails.
+  enum { A_LEN = 1000, B_LEN = 777 };
+  ac_bitset a = {}, b = {}, x = {};
+  ac_test_expect(ac_bitset_resize(&a, A_LEN) && ac_bitset_resize(&b, B_LEN),
+                 "Resize failed.");
+  for (size_t i = 0; i < A_LEN; ++i) {
+    ac_bitset_put(&a, i, ac_bitset_test_bit_(i, 1, 50));
+  }
+  for (size_t i = 0; i < B_LEN; ++i) {
+    ac_bitset_put(&b, i, ac_bitset_test_bit_(i, 2, 30));
+  }
+
+  for (int op = 0; op < 4; ++op) {
+    ac_test_expect(ac_bitset_resize(&x, A_LEN), "Resize failed.");
+    memcpy(x.words.data, a.words.data, a.words.len * sizeof(uint64_t));
+    if (op == 0) ac_bitset_and(&x, &b);
+    if (op == 1) ac_bitset_or(&x, &b);
+    if (op == 2) ac_bitset_xor(&x, &b);
+    if (op == 3) ac_bitset_andnot(&x, &b);
+
+    size_t mismatches = 0, count = 0;
+    for (size_t i = 0; i < A_LEN; ++i) {
+      const bool va = ac_bitset_get(&a, i);
+      const bool vb = i < B_LEN && ac_bitset_get(&b, i);
+      const bool want = op == 0   ? va && vb
+                        : op == 1 ? va || vb
+                        : op == 2 ? va != vb
+                                  : va && !vb;
+      mismatches += ac_bitset_get(&x, i) != want;
+      count += want;
+    }
+    ac_test_expect(!mismatches, "Op %d: %zu wrong bits.", op, mismatches);
+    ac_test_equ(ac_bitset_count(&x), count);
+  }
+
+  // A longer source doesn't set bits past the end.
+  ac_bitset_fill(&b, true);
+  ac_test_expect(ac_bitset_resize(&x, 100), "Resize failed.");
+  ac_bitset_or(&x, &b);
+  ac_test_equ(ac_bitset_count(&x), 100);
+
+  ac_bitset_free(&a);
+  ac_bitset_free(&b);
+  ac_bitset_free(&x);
+}
+
+static inline void bitset_iterates_set_bits(ac_test_state* s) {
+  ac_test_begin(s);
+
+  enum { LEN = 3000 };
+  ac_bitset x = {};
+  ac_test_expect(ac_bitset_resize(&x, LEN), "Resize failed.");
+  for (size_t i = 0; i < LEN; ++i) {
+    // Long gaps and dense stretches.
+    if (i / 500 % 2 && ac_bitset_test_bit_(i, 3, 40)) ac_bitset_set(&x, i);
+  }
+
+  size_t i = 0, visited = 0, next = ac_bitset_next(&x, 0);
+  bool in_order = true;
+  for (ac_bitset_iter it = ac_bitset_iter_init(&x);
+       ac_bitset_iter_next(&it, &i);) {
+    in_order &= i == next;
+    next = ac_bitset_next(&x, i + 1);
+    ++visited;
+  }
+  ac_test_expect(in_order, "Iteration and 'next' disagree.");
+  ac_test_equ(next, LEN);
+  ac_test_equ(visited, ac_bitset_count(&x));
+
+  ac_bitset empty = {};
+  ac_bitset_iter it = ac_bitset_iter_init(&empty);
+  ac_test_expect(!ac_bitset_iter_next(&it, &i), "Empty set has bits.");
+
+  ac_bitset_free(&x);
+}
+
+static inline void bitset_rank_select(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_bitset x = {};
+  ac_bitset_index index = {};
+  const size_t lens[] = {0, 1, 63, 64, 511, 512, 513, 5000};
+  const int densities[] = {0, 3, 50, 100};
+  for (size_t l = 0; l < sizeof(lens) / sizeof(*lens); ++l) {
+    for (size_t d = 0; d < sizeof(densities) / sizeof(*densities); ++d) {
+      const size_t len = lens[l];
+      ac_test_expect(ac_bitset_resize(&x, len), "Resize failed.");
+      for (size_t i = 0; i < len; ++i) {
+        ac_bitset_put(&x, i, ac_bitset_test_bit_(i, len, densities[d]));
+      }
+      ac_test_expect(ac_bitset_index_build(&index, &x), "Build failed.");
+      ac_test_equ(index.ones, ac_bitset_count(&x));
+
+      size_t rank = 0, bad_rank = 0, bad_select = 0;
+      for (size_t i = 0; i < len; ++i) {
+        bad_rank += ac_bitset_rank(&index, &x, i) != rank;
+        if (ac_bitset_get(&x, i)) {
+          bad_select += ac_bitset_select(&index, &x, rank) != i;
+          ++rank;
+        }
+      }
+      ac_test_expect(!bad_rank && !bad_select,
+                     "Len %zu, density %d: %zu bad ranks, %zu bad selects.",
+                     len, densities[d], bad_rank, bad_select);
+      ac_test_equ(ac_bitset_rank(&index, &x, len), rank);
+      ac_test_equ(ac_bitset_select(&index, &x, rank), len);
+    }
+  }
+  ac_bitset_index_free(&index);
+  ac_bitset_free(&x);
+}
+
+static inline void ac_bitset_test(ac_test_state* s) {
+  ac_test_begin(s);
+  ac_test_run(bitset_basics);
+  ac_test_run(bitset_boolean_ops);
+  ac_test_run(bitset_iterates_set_bits);
+  ac_test_run(bitset_rank_select);
+}
+
+#endif  // AC_BITSET_TEST_H_
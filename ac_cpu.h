@@ -0,0 +1,280 @@
+#ifndef AC_CPU_H_
+#define AC_CPU_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
+
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
+//------------------------------------------------------------------------------
+// CPU Features.
+//------------------------------------------------------------------------------
+
+// What the CPU running the program supports, detected once on first use:
+//  - x86: cpuid, checking that the OS saves the AVX and AVX-512 registers.
+//  - ARM: getauxval on Linux, otherwise what the compiler targets. Apple's
+//    ARM CPUs all support NEON, PMULL and CRC.
+//  - Caches: sysfs on Linux, sysctl on macOS.
+// Kernels compiled for several targets (e.g. with target attributes) pick one
+// at startup with 'ac_cpu_dispatch'.
+// Define AC_CPU_IMPL in exactly one source file before including this header,
+// so the whole program shares one detected 'ac_cpu_info'.
+
+// Feature flags.
+enum {
+  AC_CPU_SSE42 = 1u << 0,   // SSE4.2 and POPCNT.
+  AC_CPU_PCLMUL = 1u << 1,  // Carry-less multiply.
+  AC_CPU_AVX2 = 1u << 2,    // AVX2 and FMA.
+  AC_CPU_BMI2 = 1u << 3,    // BMI1 and BMI2.
+  AC_CPU_AVX512 = 1u << 4,  // AVX-512 F, BW and VL.
+  AC_CPU_NEON = 1u << 5,    // Advanced SIMD.
+  AC_CPU_PMULL = 1u << 6,   // 64-bit polynomial multiply.
+  AC_CPU_CRC32 = 1u << 7,   // CRC32 instructions.
+};
+
+// CPU description. Sizes are in bytes, 0 if unknown.
+typedef struct ac_cpu_info {
+  uint32_t features;  // AC_CPU_* flags.
+  size_t cpus;        // Logical CPUs online, at least 1.
+  size_t line_size;   // Cache line size.
+  size_t l1d_size;    // Per core.
+  size_t l2_size;
+  size_t l3_size;  // Usually shared by many cores.
+} ac_cpu_info;
+
+// The CPU running the program.
+const ac_cpu_info* ac_cpu();
+
+// True if the CPU supports all the 'features'.
+static inline bool ac_cpu_has(uint32_t features) {
+  return (ac_cpu()->features & features) == features;
+}
+
+// Name of a single feature flag, e.g. "avx2".
+static inline const char* ac_cpu_feature_name(uint32_t feature);
+
+// One implementation of a kernel and the features it needs.
+typedef struct ac_cpu_impl {
+  uint32_t features;
+  void (*fn)(void);
+} ac_cpu_impl;
+
+// Returns the first implementation whose features are all in 'features', or
+// NULL. List the fastest first and end with a portable one.
+static inline void (*ac_cpu_pick(uint32_t features, const ac_cpu_impl* impls,
+                                 size_t count))(void);
+
+// Picks the best implementation for this CPU, cast to 'fn_type', e.g.
+//   crc_fn* crc = ac_cpu_dispatch(crc_fn*,
+//                                 {AC_CPU_PCLMUL, (void (*)(void))crc_clmul},
+//                                 {0, (void (*)(void))crc_table});
+// Store the result rather than dispatching on every call.
+#define ac_cpu_dispatch(fn_type, ...)                              \
+  ((fn_type)ac_cpu_pick(ac_cpu()->features,                        \
+                        (const ac_cpu_impl[]){__VA_ARGS__},        \
+                        sizeof((const ac_cpu_impl[]){__VA_ARGS__}) \
+                            / sizeof(ac_cpu_impl)))
+
+//------------------------------------------------------------------------------
+// Static Inline Implementation
+//------------------------------------------------------------------------------
+
+static inline const char* ac_cpu_feature_name(uint32_t feature) {
+  switch (feature) {
+    case AC_CPU_SSE42: return "sse4.2";
+    case AC_CPU_PCLMUL: return "pclmul";
+    case AC_CPU_AVX2: return "avx2";
+    case AC_CPU_BMI2: return "bmi2";
+    case AC_CPU_AVX512: return "avx512";
+    case AC_CPU_NEON: return "neon";
+    case AC_CPU_PMULL: return "pmull";
+    case AC_CPU_CRC32: return "crc32";
+    default: return "unknown";
+  }
+}
+
+static inline void (*ac_cpu_pick(uint32_t features, const ac_cpu_impl* impls,
+                                 size_t count))(void) {
+  for (size_t i = 0; i < count; ++i) {
+    if ((features & impls[i].features) == impls[i].features) {
+      return impls[i].fn;
+    }
+  }
+  return NULL;
+}
+
+#endif  // AC_CPU_H_
+
+//------------------------------------------------------------------------------
+// Non-Static Implementation
+//------------------------------------------------------------------------------
+
+#if defined(AC_CPU_IMPL)
+#ifndef AC_CPU_H_IMPL_
+#define AC_CPU_H_IMPL_
+
+#if defined(__x86_64__) || defined(__i386__)  //----------- X86 ---------------
+
+// The register state the OS saves on context switches.
+static inline uint64_t ac_cpu_xgetbv_() {
+  uint32_t lo, hi;
+  __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint32_t ac_cpu_detect_features_() {
+  unsigned a, b, c, d;
+  if (!__get_cpuid(1, &a, &b, &c, &d)) return 0;
+  uint32_t features = 0;
+  if ((c & bit_SSE4_2) && (c & bit_POPCNT)) features |= AC_CPU_SSE42;
+  if (c & bit_PCLMUL) features |= AC_CPU_PCLMUL;
+  const bool fma = c & bit_FMA;
+  // AVX needs the OS to save the YMM (and for AVX-512, ZMM) registers.
+  uint64_t xcr0 = 0;
+  if ((c & bit_OSXSAVE) && (c & bit_AVX)) xcr0 = ac_cpu_xgetbv_();
+  const bool ymm = (xcr0 & 0x6) == 0x6;
+  const bool zmm = (xcr0 & 0xE6) == 0xE6;
+
+  if (!__get_cpuid_count(7, 0, &a, &b, &c, &d)) return features;
+  if (ymm && fma && (b & bit_AVX2)) features |= AC_CPU_AVX2;
+  if ((b & bit_BMI) && (b & bit_BMI2)) features |= AC_CPU_BMI2;
+  const unsigned avx512 = bit_AVX512F | bit_AVX512BW | bit_AVX512VL;
+  if (zmm && (b & avx512) == avx512) features |= AC_CPU_AVX512;
+  return features;
+}
+
+#elif defined(__aarch64__)  //------------------- ARM --------------------------
+
+static inline uint32_t ac_cpu_detect_features_() {
+#if defined(__APPLE__)
+  return AC_CPU_NEON | AC_CPU_PMULL | AC_CPU_CRC32;
+#elif defined(__linux__)
+  // HWCAP_ASIMD, HWCAP_PMULL and HWCAP_CRC32.
+  const unsigned long hwcap = getauxval(AT_HWCAP);
+  uint32_t features = 0;
+  if (hwcap & (1ul << 1)) features |= AC_CPU_NEON;
+  if (hwcap & (1ul << 4)) features |= AC_CPU_PMULL;
+  if (hwcap & (1ul << 7)) features |= AC_CPU_CRC32;
+  return features;
+#else
+  uint32_t features = 0;
+#if defined(__ARM_NEON)
+  features |= AC_CPU_NEON;
+#endif
+#if defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES)
+  features |= AC_CPU_PMULL;
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+  features |= AC_CPU_CRC32;
+#endif
+  return features;
+#endif
+}
+
+#else  //----------------------------------------------------------------------
+
+static inline uint32_t ac_cpu_detect_features_() { return 0; }
+
+#endif  //----------------------------------------------------------------------
+
+#if defined(__linux__)
+
+// Reads a sysfs value like "32K", "8M" or "64".
+static inline size_t ac_cpu_read_sysfs_(const char* path) {
+  FILE* file = fopen(path, "r");
+  if (!file) return 0;
+  unsigned long value = 0;
+  char unit = 0;
+  const int read = fscanf(file, "%lu%c", &value, &unit);
+  fclose(file);
+  if (read < 1) return 0;
+  if (unit == 'K') return value << 10;
+  if (unit == 'M') return value << 20;
+  return value;
+}
+
+// Walks the caches of CPU 0.
+static inline void ac_cpu_detect_caches_(ac_cpu_info* x) {
+  char path[96];
+  for (int i = 0; i < 16; ++i) {
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/",
+             i);
+    char* leaf = path + strlen(path);
+    const size_t leaf_cap = sizeof(path) - (leaf - path);
+
+    snprintf(leaf, leaf_cap, "type");
+    FILE* file = fopen(path, "r");
+    if (!file) break;
+    char type[16] = {};
+    const bool got_type = fscanf(file, "%15s", type) == 1;
+    fclose(file);
+    if (!got_type || !strcmp(type, "Instruction")) continue;
+
+    snprintf(leaf, leaf_cap, "level");
+    const size_t level = ac_cpu_read_sysfs_(path);
+    snprintf(leaf, leaf_cap, "size");
+    const size_t size = ac_cpu_read_sysfs_(path);
+    snprintf(leaf, leaf_cap, "coherency_line_size");
+    const size_t line = ac_cpu_read_sysfs_(path);
+
+    if (level == 1) x->l1d_size = size;
+    if (level == 2) x->l2_size = size;
+    if (level == 3) x->l3_size = size;
+    if (line && !x->line_size) x->line_size = line;
+  }
+}
+
+#elif defined(__APPLE__)
+
+static inline size_t ac_cpu_sysctl_(const char* name) {
+  uint64_t value = 0;
+  size_t size = sizeof(value);
+  if (sysctlbyname(name, &value, &size, NULL, 0)) return 0;
+  return size == sizeof(uint32_t) ? (uint32_t)value : value;
+}
+
+static inline void ac_cpu_detect_caches_(ac_cpu_info* x) {
+  x->line_size = ac_cpu_sysctl_("hw.cachelinesize");
+  x->l1d_size = ac_cpu_sysctl_("hw.l1dcachesize");
+  x->l2_size = ac_cpu_sysctl_("hw.l2cachesize");
+  x->l3_size = ac_cpu_sysctl_("hw.l3cachesize");
+}
+
+#else
+
+static inline void ac_cpu_detect_caches_(ac_cpu_info* x) { (void)x; }
+
+#endif
+
+static ac_cpu_info ac_cpu_info_;
+static pthread_once_t ac_cpu_once_ = PTHREAD_ONCE_INIT;
+
+static void ac_cpu_detect_() {
+  ac_cpu_info_.features = ac_cpu_detect_features_();
+  const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  ac_cpu_info_.cpus = cpus > 1 ? (size_t)cpus : 1;
+  ac_cpu_detect_caches_(&ac_cpu_info_);
+}
+
+const ac_cpu_info* ac_cpu() {
+  pthread_once(&ac_cpu_once_, &ac_cpu_detect_);
+  return &ac_cpu_info_;
+}
+
+#endif  // AC_CPU_H_IMPL_
+#endif  // AC_CPU_IMPL
@@ -0,0 +1,98 @@
+#ifndef AC_CPU_TEST_H_
+#define AC_CPU_TEST_H_
+
+#include "ac_cpu.h"
+#include "ac_test.h"
+
+#define AC_CPU_IMPL
+#include "ac_cpu.h"
+
+//------------------------------------------------------------------------------
+// CPU Features
+//------------------------------------------------------------------------------
+
+static inline void cpu_matches_compiler_target(ac_test_state* s) {
+  ac_test_begin(s);
+
+  const ac_cpu_info* cpu = ac_cpu();
+  ac_test_expect(cpu == ac_cpu(), "Detected twice.");
+  ac_test_expect(cpu->cpus >= 1, "No CPUs.");
+
+  // This program runs, so the CPU has what the compiler targets.
+#if defined(__SSE4_2__) && defined(__POPCNT__)
+  ac_test_expect(ac_cpu_has(AC_CPU_SSE42), "Missing sse4.2.");
+#endif
+#if defined(__AVX2__) && defined(__FMA__)
+  ac_test_expect(ac_cpu_has(AC_CPU_AVX2), "Missing avx2.");
+#endif
+#if defined(__PCLMUL__)
+  ac_test_expect(ac_cpu_has(AC_CPU_PCLMUL), "Missing pclmul.");
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+  ac_test_expect(ac_cpu_has(AC_CPU_NEON), "Missing neon.");
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+  const uint32_t arm = AC_CPU_NEON | AC_CPU_PMULL | AC_CPU_CRC32;
+  ac_test_expect(!(cpu->features & arm), "ARM features on x86.");
+#endif
+  // AVX-512 implies AVX2 on every CPU that has it.
+  if (ac_cpu_has(AC_CPU_AVX512)) {
+    ac_test_expect(ac_cpu_has(AC_CPU_AVX2), "AVX-512 without AVX2.");
+  }
+  ac_test_expect(ac_cpu_has(0), "Empty set of features is missing.");
+
+  // Known cache sizes are ordered.
+  if (cpu->line_size) {
+    ac_test_expect(!(cpu->line_size & (cpu->line_size - 1)),
+                   "Line size %zu is not a power of 2.", cpu->line_size);
+  }
+  if (cpu->l1d_size && cpu->l2_size) {
+    ac_test_expect(cpu->l1d_size <= cpu->l2_size, "L1 %zu > L2 %zu.",
+                   cpu->l1d_size, cpu->l2_size);
+  }
+  if (cpu->l2_size && cpu->l3_size) {
+    ac_test_expect(cpu->l2_size <= cpu->l3_size, "L2 %zu > L3 %zu.",
+                   cpu->l2_size, cpu->l3_size);
+  }
+
+  ac_test_expect(!strcmp(ac_cpu_feature_name(AC_CPU_AVX2), "avx2"),
+                 "Wrong name.");
+  ac_test_expect(!strcmp(ac_cpu_feature_name(1u << 31), "unknown"),
+                 "Wrong name.");
+}
+
+static inline int ac_cpu_test_fast_() { return 2; }
+static inline int ac_cpu_test_faster_() { return 3; }
+static inline int ac_cpu_test_portable_() { return 1; }
+
+typedef int ac_cpu_test_fn_();
+
+static inline void cpu_dispatch_picks_first_supported(ac_test_state* s) {
+  ac_test_begin(s);
+
+  const ac_cpu_impl impls[] = {
+      {AC_CPU_AVX512 | AC_CPU_BMI2, (void (*)(void))&ac_cpu_test_faster_},
+      {AC_CPU_AVX2, (void (*)(void))&ac_cpu_test_fast_},
+      {0, (void (*)(void))&ac_cpu_test_portable_},
+  };
+  const uint32_t all = AC_CPU_AVX512 | AC_CPU_BMI2 | AC_CPU_AVX2;
+  ac_test_equ(((ac_cpu_test_fn_*)ac_cpu_pick(all, impls, 3))(), 3);
+  ac_test_equ(((ac_cpu_test_fn_*)ac_cpu_pick(AC_CPU_AVX512, impls, 3))(), 1);
+  ac_test_equ(((ac_cpu_test_fn_*)ac_cpu_pick(AC_CPU_AVX2, impls, 3))(), 2);
+  ac_test_equ(((ac_cpu_test_fn_*)ac_cpu_pick(0, impls, 3))(), 1);
+  ac_test_expect(!ac_cpu_pick(0, impls, 2), "Picked a missing feature.");
+
+  // On this CPU.
+  ac_cpu_test_fn_* fn = ac_cpu_dispatch(
+      ac_cpu_test_fn_*, {AC_CPU_AVX2, (void (*)(void))&ac_cpu_test_fast_},
+      {0, (void (*)(void))&ac_cpu_test_portable_});
+  ac_test_equ(fn(), ac_cpu_has(AC_CPU_AVX2) ? 2 : 1);
+}
+
+static inline void ac_cpu_test(ac_test_state* s) {
+  ac_test_begin(s);
+  ac_test_run(cpu_matches_compiler_target);
+  ac_test_run(cpu_dispatch_picks_first_supported);
+}
+
+#endif  // AC_CPU_TEST_H_
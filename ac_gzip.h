@@ -94,12 +94,105 @@ typedef struct ac_gzip {
 //  - 'file' memory must outlive 'gzip'.
 static inline bool ac_gzip_init(ac_gzip* gzip, ac_buf file);
 
+// Reads a DEFLATE stream one stored (uncompressed, BTYPE=00) block at a time.
+// Stored blocks are byte-aligned after their 3-bit header, so each one can be
+// handed out as a view directly into the input without copying or decoding.
+// This doesn't need miniz.
+typedef struct ac_gzip_stored {
+  ac_buf in;   // Remaining DEFLATE stream, beginning with a block header.
+  bool final;  // Set once the final block (BFINAL) has been read.
+} ac_gzip_stored;
+
+// Begins reading the compressed data of an initialized gzip.
+static inline ac_gzip_stored ac_gzip_stored_init(const ac_gzip* gzip);
+
+// Sets 'block' to a view of the next stored block's contents (into the input).
+//  - Returns 'false' once the final block has been read ('final' is set), or if
+//    the next block is compressed or truncated ('final' is not set).
+//  - On 'false', 'in' is unchanged and still points at the offending header.
+//  - After the final block, 'in' points at the gzip footer.
+static inline bool ac_gzip_stored_next(ac_gzip_stored* s, ac_buf* block);
+
+// Returns the inflated size if every block of the stream is stored and the
+// stream is complete, otherwise SIZE_MAX. Only reads block headers.
+static inline size_t ac_gzip_stored_size(const ac_gzip* gzip);
+
 #ifndef AC_GZIP_NO_MINIZ
 // Inflates the zipped archive contents into an expanding buffer.
+//  - Streams made entirely of stored blocks (e.g. level 0) are copied directly
+//    with one memcpy per block instead of going through miniz.
 static inline void ac_gzip_inflate(ac_gzip* gzip, ac_list(uint8_t) * out,
                                    ac_allocator alloc);
 #endif  // AC_GZIP_NO_MINIZ
 
+//------------------------------------------------------------------------------
+// Preset Dictionaries.
+//------------------------------------------------------------------------------
+
+// Small messages (a few hundred bytes) compress poorly on their own because
+// there is no history to match against. A preset dictionary shared by both
+// sides fills the 32 KiB LZ window before the first byte, so matches can point
+// back into it. Messages are raw DEFLATE streams (no gzip/zlib framing: gzip
+// has no way to signal a dictionary).
+
+// Builds a preset dictionary of at most 'dict.size' bytes from sample messages.
+//  - Picks the sample segments whose 8-byte substrings occur in the most
+//    samples, placing the most useful ones last (shortest match distances).
+//  - Returns the number of bytes written to the beginning of 'dict'.
+//  - Doesn't need miniz.
+static inline size_t ac_gzip_dict_train(ac_buf dict, const ac_buf* samples,
+                                        size_t sample_count,
+                                        ac_allocator alloc);
+
+#ifndef AC_GZIP_NO_MINIZ
+// Compressor primed with a preset dictionary.
+// miniz can neither set a dictionary nor copy a compressor through its public
+// API, so each message resets the compressor and feeds it the dictionary again
+// before the message. That costs about one compression of the dictionary per
+// message: keep dictionaries for small messages small (a few KiB).
+typedef struct ac_gzip_dict_deflater {
+  ac_allocator alloc;
+  tdefl_compressor* tdefl;
+  ac_list(uint8_t) dict;  // Last 32 KiB of the dictionary.
+  mz_uint flags;          // tdefl flags for the level.
+} ac_gzip_dict_deflater;
+
+// Decompressor primed with a preset dictionary.
+// Messages are inflated directly after a copy of the dictionary, so matches
+// reaching into it resolve without any special handling.
+typedef struct ac_gzip_dict_inflater {
+  ac_allocator alloc;
+  tinfl_decompressor* tinfl;
+  ac_list(uint8_t) window;  // Dictionary followed by the last message.
+  size_t dict_size;
+} ac_gzip_dict_inflater;
+
+// Primes a compressor with 'dict' at the given level (0-10, miniz levels).
+//  - Only the last 32 KiB of 'dict' are used.
+//  - Returns 'false' if allocation or priming failed.
+static inline bool ac_gzip_dict_deflater_init(ac_gzip_dict_deflater* d,
+                                              ac_buf dict, int level,
+                                              ac_allocator alloc);
+static inline void ac_gzip_dict_deflater_free(ac_gzip_dict_deflater* d);
+
+// Compresses one message into 'out' (cleared first, grown as needed).
+//  - Returns 'false' on failure.
+static inline bool ac_gzip_dict_deflate(ac_gzip_dict_deflater* d, ac_buf msg,
+                                        ac_list(uint8_t) * out);
+
+// Primes a decompressor with 'dict', which must match the compressor's.
+//  - Returns 'false' if allocation failed.
+static inline bool ac_gzip_dict_inflater_init(ac_gzip_dict_inflater* d,
+                                              ac_buf dict, ac_allocator alloc);
+static inline void ac_gzip_dict_inflater_free(ac_gzip_dict_inflater* d);
+
+// Inflates one message. 'out' is set to a view of the result, which is valid
+// until the next call.
+//  - Returns 'false' if the message is corrupt or truncated.
+static inline bool ac_gzip_dict_inflate(ac_gzip_dict_inflater* d, ac_buf msg,
+                                        ac_buf* out);
+#endif  // AC_GZIP_NO_MINIZ
+
 //------------------------------------------------------------------------------
 // Implementation
 //------------------------------------------------------------------------------
@@ -179,11 +272,67 @@ static inline bool ac_gzip_init(ac_gzip* gzip, ac_buf file) {
   return true;
 }
 
+static inline ac_gzip_stored ac_gzip_stored_init(const ac_gzip* gzip) {
+  return (ac_gzip_stored){.in = gzip->rest};
+}
+
+static inline bool ac_gzip_stored_next(ac_gzip_stored* s, ac_buf* block) {
+  if (s->final || s->in.size < 5) return false;
+
+  // Header: BFINAL (1 bit), BTYPE (2 bits), then padding to the byte boundary.
+  const uint8_t header = s->in.data[0];
+  if ((header >> 1) & 0x3) return false;
+
+  // LEN and NLEN (one's complement of LEN), little-endian.
+  const uint8_t* p = s->in.data + 1;
+  const uint16_t len = (uint16_t)(p[0] | (p[1] << 8));
+  const uint16_t nlen = (uint16_t)(p[2] | (p[3] << 8));
+  if ((len ^ nlen) != 0xFFFF) return false;
+  if (s->in.size - 5 < len) return false;
+
+  *block = (ac_buf){s->in.data + 5, len};
+  s->in.data += 5 + len;
+  s->in.size -= 5 + len;
+  s->final = header & 0x1;
+  return true;
+}
+
+static inline size_t ac_gzip_stored_size(const ac_gzip* gzip) {
+  ac_gzip_stored s = ac_gzip_stored_init(gzip);
+  size_t size = 0;
+  ac_buf block;
+  while (ac_gzip_stored_next(&s, &block)) size += block.size;
+  return s.final ? size : SIZE_MAX;
+}
+
 #ifndef AC_GZIP_NO_MINIZ
 static inline void ac_gzip_inflate(ac_gzip* gzip, ac_list(uint8_t) * out,
                                    ac_allocator alloc) {
   if (gzip->rest.size < sizeof(ac_gzip_footer)) return;
 
+  // Stored-only streams: the inflated size is known up front, so allocate once
+  // and copy each block in bulk.
+  const size_t stored_size = ac_gzip_stored_size(gzip);
+  if (stored_size != SIZE_MAX) {
+    out->len = 0;
+    if (out->cap < stored_size) ac_list_realloc(out, &alloc, stored_size);
+    if (stored_size && !out->data) return;
+
+    ac_gzip_stored s = ac_gzip_stored_init(gzip);
+    ac_buf block;
+    while (ac_gzip_stored_next(&s, &block)) {
+      memcpy(out->data + out->len, block.data, block.size);
+      out->len += block.size;
+    }
+
+    if (s.in.size < sizeof(ac_gzip_footer)) {
+      fprintf(stderr, "gzip stored: no room for footer\n");
+      return;
+    }
+    memcpy(&gzip->footer, s.in.data, sizeof(ac_gzip_footer));
+    return;
+  }
+
   // Clear/allocate the output, guess a size.
   out->len = 0;
   if (out->cap < 2 * gzip->rest.size) {
@@ -253,4 +402,307 @@ static inline void ac_gzip_inflate(ac_gzip* gzip, ac_list(uint8_t) * out,
 }
 #endif  // AC_GZIP_NO_MINIZ
 
+//------------------------------------------------------------------------------
+// Preset Dictionaries Implementation
+//------------------------------------------------------------------------------
+
+enum {
+  AC_GZIP_DICT_DMER = 8,         // Substring length scored by the trainer.
+  AC_GZIP_DICT_SEGMENT = 64,     // Length of each segment copied to the dict.
+  AC_GZIP_DICT_HASH_BITS = 16,   // Size of the trainer's substring count table.
+  AC_GZIP_DICT_WINDOW = 32768,   // DEFLATE window; older dict bytes are unused.
+};
+
+// One candidate segment for the trainer.
+typedef struct ac_gzip_dict_segment_ {
+  const unsigned char* data;
+  size_t size;
+  uint64_t score;  // Upper bound: scores only decrease as segments are taken.
+} ac_gzip_dict_segment_;
+
+static inline uint32_t ac_gzip_dict_hash_(const unsigned char* p) {
+  uint64_t x;
+  memcpy(&x, p, sizeof(x));
+  const uint64_t h = x * 0x9E3779B97F4A7C15ull;
+  return (uint32_t)(h >> (64 - AC_GZIP_DICT_HASH_BITS));
+}
+
+// Sum of the sample counts of every substring in the segment, ignoring
+// substrings seen in only one sample (they can't help other messages).
+static inline uint64_t ac_gzip_dict_score_(const ac_gzip_dict_segment_* seg,
+                                           const uint32_t* counts) {
+  uint64_t score = 0;
+  for (size_t i = 0; i + AC_GZIP_DICT_DMER <= seg->size; ++i) {
+    const uint32_t count = counts[ac_gzip_dict_hash_(seg->data + i)];
+    if (count > 1) score += count - 1;
+  }
+  return score;
+}
+
+// Restores the max-heap property (by score) below index 'i'.
+static inline void ac_gzip_dict_sift_down_(ac_gzip_dict_segment_* heap,
+                                           size_t n, size_t i) {
+  while (true) {
+    size_t top = i;
+    const size_t left = 2 * i + 1;
+    const size_t right = 2 * i + 2;
+    if (left < n && heap[left].score > heap[top].score) top = left;
+    if (right < n && heap[right].score > heap[top].score) top = right;
+    if (top == i) return;
+
+    const ac_gzip_dict_segment_ tmp = heap[i];
+    heap[i] = heap[top];
+    heap[top] = tmp;
+    i = top;
+  }
+}
+
+static inline size_t ac_gzip_dict_train(ac_buf dict, const ac_buf* samples,
+                                        size_t sample_count,
+                                        ac_allocator alloc) {
+  const size_t table_size = (size_t)1 << AC_GZIP_DICT_HASH_BITS;
+
+  // Count candidate segments.
+  const size_t stride = AC_GZIP_DICT_SEGMENT / 2;
+  size_t segment_count = 0;
+  for (size_t i = 0; i < sample_count; ++i) {
+    if (samples[i].size < AC_GZIP_DICT_DMER) continue;
+    segment_count += 1 + samples[i].size / stride;
+  }
+  if (!segment_count || !dict.size) return 0;
+
+  // Scratch: substring sample counts, last sample seen per substring, segments.
+  ac_slab slab = {};
+  const ac_slab_block counts_block =
+      ac_slab_alloc_type(&slab, uint32_t, table_size);
+  const ac_slab_block last_block =
+      ac_slab_alloc_type(&slab, uint32_t, table_size);
+  const ac_slab_block segments_block =
+      ac_slab_alloc_type(&slab, ac_gzip_dict_segment_, segment_count);
+  unsigned char* mem = ac_alloc(&alloc, ac_slab_size(&slab));
+  if (!mem) return 0;
+
+  uint32_t* counts = (uint32_t*)(mem + counts_block.offset);
+  uint32_t* last = (uint32_t*)(mem + last_block.offset);
+  ac_gzip_dict_segment_* segments =
+      (ac_gzip_dict_segment_*)(mem + segments_block.offset);
+  memset(counts, 0, counts_block.size);
+  memset(last, 0, last_block.size);
+
+  // Count the number of samples each substring appears in.
+  for (size_t i = 0; i < sample_count; ++i) {
+    const ac_buf x = samples[i];
+    for (size_t j = 0; j + AC_GZIP_DICT_DMER <= x.size; ++j) {
+      const uint32_t h = ac_gzip_dict_hash_(x.data + j);
+      if (last[h] == i + 1) continue;
+      last[h] = i + 1;
+      ++counts[h];
+    }
+  }
+
+  // Score overlapping segments of every sample.
+  size_t n = 0;
+  for (size_t i = 0; i < sample_count; ++i) {
+    const ac_buf x = samples[i];
+    if (x.size < AC_GZIP_DICT_DMER) continue;
+    for (size_t j = 0; j < x.size; j += stride) {
+      ac_gzip_dict_segment_* seg = segments + n++;
+      seg->data = x.data + j;
+      seg->size = ac_min(x.size - j, (size_t)AC_GZIP_DICT_SEGMENT);
+      seg->score = ac_gzip_dict_score_(seg, counts);
+      if (j + AC_GZIP_DICT_SEGMENT >= x.size) break;
+    }
+  }
+
+  // Greedily take the best segment, then forget its substrings so they aren't
+  // paid for twice. Scores only ever decrease, so a stale score is an upper
+  // bound: rescore the top of a max-heap and only take it if it still beats
+  // the runner-up, otherwise sift it back down.
+  // The dict is filled from the back, so the best segments end up last.
+  for (size_t i = n / 2; i-- > 0;) ac_gzip_dict_sift_down_(segments, n, i);
+
+  size_t pos = dict.size;
+  while (pos && n && segments[0].score) {
+    ac_gzip_dict_segment_* best = segments;
+    const uint64_t score = ac_gzip_dict_score_(best, counts);
+    if (score < best->score) {
+      best->score = score;
+      ac_gzip_dict_sift_down_(segments, n, 0);
+      continue;
+    }
+
+    const size_t size = ac_min(best->size, pos);
+    pos -= size;
+    memcpy(dict.data + pos, best->data + best->size - size, size);
+    for (size_t i = 0; i + AC_GZIP_DICT_DMER <= best->size; ++i) {
+      counts[ac_gzip_dict_hash_(best->data + i)] = 0;
+    }
+
+    // Pop.
+    segments[0] = segments[--n];
+    ac_gzip_dict_sift_down_(segments, n, 0);
+  }
+
+  ac_free(&alloc, mem);
+
+  const size_t size = dict.size - pos;
+  memmove(dict.data, dict.data + pos, size);
+  return size;
+}
+
+#ifndef AC_GZIP_NO_MINIZ
+// Resets 'tdefl', then feeds it 'dict' and sync-flushes it, discarding the
+// output. The flush leaves the bit stream byte-aligned at a block boundary, so
+// what follows is a standalone raw DEFLATE stream that only references the
+// window.
+static inline bool ac_gzip_dict_prime_(tdefl_compressor* tdefl, ac_buf dict,
+                                       mz_uint flags) {
+  if (tdefl_init(tdefl, NULL, NULL, flags) != TDEFL_STATUS_OKAY) return false;
+
+  unsigned char discard[4096];
+  size_t in_offset = 0;
+  tdefl_status status;
+  size_t out_size;
+  do {
+    size_t in_size = dict.size - in_offset;
+    out_size = sizeof(discard);
+    status = tdefl_compress(tdefl, dict.data + in_offset, &in_size, discard,
+                            &out_size, TDEFL_SYNC_FLUSH);
+    in_offset += in_size;
+  } while (status == TDEFL_STATUS_OKAY &&
+           (in_offset < dict.size || out_size == sizeof(discard)));
+  return status == TDEFL_STATUS_OKAY;
+}
+
+static inline bool ac_gzip_dict_deflater_init(ac_gzip_dict_deflater* d,
+                                              ac_buf dict, int level,
+                                              ac_allocator alloc) {
+  // Negative window bits: raw DEFLATE, no zlib header.
+  *d = (ac_gzip_dict_deflater){
+      .alloc = alloc,
+      .flags = tdefl_create_comp_flags_from_zip_params(
+          level, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY),
+  };
+  if (dict.size > AC_GZIP_DICT_WINDOW) {
+    dict.data += dict.size - AC_GZIP_DICT_WINDOW;
+    dict.size = AC_GZIP_DICT_WINDOW;
+  }
+
+  d->tdefl = ac_alloc(&d->alloc, sizeof(tdefl_compressor));
+  if (dict.size) ac_list_realloc(&d->dict, &d->alloc, dict.size);
+  if (!d->tdefl || (dict.size && !d->dict.data)) {
+    ac_gzip_dict_deflater_free(d);
+    return false;
+  }
+  if (dict.size) memcpy(d->dict.data, dict.data, dict.size);
+  d->dict.len = dict.size;
+
+  // Prime once up front, so bad parameters fail here rather than per message.
+  if (!ac_gzip_dict_prime_(d->tdefl, (ac_buf){d->dict.data, d->dict.len},
+                           d->flags)) {
+    ac_gzip_dict_deflater_free(d);
+    return false;
+  }
+  return true;
+}
+
+static inline void ac_gzip_dict_deflater_free(ac_gzip_dict_deflater* d) {
+  ac_free(&d->alloc, d->tdefl);
+  ac_free(&d->alloc, d->dict.data);
+  *d = (ac_gzip_dict_deflater){};
+}
+
+static inline bool ac_gzip_dict_deflate(ac_gzip_dict_deflater* d, ac_buf msg,
+                                        ac_list(uint8_t) * out) {
+  if (!ac_gzip_dict_prime_(d->tdefl, (ac_buf){d->dict.data, d->dict.len},
+                           d->flags)) {
+    return false;
+  }
+
+  // Room for the worst case (stored blocks) up front; rarely grows.
+  out->len = 0;
+  const size_t bound = msg.size + msg.size / 8 + 64;
+  if (out->cap < bound) ac_list_realloc(out, &d->alloc, bound);
+
+  size_t in_offset = 0;
+  while (out->data) {
+    size_t in_size = msg.size - in_offset;
+    size_t out_size = out->cap - out->len;
+    const tdefl_status status =
+        tdefl_compress(d->tdefl, msg.data + in_offset, &in_size,
+                       out->data + out->len, &out_size, TDEFL_FINISH);
+    in_offset += in_size;
+    out->len += out_size;
+
+    if (status == TDEFL_STATUS_DONE) return true;
+    if (status != TDEFL_STATUS_OKAY) return false;
+
+    const size_t len = out->len;
+    ac_list_realloc(out, &d->alloc, 2 * out->cap);
+    out->len = len;
+  }
+  return false;
+}
+
+static inline bool ac_gzip_dict_inflater_init(ac_gzip_dict_inflater* d,
+                                              ac_buf dict, ac_allocator alloc) {
+  *d = (ac_gzip_dict_inflater){.alloc = alloc};
+  if (dict.size > AC_GZIP_DICT_WINDOW) {
+    dict.data += dict.size - AC_GZIP_DICT_WINDOW;
+    dict.size = AC_GZIP_DICT_WINDOW;
+  }
+
+  d->tinfl = ac_alloc(&d->alloc, sizeof(tinfl_decompressor));
+  ac_list_realloc(&d->window, &d->alloc, dict.size + 4096);
+  if (!d->tinfl || !d->window.data) {
+    ac_gzip_dict_inflater_free(d);
+    return false;
+  }
+
+  memcpy(d->window.data, dict.data, dict.size);
+  d->window.len = dict.size;
+  d->dict_size = dict.size;
+  return true;
+}
+
+static inline void ac_gzip_dict_inflater_free(ac_gzip_dict_inflater* d) {
+  ac_free(&d->alloc, d->tinfl);
+  ac_free(&d->alloc, d->window.data);
+  *d = (ac_gzip_dict_inflater){};
+}
+
+static inline bool ac_gzip_dict_inflate(ac_gzip_dict_inflater* d, ac_buf msg,
+                                        ac_buf* out) {
+  tinfl_init(d->tinfl);
+  d->window.len = d->dict_size;
+
+  // A non-wrapping output buffer lets matches reach back past the start of the
+  // message, into the dictionary right before it.
+  size_t in_offset = 0;
+  while (true) {
+    size_t in_size = msg.size - in_offset;
+    size_t out_size = d->window.cap - d->window.len;
+    const tinfl_status status = tinfl_decompress(
+        d->tinfl, msg.data + in_offset, &in_size, d->window.data,
+        d->window.data + d->window.len, &out_size,
+        TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+    in_offset += in_size;
+    d->window.len += out_size;
+
+    if (status == TINFL_STATUS_DONE) break;
+    if (status != TINFL_STATUS_HAS_MORE_OUTPUT) return false;
+
+    // Only offsets are kept across calls, so the window may move.
+    const size_t len = d->window.len;
+    ac_list_realloc(&d->window, &d->alloc, 2 * d->window.cap);
+    if (!d->window.data) return false;
+    d->window.len = len;
+  }
+
+  *out = (ac_buf){d->window.data + d->dict_size,
+                  d->window.len - d->dict_size};
+  return true;
+}
+#endif  // AC_GZIP_NO_MINIZ
+
 #endif  // AC_GZIP_H_
@@ -0,0 +1,384 @@
+#ifndef AC_GZIP_TEST_H_
+#define AC_GZIP_TEST_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ac_gzip.h"
+#include "ac_test.h"
+#include "ac_tracking.h"
+
+//------------------------------------------------------------------------------
+// Member Builder
+//------------------------------------------------------------------------------
+
+// A gzip member written into a fixed buffer.
+typedef struct ac_gzip_test_member_ {
+  uint8_t data[140 * 1024];
+  size_t size;
+} ac_gzip_test_member_;
+
+static inline void ac_gzip_test_bytes_(ac_gzip_test_member_* m,
+                                       const void* data, size_t size) {
+  if (size) memcpy(m->data + m->size, data, size);
+  m->size += size;
+}
+
+// Header without optional fields.
+static inline void ac_gzip_test_header_(ac_gzip_test_member_* m) {
+  const uint8_t header[] = {0x1f, 0x8b, 0x08, 0, 0, 0, 0, 0, 0, 0x03};
+  m->size = 0;
+  ac_gzip_test_bytes_(m, header, sizeof(header));
+}
+
+// One stored block, at most 65535 bytes.
+static inline void ac_gzip_test_stored_(ac_gzip_test_member_* m,
+                                        const void* data, uint16_t len,
+                                        bool final) {
+  const uint16_t nlen = ~len;
+  const uint8_t header[] = {final, len & 0xFF, len >> 8, nlen & 0xFF,
+                            nlen >> 8};
+  ac_gzip_test_bytes_(m, header, sizeof(header));
+  ac_gzip_test_bytes_(m, data, len);
+}
+
+// Footer with the inflated size. The CRC isn't checked, so it's left zero.
+static inline void ac_gzip_test_footer_(ac_gzip_test_member_* m,
+                                        uint32_t size) {
+  const ac_gzip_footer footer = {.decompressed_size = size};
+  ac_gzip_test_bytes_(m, &footer, sizeof(footer));
+}
+
+static inline ac_buf ac_gzip_test_buf_(const ac_gzip_test_member_* m) {
+  return (ac_buf){(unsigned char*)m->data, m->size};
+}
+
+//------------------------------------------------------------------------------
+// Stored Blocks
+//------------------------------------------------------------------------------
+
+static inline void gzip_stored_blocks(ac_test_state* s) {
+  ac_test_begin(s);
+
+  // A payload larger than one block, split across blocks and read back one
+  // block per call, with an empty block in the middle.
+  static uint8_t payload[100000];
+  for (size_t i = 0; i < sizeof(payload); ++i) payload[i] = i * 7 + i / 300;
+  static ac_gzip_test_member_ m;
+  ac_gzip_test_header_(&m);
+  ac_gzip_test_stored_(&m, payload, 65535, false);
+  ac_gzip_test_stored_(&m, NULL, 0, false);
+  ac_gzip_test_stored_(&m, payload + 65535, sizeof(payload) - 65535, true);
+  ac_gzip_test_footer_(&m, sizeof(payload));
+
+  ac_gzip gzip;
+  ac_test_expect(ac_gzip_init(&gzip, ac_gzip_test_buf_(&m)), "Init failed.");
+  ac_gzip_stored reader = ac_gzip_stored_init(&gzip);
+  ac_buf block = {};
+  size_t sizes[3] = {}, offset = 0, blocks = 0;
+  bool same = true;
+  while (blocks < 3 && ac_gzip_stored_next(&reader, &block)) {
+    same &= !memcmp(block.data, payload + offset, block.size);
+    offset += block.size;
+    sizes[blocks++] = block.size;
+  }
+  ac_test_equ(blocks, 3);
+  ac_test_equ(sizes[0], 65535);
+  ac_test_equ(sizes[1], 0);
+  ac_test_equ(sizes[2], sizeof(payload) - 65535);
+  ac_test_expect(same, "Blocks don't match the payload.");
+  ac_test_expect(reader.final, "Final block not seen.");
+  ac_test_expect(!ac_gzip_stored_next(&reader, &block), "Read past final.");
+  ac_test_equ(reader.in.size, sizeof(ac_gzip_footer));
+  ac_test_equ(ac_gzip_stored_size(&gzip), sizeof(payload));
+
+  // Truncated in the last block: stops there, not final.
+  m.size -= sizeof(ac_gzip_footer) + 1;
+  ac_test_expect(ac_gzip_init(&gzip, ac_gzip_test_buf_(&m)), "Init failed.");
+  reader = ac_gzip_stored_init(&gzip);
+  ac_test_expect(ac_gzip_stored_next(&reader, &block) &&
+                     ac_gzip_stored_next(&reader, &block),
+                 "Complete blocks not read.");
+  const uint8_t* stuck = reader.in.data;
+  ac_test_expect(!ac_gzip_stored_next(&reader, &block), "Read truncated.");
+  ac_test_expect(!reader.final && reader.in.data == stuck, "Moved on.");
+  ac_test_equ(ac_gzip_stored_size(&gzip), SIZE_MAX);
+}
+
+static inline void gzip_stored_rejects_bad_length(ac_test_state* s) {
+  ac_test_begin(s);
+
+  static ac_gzip_test_member_ m;
+  ac_gzip_test_header_(&m);
+  ac_gzip_test_stored_(&m, "hello", 5, true);
+  ac_gzip_test_footer_(&m, 5);
+  m.data[10 + 3] ^= 0x01;  // NLEN's low byte.
+
+  ac_gzip gzip;
+  ac_test_expect(ac_gzip_init(&gzip, ac_gzip_test_buf_(&m)), "Init failed.");
+  ac_gzip_stored reader = ac_gzip_stored_init(&gzip);
+  ac_buf block = {};
+  ac_test_expect(!ac_gzip_stored_next(&reader, &block), "Read a bad block.");
+  ac_test_expect(!reader.final && reader.in.data == m.data + 10, "Moved on.");
+  ac_test_equ(ac_gzip_stored_size(&gzip), SIZE_MAX);
+}
+
+// "stored, then compressed: " in a stored block, then "abcabcabcabc" in a
+// final block with fixed Huffman codes.
+static inline void ac_gzip_test_mixed_(ac_gzip_test_member_* m) {
+  const char stored[] = "stored, then compressed: ";
+  const uint8_t fixed[] = {0x4b, 0x4c, 0x4a, 0x4e, 0x84, 0x21, 0x00};
+  ac_gzip_test_header_(m);
+  ac_gzip_test_stored_(m, stored, sizeof(stored) - 1, false);
+  ac_gzip_test_bytes_(m, fixed, sizeof(fixed));
+  ac_gzip_test_footer_(m, sizeof(stored) - 1 + 12);
+}
+
+static inline void gzip_stored_stops_at_compressed_block(ac_test_state* s) {
+  ac_test_begin(s);
+
+  static ac_gzip_test_member_ m;
+  ac_gzip_test_mixed_(&m);
+  ac_gzip gzip;
+  ac_test_expect(ac_gzip_init(&gzip, ac_gzip_test_buf_(&m)), "Init failed.");
+  ac_gzip_stored reader = ac_gzip_stored_init(&gzip);
+  ac_buf block = {};
+  ac_test_expect(ac_gzip_stored_next(&reader, &block), "Stored not read.");
+  ac_test_expect(block.size == 25 && !memcmp(block.data, "stored, ", 8),
+                 "Wrong stored block.");
+  ac_test_expect(!ac_gzip_stored_next(&reader, &block), "Read compressed.");
+  ac_test_expect(!reader.final, "Compressed block read as final.");
+  ac_test_equ(reader.in.data[0], 0x4b);
+  ac_test_equ(ac_gzip_stored_size(&gzip), SIZE_MAX);
+}
+
+#ifndef AC_GZIP_NO_MINIZ
+static inline void gzip_inflate_stored_and_mixed(ac_test_state* s) {
+  ac_test_begin(s);
+
+  static ac_gzip_test_member_ m;
+  ac_gzip_test_header_(&m);
+  ac_gzip_test_stored_(&m, "one, ", 5, false);
+  ac_gzip_test_stored_(&m, NULL, 0, false);
+  ac_gzip_test_stored_(&m, "two", 3, true);
+  ac_gzip_test_footer_(&m, 8);
+
+  // Stored only: the bulk-copy path.
+  ac_allocator alloc = ac_mallocator();
+  ac_gzip gzip;
+  ac_list(uint8_t) out = {};
+  ac_test_expect(ac_gzip_init(&gzip, ac_gzip_test_buf_(&m)), "Init failed.");
+  ac_gzip_inflate(&gzip, &out, alloc);
+  ac_test_expect(out.len == 8 && !memcmp(out.data, "one, two", 8),
+                 "Wrong output.");
+  ac_test_equ(gzip.footer.decompressed_size, 8);
+
+  // Mixed: through miniz.
+  ac_gzip_test_mixed_(&m);
+  ac_test_expect(ac_gzip_init(&gzip, ac_gzip_test_buf_(&m)), "Init failed.");
+  ac_gzip_inflate(&gzip, &out, alloc);
+  const char want[] = "stored, then compressed: abcabcabcabc";
+  ac_test_expect(out.len == sizeof(want) - 1 &&
+                     !memcmp(out.data, want, sizeof(want) - 1),
+                 "Wrong output.");
+  ac_test_equ(gzip.footer.decompressed_size, sizeof(want) - 1);
+
+  ac_free(&alloc, out.data);
+}
+
+static inline void gzip_inflate_counts_allocs(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_tracking tracking;
+  ac_tracking_init(&tracking, (ac_allocator2){});
+  static ac_tracking_tag gzip_tag;
+  ac_tracking_tag_init(&gzip_tag, &tracking, "gzip");
+  ac_allocator2 tagged = ac_tracking_tag_allocator2(&gzip_tag);
+  ac_allocator alloc = ac_allocator_from2(&tagged);
+
+  static ac_gzip_test_member_ m;
+  ac_gzip_test_header_(&m);
+  ac_gzip_test_stored_(&m, "one, two", 8, true);
+  ac_gzip_test_footer_(&m, 8);
+
+  // Stored only: one allocation of the known size.
+  ac_gzip gzip;
+  ac_list(uint8_t) out = {};
+  ac_test_expect(ac_gzip_init(&gzip, ac_gzip_test_buf_(&m)), "Init failed.");
+  ac_gzip_inflate(&gzip, &out, alloc);
+  ac_test_equ(out.len, 8);
+  ac_tracking_stats stats = ac_tracking_stats_of(&gzip_tag.counters);
+  ac_test_equ(stats.allocs, 1);
+  ac_test_equ(stats.frees, 0);
+  ac_test_equ(stats.live_bytes, 8 + sizeof(ac_allocator_from2_header_));
+
+  // Mixed: the output guess replaces the smaller list, and everything is
+  // freed with it. miniz allocates its own inflate state, which isn't counted.
+  ac_gzip_test_mixed_(&m);
+  ac_test_expect(ac_gzip_init(&gzip, ac_gzip_test_buf_(&m)), "Init failed.");
+  ac_gzip_inflate(&gzip, &out, alloc);
+  stats = ac_tracking_stats_of(&gzip_tag.counters);
+  ac_test_geu(stats.allocs, 2);
+  ac_test_equ(stats.frees, stats.allocs - 1);
+  ac_free(&alloc, out.data);
+  stats = ac_tracking_stats_of(&gzip_tag.counters);
+  ac_test_equ(stats.frees, stats.allocs);
+  ac_test_equ(stats.live_bytes, 0);
+}
+#endif  // AC_GZIP_NO_MINIZ
+
+//------------------------------------------------------------------------------
+// Preset Dictionaries
+//------------------------------------------------------------------------------
+
+enum { AC_GZIP_TEST_SAMPLES = 64 };
+
+// Small log-like messages sharing most of their text, with a few varying
+// fields, like the messages a preset dictionary is meant for.
+typedef struct ac_gzip_test_corpus_ {
+  char text[AC_GZIP_TEST_SAMPLES][160];
+  ac_buf samples[AC_GZIP_TEST_SAMPLES];
+} ac_gzip_test_corpus_;
+
+static inline void ac_gzip_test_corpus_init_(ac_gzip_test_corpus_* c) {
+  const char* actions[] = {"login", "logout", "upload", "download"};
+  for (size_t i = 0; i < AC_GZIP_TEST_SAMPLES; ++i) {
+    const int len = snprintf(
+        c->text[i], sizeof(c->text[i]),
+        "{\"user\":\"u%05zu\",\"action\":\"%s\",\"status\":\"ok\","
+        "\"region\":\"eu-west-1\",\"latency_ms\":%zu}",
+        i * 7919 % 100000, actions[i % 4], i * 37 % 1000);
+    c->samples[i] = (ac_buf){(unsigned char*)c->text[i], (size_t)len};
+  }
+}
+
+static inline bool ac_gzip_test_contains_(ac_buf haystack, const char* s) {
+  const size_t n = strlen(s);
+  for (size_t i = 0; i + n <= haystack.size; ++i) {
+    if (!memcmp(haystack.data + i, s, n)) return true;
+  }
+  return false;
+}
+
+static inline void gzip_dict_train(ac_test_state* s) {
+  ac_test_begin(s);
+
+  static ac_gzip_test_corpus_ c;
+  ac_gzip_test_corpus_init_(&c);
+  const ac_allocator alloc = ac_mallocator();
+  static unsigned char data[8192];
+  ac_buf dict = {data, sizeof(data)};
+
+  // Text shared by the samples is kept, but not all of the samples' text.
+  size_t corpus_size = 0;
+  for (size_t i = 0; i < AC_GZIP_TEST_SAMPLES; ++i) {
+    corpus_size += c.samples[i].size;
+  }
+  const size_t trained =
+      ac_gzip_dict_train(dict, c.samples, AC_GZIP_TEST_SAMPLES, alloc);
+  ac_test_expect(trained > 0 && trained < corpus_size / 2, "Trained %zu of "
+                 "%zu bytes.", trained, corpus_size);
+  dict.size = trained;
+  ac_test_expect(ac_gzip_test_contains_(dict, "\"status\":\"ok\"") &&
+                     ac_gzip_test_contains_(dict, "\"region\":\"eu-west-1\""),
+                 "Shared text missing.");
+
+  // A small dict is filled exactly, from the back.
+  dict.size = 40;
+  ac_test_equ(ac_gzip_dict_train(dict, c.samples, AC_GZIP_TEST_SAMPLES, alloc),
+              40);
+
+  // Nothing is shared: nothing to train on.
+  const ac_buf unique[] = {
+      {(unsigned char*)"the quick brown fox", 19},
+      {(unsigned char*)"jumps over the lazy dog", 23},
+      {(unsigned char*)"short", 5},
+  };
+  dict.size = sizeof(data);
+  ac_test_equ(ac_gzip_dict_train(dict, unique, 3, alloc), 0);
+  ac_test_equ(ac_gzip_dict_train(dict, NULL, 0, alloc), 0);
+}
+
+#ifndef AC_GZIP_NO_MINIZ
+static inline void gzip_dict_round_trip(ac_test_state* s) {
+  ac_test_begin(s);
+
+  static ac_gzip_test_corpus_ c;
+  ac_gzip_test_corpus_init_(&c);
+  unsigned char data[1024];
+  ac_allocator alloc = ac_mallocator();
+  const ac_buf dict = {data, ac_gzip_dict_train((ac_buf){data, sizeof(data)},
+                                                c.samples, AC_GZIP_TEST_SAMPLES,
+                                                alloc)};
+
+  ac_gzip_dict_deflater deflater, plain;
+  ac_gzip_dict_inflater inflater;
+  ac_test_expect(ac_gzip_dict_deflater_init(&deflater, dict, 6, alloc) &&
+                     ac_gzip_dict_deflater_init(&plain, (ac_buf){}, 6, alloc) &&
+                     ac_gzip_dict_inflater_init(&inflater, dict, alloc),
+                 "Init failed.");
+
+  // Every message inflates back, reusing the primed state, and the dictionary
+  // makes the messages smaller overall.
+  ac_list(uint8_t) out = {};
+  size_t bad = 0, with_dict = 0, without_dict = 0;
+  for (size_t i = 0; i < AC_GZIP_TEST_SAMPLES; ++i) {
+    const ac_buf msg = c.samples[i];
+    ac_buf inflated = {};
+    bad += !ac_gzip_dict_deflate(&plain, msg, &out);
+    without_dict += out.len;
+    bad += !ac_gzip_dict_deflate(&deflater, msg, &out);
+    with_dict += out.len;
+    bad += !ac_gzip_dict_inflate(&inflater, (ac_buf){out.data, out.len},
+                                 &inflated);
+    bad += inflated.size != msg.size ||
+           memcmp(inflated.data, msg.data, msg.size);
+  }
+  ac_test_equ(bad, 0);
+  ac_test_expect(2 * with_dict < without_dict, "%zu bytes with the dict, %zu "
+                 "without.", with_dict, without_dict);
+
+  // A message longer than the inflater's initial window.
+  static unsigned char big[20000];
+  for (size_t i = 0; i < sizeof(big); ++i) {
+    big[i] = "status ok "[i % 10] + i / 997;
+  }
+  ac_buf inflated = {};
+  ac_test_expect(
+      ac_gzip_dict_deflate(&deflater, (ac_buf){big, sizeof(big)}, &out) &&
+          ac_gzip_dict_inflate(&inflater, (ac_buf){out.data, out.len},
+                               &inflated),
+      "Round trip failed.");
+  ac_test_expect(inflated.size == sizeof(big) &&
+                     !memcmp(inflated.data, big, sizeof(big)),
+                 "Wrong output.");
+
+  // Corrupt input fails instead of reading past it.
+  out.data[0] = 0xFF;
+  out.len = 1;
+  ac_test_expect(!ac_gzip_dict_inflate(&inflater, (ac_buf){out.data, out.len},
+                                       &inflated),
+                 "Inflated a corrupt message.");
+
+  ac_free(&alloc, out.data);
+  ac_gzip_dict_deflater_free(&deflater);
+  ac_gzip_dict_deflater_free(&plain);
+  ac_gzip_dict_inflater_free(&inflater);
+}
+#endif  // AC_GZIP_NO_MINIZ
+
+static inline void ac_gzip_test(ac_test_state* s) {
+  ac_test_begin(s);
+  ac_test_run(gzip_stored_blocks);
+  ac_test_run(gzip_stored_rejects_bad_length);
+  ac_test_run(gzip_stored_stops_at_compressed_block);
+  ac_test_run(gzip_dict_train);
+#ifndef AC_GZIP_NO_MINIZ
+  ac_test_run(gzip_inflate_stored_and_mixed);
+  ac_test_run(gzip_inflate_counts_allocs);
+  ac_test_run(gzip_dict_round_trip);
+#endif
+}
+
+#endif  // AC_GZIP_TEST_H_
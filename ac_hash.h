@@ -0,0 +1,210 @@
+#ifndef AC_HASH_H_
+#define AC_HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ac_mem.h"
+#include "ac_str.h"
+
+//------------------------------------------------------------------------------
+// Hashing.
+//------------------------------------------------------------------------------
+
+// A fast, non-cryptographic 64-bit hash for hash tables, deduplication and
+// checksums of non-adversarial data. Uses wyhash's 64x64 => 128-bit multiply
+// mixing with a single 16-byte lane. That follows wyhash v4.2's steps below 48
+// bytes, where wyhash switches to three lanes, but matching wyhash's values
+// isn't a goal: don't mix the two where hashes must agree.
+//  - Keys up to 16 bytes take a branch-light path of at most 4 loads.
+//  - Longer keys are mixed 16 bytes at a time, the last 16 bytes separately.
+//  - Values depend on the byte order of the machine.
+// Not suitable where an attacker picks the keys to cause collisions, unless the
+// seed is a secret.
+
+// Hashes 'size' bytes with a seed.
+static inline uint64_t ac_hash_seed(const void* data, size_t size,
+                                    uint64_t seed);
+
+// Hashes 'size' bytes.
+static inline uint64_t ac_hash(const void* data, size_t size) {
+  return ac_hash_seed(data, size, 0);
+}
+
+// Hashes the contents of buffers and strings.
+static inline uint64_t ac_hash_buf(ac_buf buf, uint64_t seed) {
+  return ac_hash_seed(buf.data, buf.size, seed);
+}
+
+static inline uint64_t ac_hash_str(ac_str str, uint64_t seed) {
+  return ac_hash_seed(str.data, str.len, seed);
+}
+
+// Hashes the elements of any 'ac_span', byte by byte.
+#define ac_hash_span(span, seed) \
+  ac_hash_seed((span).data, (span).len * sizeof(*(span).data), seed)
+
+// State to hash data that arrives in chunks. Hashing all chunks gives the same
+// value as hashing them at once.
+typedef struct ac_hash_state {
+  uint64_t seed;
+  size_t len;
+  // The last hashed block, then up to a block of bytes not hashed yet.
+  unsigned char buf[32];
+  size_t pending;
+} ac_hash_state;
+
+// Starts hashing with a seed.
+static inline ac_hash_state ac_hash_begin(uint64_t seed);
+
+// Adds the next chunk of data.
+static inline void ac_hash_update(ac_hash_state*, const void* data,
+                                  size_t size);
+
+// Returns the hash of all chunks. The state may be updated further after.
+static inline uint64_t ac_hash_end(const ac_hash_state*);
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+static const uint64_t ac_hash_secret_[4] = {
+    0x2d358dccaa6c78a5ull,
+    0x8bb84b93962eacc9ull,
+    0x4b33a62ed433d4a3ull,
+    0x4d5a2da51de1aa47ull,
+};
+
+// Multiplies a and b to 128 bits, storing the low half in a and the high half
+// in b.
+static inline void ac_hash_mum_(uint64_t* a, uint64_t* b) {
+#if defined(__SIZEOF_INT128__)
+  const __uint128_t r = (__uint128_t)*a * *b;
+  *a = (uint64_t)r;
+  *b = (uint64_t)(r >> 64);
+#else
+  const uint64_t ha = *a >> 32, hb = *b >> 32;
+  const uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+  const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  const uint64_t t = rl + (rm0 << 32);
+  uint64_t c = t < rl;
+  const uint64_t lo = t + (rm1 << 32);
+  c += lo < t;
+  *a = lo;
+  *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+// Folds the 128-bit product of a and b to 64 bits.
+static inline uint64_t ac_hash_mix_(uint64_t a, uint64_t b) {
+  ac_hash_mum_(&a, &b);
+  return a ^ b;
+}
+
+static inline uint64_t ac_hash_r8_(const unsigned char* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t ac_hash_r4_(const unsigned char* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// Reads 1 to 3 bytes.
+static inline uint64_t ac_hash_r3_(const unsigned char* p, size_t size) {
+  return ((uint64_t)p[0] << 16) | ((uint64_t)p[size >> 1] << 8) | p[size - 1];
+}
+
+static inline uint64_t ac_hash_init_seed_(uint64_t seed) {
+  return seed ^ ac_hash_mix_(seed ^ ac_hash_secret_[0], ac_hash_secret_[1]);
+}
+
+// Mixes one 16-byte block into the seed.
+static inline uint64_t ac_hash_block_(const unsigned char* p, uint64_t seed) {
+  return ac_hash_mix_(ac_hash_r8_(p) ^ ac_hash_secret_[1],
+                      ac_hash_r8_(p + 8) ^ seed);
+}
+
+// Mixes the last up to 16 bytes ('a' and 'b') and the length into the seed.
+static inline uint64_t ac_hash_final_(uint64_t a, uint64_t b, uint64_t seed,
+                                      size_t size) {
+  a ^= ac_hash_secret_[1];
+  b ^= seed;
+  ac_hash_mum_(&a, &b);
+  return ac_hash_mix_(a ^ ac_hash_secret_[0] ^ size, b ^ ac_hash_secret_[1]);
+}
+
+// Hashes a key of up to 16 bytes.
+static inline uint64_t ac_hash_short_(const unsigned char* p, size_t size,
+                                      uint64_t seed) {
+  uint64_t a = 0, b = 0;
+  if (size >= 4) {
+    // Two overlapping pairs of 4-byte loads cover 4 to 16 bytes.
+    const size_t mid = (size >> 3) << 2;
+    a = (ac_hash_r4_(p) << 32) | ac_hash_r4_(p + mid);
+    b = (ac_hash_r4_(p + size - 4) << 32) | ac_hash_r4_(p + size - 4 - mid);
+  } else if (size) {
+    a = ac_hash_r3_(p, size);
+  }
+  return ac_hash_final_(a, b, seed, size);
+}
+
+static inline uint64_t ac_hash_seed(const void* data, size_t size,
+                                    uint64_t seed) {
+  const unsigned char* p = data;
+  seed = ac_hash_init_seed_(seed);
+  if (size <= 16) return ac_hash_short_(p, size, seed);
+
+  size_t i = size;
+  for (; i > 16; i -= 16, p += 16) seed = ac_hash_block_(p, seed);
+  // The last 16 bytes, overlapping the last block unless 'size' is a multiple
+  // of 16.
+  return ac_hash_final_(ac_hash_r8_(p + i - 16), ac_hash_r8_(p + i - 8), seed,
+                        size);
+}
+
+static inline ac_hash_state ac_hash_begin(uint64_t seed) {
+  return (ac_hash_state){.seed = ac_hash_init_seed_(seed)};
+}
+
+static inline void ac_hash_update(ac_hash_state* x, const void* data,
+                                  size_t size) {
+  const unsigned char* p = data;
+  x->len += size;
+  while (size) {
+    // A full block is hashed once more bytes follow it, since the last block
+    // is hashed differently.
+    if (x->pending == 16) {
+      x->seed = ac_hash_block_(x->buf + 16, x->seed);
+      memcpy(x->buf, x->buf + 16, 16);
+      x->pending = 0;
+    }
+    if (!x->pending && size > 16) {
+      const unsigned char* last = p;
+      for (; size > 16; size -= 16, p += 16) {
+        x->seed = ac_hash_block_(p, x->seed);
+        last = p;
+      }
+      memcpy(x->buf, last, 16);
+    }
+    const size_t n = size < 16 - x->pending ? size : 16 - x->pending;
+    memcpy(x->buf + 16 + x->pending, p, n);
+    x->pending += n;
+    p += n;
+    size -= n;
+  }
+}
+
+static inline uint64_t ac_hash_end(const ac_hash_state* x) {
+  if (x->len <= 16) return ac_hash_short_(x->buf + 16, x->len, x->seed);
+  // The last 16 bytes end with the pending ones.
+  const unsigned char* last = x->buf + x->pending;
+  return ac_hash_final_(ac_hash_r8_(last), ac_hash_r8_(last + 8), x->seed,
+                        x->len);
+}
+
+#endif  // AC_HASH_H_
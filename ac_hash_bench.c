@@ -0,0 +1,58 @@
+// Compares the throughput of 'ac_hash' with 'ac_crc32' over key sizes from a
+// few bytes to whole buffers. Only meaningful in optimized builds:
+//
+//   make OPT=1 ac_hash_bench && build/ac_hash_bench
+//
+#include <stdio.h>
+
+#include "ac_hash.h"
+
+#define AC_CRC32_IMPL
+#include "ac_crc32.h"
+
+#define AC_TIME_IMPL
+#include "ac_time.h"
+
+enum {
+  AC_HASH_BENCH_BUF = 1 << 20,    // Keys are consecutive slices of this.
+  AC_HASH_BENCH_BYTES = 1 << 28,  // Hashed per measurement.
+};
+
+// Keeps the hashes alive so the loops aren't optimized out.
+static volatile uint64_t ac_hash_bench_sink_;
+
+// Returns the nanoseconds per key.
+static inline double ac_hash_bench_run_(const unsigned char* buf, size_t size,
+                                        bool crc) {
+  const size_t keys = AC_HASH_BENCH_BUF / size;
+  const size_t rounds = AC_HASH_BENCH_BYTES / (keys * size);
+  uint64_t sum = 0;
+  const ac_cputime t0 = ac_cputime_now();
+  for (size_t r = 0; r < rounds; ++r) {
+    for (size_t i = 0; i < keys; ++i) {
+      sum += crc ? ac_crc32(buf + i * size, size, 0)
+                 : ac_hash(buf + i * size, size);
+    }
+  }
+  const ac_dcputime dt = ac_cputime_diff(ac_cputime_now(), t0);
+  ac_hash_bench_sink_ = sum;
+  return 1e9 * dt.cpu_dticks / ac_cputime_freq() / (rounds * keys);
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  static unsigned char buf[AC_HASH_BENCH_BUF];
+  for (size_t i = 0; i < sizeof(buf); ++i) buf[i] = i * 131 + (i >> 9);
+
+  const size_t sizes[] = {4, 8, 16, 32, 64, 256, 4096, AC_HASH_BENCH_BUF};
+  printf("%-8s %12s %12s %12s %12s\n", "bytes", "hash ns", "crc32 ns",
+         "hash GB/s", "crc32 GB/s");
+  for (size_t i = 0; i < ac_array_len(sizes); ++i) {
+    const double hash = ac_hash_bench_run_(buf, sizes[i], false);
+    const double crc = ac_hash_bench_run_(buf, sizes[i], true);
+    printf("%-8zu %12.2f %12.2f %12.2f %12.2f\n", sizes[i], hash, crc,
+           sizes[i] / hash, sizes[i] / crc);
+  }
+  return 0;
+}
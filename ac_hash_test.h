@@ -0,0 +1,115 @@
+#ifndef AC_HASH_TEST_H_
+#define AC_HASH_TEST_H_
+
+#include "ac_hash.h"
+#include "ac_mem.h"
+#include "ac_str.h"
+#include "ac_test.h"
+
+//------------------------------------------------------------------------------
+// Hashing
+//------------------------------------------------------------------------------
+
+static inline void hash_chunks_match_whole(ac_test_state* s) {
+  ac_test_begin(s);
+
+  unsigned char data[100];
+  for (size_t i = 0; i < sizeof(data); ++i) data[i] = (unsigned char)(i * 7);
+
+  // Every length, split at every point, and fed byte by byte.
+  size_t mismatches = 0;
+  for (size_t size = 0; size <= sizeof(data); ++size) {
+    const uint64_t whole = ac_hash_seed(data, size, 42);
+    for (size_t split = 0; split <= size; ++split) {
+      ac_hash_state h = ac_hash_begin(42);
+      ac_hash_update(&h, data, split);
+      ac_hash_update(&h, data + split, size - split);
+      mismatches += ac_hash_end(&h) != whole;
+    }
+    ac_hash_state h = ac_hash_begin(42);
+    for (size_t i = 0; i < size; ++i) ac_hash_update(&h, data + i, 1);
+    mismatches += ac_hash_end(&h) != whole;
+  }
+  ac_test_equ(mismatches, 0);
+}
+
+static inline void hash_wrappers_and_seeds(ac_test_state* s) {
+  ac_test_begin(s);
+
+  char text[] = "the quick brown fox jumps over the lazy dog";
+  const size_t len = strlen(text);
+  const uint64_t h = ac_hash(text, len);
+
+  ac_str str = ac_str_init(ac_mallocator2());
+  ac_to_str(&str, "%s", text);
+  ac_test_equ(ac_hash_str(str, 0), h);
+  ac_test_equ(ac_hash_buf((ac_buf){(unsigned char*)text, len}, 0), h);
+  ac_test_equ(ac_hash_span(((ac_span(char)){text, len}), 0), h);
+  ac_str_free(&str);
+
+  // Seeds and lengths change the hash.
+  ac_test_neu(ac_hash_seed(text, len, 1), h);
+  ac_test_neu(ac_hash_seed(text, len, 1), ac_hash_seed(text, len, 2));
+  ac_test_neu(ac_hash(text, len - 1), h);
+  ac_test_neu(ac_hash("", 0), ac_hash("\0", 1));
+}
+
+static inline void hash_avalanche(ac_test_state* s) {
+  ac_test_begin(s);
+
+  // Flipping any input bit should flip about half of the output bits, for
+  // short and long keys alike.
+  unsigned char data[64] = {};
+  const size_t sizes[] = {1, 3, 4, 8, 13, 16, 17, 32, 64};
+  for (size_t k = 0; k < ac_array_len(sizes); ++k) {
+    const size_t size = sizes[k];
+    const uint64_t h = ac_hash(data, size);
+    size_t flipped = 0;
+    for (size_t bit = 0; bit < size * 8; ++bit) {
+      data[bit / 8] ^= 1 << (bit % 8);
+      flipped += __builtin_popcountll(ac_hash(data, size) ^ h);
+      data[bit / 8] ^= 1 << (bit % 8);
+    }
+    const double average = (double)flipped / (size * 8);
+    ac_test_expect(average > 28 && average < 36, "size: %zu average: %f",
+                   size, average);
+  }
+}
+
+static inline int ac_hash_test_cmp_u64_(const void* a, const void* b) {
+  const uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return (x > y) - (x < y);
+}
+
+static inline void hash_no_collisions(ac_test_state* s) {
+  ac_test_begin(s);
+
+  // Sequential integers, as strings and as raw bytes.
+  enum { count = 100000 };
+  uint64_t* hashes = malloc(2 * count * sizeof(uint64_t));
+  char key[32];
+  for (uint32_t i = 0; i < count; ++i) {
+    const int len = snprintf(key, sizeof(key), "key%u", i);
+    hashes[i] = ac_hash(key, len);
+    hashes[count + i] = ac_hash(&i, sizeof(i));
+  }
+
+  // Sort, then count equal neighbors.
+  qsort(hashes, 2 * count, sizeof(uint64_t), &ac_hash_test_cmp_u64_);
+  size_t collisions = 0;
+  for (size_t i = 1; i < 2 * count; ++i) {
+    collisions += hashes[i] == hashes[i - 1];
+  }
+  ac_test_equ(collisions, 0);
+  free(hashes);
+}
+
+static inline void ac_hash_test(ac_test_state* s) {
+  ac_test_begin(s);
+  ac_test_run(hash_chunks_match_whole);
+  ac_test_run(hash_wrappers_and_seeds);
+  ac_test_run(hash_avalanche);
+  ac_test_run(hash_no_collisions);
+}
+
+#endif  // AC_HASH_TEST_H_
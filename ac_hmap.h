@@ -0,0 +1,426 @@
+#ifndef AC_HMAP_H_
+#define AC_HMAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ac_alloc.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+//------------------------------------------------------------------------------
+// Hash Map.
+//------------------------------------------------------------------------------
+
+// An open addressing hash map in the style of SwissTable, generated per key and
+// value type like 'ac_lista_define_type'.
+//  - Every slot has a control byte: empty, deleted (a tombstone), or the low 7
+//    bits of the hash of its key. Lookups compare 16 control bytes at a time
+//    (with SSE2 or NEON where available), and only touch the entries whose
+//    7 bits match, so most misses never compare a key.
+//  - Capacity is a power of two, at least 16, filled to at most 7/8.
+//  - Erasing leaves a tombstone, which inserts may reuse. Tombstones are
+//    dropped when the table is rehashed.
+//  - Entries move when the table grows, so pointers into it are invalidated by
+//    inserts (but not by lookups or erases).
+//
+// The hash function must be 'uint64_t hash(K)' and the equality function
+// 'bool eq(K, K)'. Hashes are mixed before use, so e.g. an integer key may be
+// its own hash. Key and value types must be single identifiers (use typedefs).
+//
+//   static uint64_t my_hash(my_key k) { ... }
+//   static bool my_eq(my_key a, my_key b) { ... }
+//   ac_hmap_define_type(my_key, my_value, my_hash, my_eq);
+//
+//   ac_hmap(my_key, my_value) map = {};  // Or {.alloc = some_allocator}.
+//   ac_hmap_fn(my_key, my_value, insert)(&map, key, value);
+//   my_value* v = ac_hmap_fn(my_key, my_value, find)(&map, key);
+//   ac_hmap_fn(my_key, my_value, free)(&map);
+//
+// To iterate, visit the entries whose control bytes are full:
+//
+//   for (size_t i = 0; i < map.cap; ++i) {
+//     if (ac_hmap_is_full(map.ctrl[i])) use(map.entries[i]);
+//   }
+
+// Number of control bytes compared at once.
+enum { AC_HMAP_GROUP = 16 };
+
+// Control bytes of slots without an entry. Full slots have the high bit clear.
+enum { AC_HMAP_EMPTY = 0x80, AC_HMAP_DELETED = 0xFE };
+
+#define ac_hmap(K, V) ac_hmap_##K##_##V
+#define ac_hmap_entry(K, V) ac_hmap_entry_##K##_##V
+
+// Name of a function generated for a map type, e.g. ac_hmap_fn(K, V, find).
+#define ac_hmap_fn(K, V, name) ac_hmap_##K##_##V##_##name
+
+// Returns whether a control byte belongs to a slot with an entry.
+static inline bool ac_hmap_is_full(uint8_t ctrl) { return ctrl < 0x80; }
+
+// Defines 'ac_hmap(K, V)', its entry type, and these functions:
+//
+// Frees the table memory and clears the map, keeping its allocator.
+//   void free(map*)
+//
+// Removes all entries, keeping the table memory.
+//   void clear(map*)
+//
+// Rebuilds the table with room for at least 'n' entries (and never fewer than
+// the map holds), dropping all tombstones. Returns false if allocation failed,
+// leaving the map untouched.
+//   bool rehash(map*, size_t n)
+//
+// Makes room for 'n' entries, so inserting up to that many won't rehash.
+// Returns false if allocation failed.
+//   bool reserve(map*, size_t n)
+//
+// Returns the value of 'key', or NULL if it isn't in the map.
+//   V* find(const map*, K key)
+//
+// Returns the value of 'key', adding an entry with an uninitialized value if
+// it isn't in the map yet, and sets '*inserted' accordingly (if not NULL).
+// Returns NULL if the table couldn't grow.
+//   V* find_or_insert(map*, K key, bool* inserted)
+//
+// Sets the value of 'key'. Returns a pointer to it, or NULL if the table
+// couldn't grow.
+//   V* insert(map*, K key, V value)
+//
+// Removes 'key'. Returns false if it wasn't in the map.
+//   bool erase(map*, K key)
+//
+// If the map has no allocator when it first allocates, the mallocator is used.
+#define ac_hmap_define_type(K, V, hash, eq)                                  \
+  typedef struct ac_hmap_entry(K, V) {                                       \
+    K key;                                                                   \
+    V value;                                                                 \
+  } ac_hmap_entry(K, V);                                                     \
+                                                                             \
+  typedef struct ac_hmap(K, V) {                                             \
+    ac_allocator2 alloc;                                                     \
+    ac_hmap_entry(K, V) * entries;                                           \
+    uint8_t* ctrl;       /* 'cap' bytes, then a copy of the first group. */  \
+    size_t len;          /* Number of entries. */                            \
+    size_t cap;          /* Number of slots. */                              \
+    size_t growth_left;  /* Inserts into empty slots before rehashing. */    \
+  } ac_hmap(K, V);                                                           \
+                                                                             \
+  static inline void ac_hmap_fn(K, V, free)(ac_hmap(K, V) * m) {             \
+    if (m->cap) {                                                            \
+      ac_free2(m->alloc,                                                     \
+               ac_hmap_table_mem_(m->entries, m->cap,                        \
+                                  sizeof(ac_hmap_entry(K, V)),               \
+                                  _Alignof(ac_hmap_entry(K, V))));           \
+    }                                                                        \
+    *m = (ac_hmap(K, V)){.alloc = m->alloc};                                 \
+  }                                                                          \
+                                                                             \
+  static inline void ac_hmap_fn(K, V, clear)(ac_hmap(K, V) * m) {            \
+    if (!m->cap) return;                                                     \
+    memset(m->ctrl, AC_HMAP_EMPTY, m->cap + AC_HMAP_GROUP);                  \
+    m->len = 0;                                                              \
+    m->growth_left = ac_hmap_max_load_(m->cap);                              \
+  }                                                                          \
+                                                                             \
+  /* Moves all entries into a new table of 'cap' slots. */                   \
+  static inline bool ac_hmap_fn(K, V, resize_)(ac_hmap(K, V) * m,            \
+                                               size_t cap) {                 \
+    if (ac_allocator2_is_empty(m->alloc) && !m->cap) {                       \
+      m->alloc = ac_mallocator2();                                           \
+    }                                                                        \
+    uint8_t* ctrl = NULL;                                                    \
+    ac_hmap_entry(K, V)* entries = ac_hmap_table_alloc_(                     \
+        m->alloc, cap, sizeof(ac_hmap_entry(K, V)),                          \
+        _Alignof(ac_hmap_entry(K, V)), &ctrl);                               \
+    if (!entries) return false;                                              \
+                                                                             \
+    for (size_t i = 0; i < m->cap; ++i) {                                    \
+      if (!ac_hmap_is_full(m->ctrl[i])) continue;                            \
+      const uint64_t h = ac_hmap_mix_(hash(m->entries[i].key));              \
+      const size_t j = ac_hmap_find_free_(ctrl, cap, h);                     \
+      ac_hmap_set_ctrl_(ctrl, cap, j, ac_hmap_h2_(h));                       \
+      entries[j] = m->entries[i];                                            \
+    }                                                                        \
+                                                                             \
+    const size_t len = m->len;                                               \
+    ac_hmap_fn(K, V, free)(m);                                               \
+    m->entries = entries;                                                    \
+    m->ctrl = ctrl;                                                          \
+    m->len = len;                                                            \
+    m->cap = cap;                                                            \
+    m->growth_left = ac_hmap_max_load_(cap) - len;                           \
+    return true;                                                             \
+  }                                                                          \
+                                                                             \
+  static inline bool ac_hmap_fn(K, V, rehash)(ac_hmap(K, V) * m,             \
+                                              size_t n) {                    \
+    if (n < m->len) n = m->len;                                              \
+    return ac_hmap_fn(K, V, resize_)(m, ac_hmap_cap_for_(n));                \
+  }                                                                          \
+                                                                             \
+  static inline bool ac_hmap_fn(K, V, reserve)(ac_hmap(K, V) * m,            \
+                                               size_t n) {                   \
+    if (n <= m->len + m->growth_left) return true;                           \
+    return ac_hmap_fn(K, V, rehash)(m, n);                                   \
+  }                                                                          \
+                                                                             \
+  /* Returns the slot of 'key' with hash 'h', or 'cap' if there is none. */  \
+  static inline size_t ac_hmap_fn(K, V, find_slot_)(const ac_hmap(K, V) * m, \
+                                                    K key, uint64_t h) {     \
+    const size_t mask = m->cap - 1;                                          \
+    size_t pos = ac_hmap_h1_(h) & mask;                                      \
+    for (size_t step = AC_HMAP_GROUP;; step += AC_HMAP_GROUP) {              \
+      const ac_hmap_group_ g = ac_hmap_group_load_(m->ctrl + pos);           \
+      uint64_t bits = ac_hmap_group_match_(g, ac_hmap_h2_(h));               \
+      for (; bits; bits &= bits - 1) {                                       \
+        const size_t i = (pos + ac_hmap_bits_index_(bits)) & mask;           \
+        if (eq(m->entries[i].key, key)) return i;                            \
+      }                                                                      \
+      if (ac_hmap_group_match_empty_(g)) return m->cap;                      \
+      pos = (pos + step) & mask;                                             \
+    }                                                                        \
+  }                                                                          \
+                                                                             \
+  static inline V* ac_hmap_fn(K, V, find)(const ac_hmap(K, V) * m, K key) {  \
+    if (!m->len) return NULL;                                                \
+    const size_t i =                                                         \
+        ac_hmap_fn(K, V, find_slot_)(m, key, ac_hmap_mix_(hash(key)));       \
+    return i < m->cap ? &m->entries[i].value : NULL;                         \
+  }                                                                          \
+                                                                             \
+  static inline V* ac_hmap_fn(K, V, find_or_insert)(                         \
+      ac_hmap(K, V) * m, K key, bool* inserted) {                            \
+    if (inserted) *inserted = false;                                         \
+    const uint64_t h = ac_hmap_mix_(hash(key));                              \
+    if (m->len) {                                                            \
+      const size_t i = ac_hmap_fn(K, V, find_slot_)(m, key, h);              \
+      if (i < m->cap) return &m->entries[i].value;                           \
+    }                                                                        \
+                                                                             \
+    /* Out of empty slots: grow, or just drop the tombstones if the map */   \
+    /* fills at most 25/32 of the table, so that at least 3/32 of it is */   \
+    /* left to fill before the next rehash. */                               \
+    if (!m->growth_left) {                                                   \
+      size_t cap = ac_hmap_cap_for_(ac_hmap_max_load_(m->cap) + 1);          \
+      if (m->cap && m->len * 32 <= m->cap * 25) cap = m->cap;                \
+      if (!ac_hmap_fn(K, V, resize_)(m, cap)) return NULL;                   \
+    }                                                                        \
+                                                                             \
+    const size_t i = ac_hmap_find_free_(m->ctrl, m->cap, h);                 \
+    if (m->ctrl[i] == AC_HMAP_EMPTY) --m->growth_left;                       \
+    ac_hmap_set_ctrl_(m->ctrl, m->cap, i, ac_hmap_h2_(h));                   \
+    m->entries[i].key = key;                                                 \
+    ++m->len;                                                                \
+    if (inserted) *inserted = true;                                          \
+    return &m->entries[i].value;                                             \
+  }                                                                          \
+                                                                             \
+  static inline V* ac_hmap_fn(K, V, insert)(ac_hmap(K, V) * m, K key,        \
+                                            V value) {                       \
+    V* v = ac_hmap_fn(K, V, find_or_insert)(m, key, NULL);                   \
+    if (v) *v = value;                                                       \
+    return v;                                                                \
+  }                                                                          \
+                                                                             \
+  static inline bool ac_hmap_fn(K, V, erase)(ac_hmap(K, V) * m, K key) {     \
+    if (!m->len) return false;                                               \
+    const size_t i =                                                         \
+        ac_hmap_fn(K, V, find_slot_)(m, key, ac_hmap_mix_(hash(key)));       \
+    if (i == m->cap) return false;                                           \
+    ac_hmap_set_ctrl_(m->ctrl, m->cap, i, AC_HMAP_DELETED);                  \
+    --m->len;                                                                \
+    return true;                                                             \
+  }                                                                          \
+                                                                             \
+  /* Declared again to take the semicolon after the macro. */                \
+  static inline bool ac_hmap_fn(K, V, erase)(ac_hmap(K, V) * m, K key)
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// Mixes a user hash so both the slot (high bits) and the control byte (low 7
+// bits) depend on all of its bits.
+static inline uint64_t ac_hmap_mix_(uint64_t h) {
+  h *= 0x9E3779B97F4A7C15ull;
+  return h ^ (h >> 32);
+}
+
+// Start of the probe sequence, and the control byte of a full slot.
+static inline size_t ac_hmap_h1_(uint64_t h) { return (size_t)(h >> 7); }
+static inline uint8_t ac_hmap_h2_(uint64_t h) { return h & 0x7F; }
+
+// Most entries a table of 'cap' slots holds: 7/8 of it.
+static inline size_t ac_hmap_max_load_(size_t cap) { return cap - cap / 8; }
+
+// Smallest capacity that holds 'n' entries.
+static inline size_t ac_hmap_cap_for_(size_t n) {
+  size_t cap = AC_HMAP_GROUP;
+  while (ac_hmap_max_load_(cap) < n) cap *= 2;
+  return cap;
+}
+
+// One group of control bytes, and bit masks of matches within it. Masks have
+// one bit per control byte, or a nibble on NEON, see 'ac_hmap_bits_index_'.
+#if defined(__SSE2__)
+
+typedef __m128i ac_hmap_group_;
+
+static inline ac_hmap_group_ ac_hmap_group_load_(const uint8_t* ctrl) {
+  return _mm_loadu_si128((const __m128i*)ctrl);
+}
+
+static inline uint64_t ac_hmap_group_match_(ac_hmap_group_ g, uint8_t h2) {
+  return (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(h2)));
+}
+
+static inline uint64_t ac_hmap_group_match_empty_(ac_hmap_group_ g) {
+  return ac_hmap_group_match_(g, AC_HMAP_EMPTY);
+}
+
+// Empty and deleted slots are those with the high bit set.
+static inline uint64_t ac_hmap_group_match_free_(ac_hmap_group_ g) {
+  return (uint16_t)_mm_movemask_epi8(g);
+}
+
+static inline size_t ac_hmap_bits_index_(uint64_t bits) {
+  return __builtin_ctzll(bits);
+}
+
+#elif defined(__ARM_NEON)
+
+typedef uint8x16_t ac_hmap_group_;
+
+static inline ac_hmap_group_ ac_hmap_group_load_(const uint8_t* ctrl) {
+  return vld1q_u8(ctrl);
+}
+
+// NEON has no movemask: narrowing each 16-bit lane by 4 bits packs the
+// comparison into a nibble per byte, of which the top bit is kept.
+static inline uint64_t ac_hmap_neon_bits_(uint8x16_t matches) {
+  const uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(matches), 4);
+  return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) &
+         0x8888888888888888ull;
+}
+
+static inline uint64_t ac_hmap_group_match_(ac_hmap_group_ g, uint8_t h2) {
+  return ac_hmap_neon_bits_(vceqq_u8(g, vdupq_n_u8(h2)));
+}
+
+static inline uint64_t ac_hmap_group_match_empty_(ac_hmap_group_ g) {
+  return ac_hmap_group_match_(g, AC_HMAP_EMPTY);
+}
+
+static inline uint64_t ac_hmap_group_match_free_(ac_hmap_group_ g) {
+  return ac_hmap_neon_bits_(vcltq_s8(vreinterpretq_s8_u8(g), vdupq_n_s8(0)));
+}
+
+static inline size_t ac_hmap_bits_index_(uint64_t bits) {
+  return __builtin_ctzll(bits) / 4;
+}
+
+#else
+
+typedef struct ac_hmap_group_ {
+  uint8_t ctrl[AC_HMAP_GROUP];
+} ac_hmap_group_;
+
+static inline ac_hmap_group_ ac_hmap_group_load_(const uint8_t* ctrl) {
+  ac_hmap_group_ g;
+  memcpy(g.ctrl, ctrl, AC_HMAP_GROUP);
+  return g;
+}
+
+static inline uint64_t ac_hmap_group_match_(ac_hmap_group_ g, uint8_t h2) {
+  uint64_t bits = 0;
+  for (size_t i = 0; i < AC_HMAP_GROUP; ++i) {
+    bits |= (uint64_t)(g.ctrl[i] == h2) << i;
+  }
+  return bits;
+}
+
+static inline uint64_t ac_hmap_group_match_empty_(ac_hmap_group_ g) {
+  return ac_hmap_group_match_(g, AC_HMAP_EMPTY);
+}
+
+static inline uint64_t ac_hmap_group_match_free_(ac_hmap_group_ g) {
+  uint64_t bits = 0;
+  for (size_t i = 0; i < AC_HMAP_GROUP; ++i) {
+    bits |= (uint64_t)(g.ctrl[i] >> 7) << i;
+  }
+  return bits;
+}
+
+static inline size_t ac_hmap_bits_index_(uint64_t bits) {
+  return __builtin_ctzll(bits);
+}
+
+#endif
+
+// Sets a control byte, and its copy past the end if it's in the first group.
+// The copy lets a group be loaded at any slot without wrapping around.
+static inline void ac_hmap_set_ctrl_(uint8_t* ctrl, size_t cap, size_t i,
+                                     uint8_t c) {
+  ctrl[i] = c;
+  if (i < AC_HMAP_GROUP) ctrl[cap + i] = c;
+}
+
+// Returns the first empty or deleted slot on the probe sequence of hash 'h'.
+// Probing moves by 1, 2, 3, ... groups, which visits every group of a
+// power-of-two table.
+static inline size_t ac_hmap_find_free_(const uint8_t* ctrl, size_t cap,
+                                        uint64_t h) {
+  const size_t mask = cap - 1;
+  size_t pos = ac_hmap_h1_(h) & mask;
+  for (size_t step = AC_HMAP_GROUP;; step += AC_HMAP_GROUP) {
+    const uint64_t bits =
+        ac_hmap_group_match_free_(ac_hmap_group_load_(ctrl + pos));
+    if (bits) return (pos + ac_hmap_bits_index_(bits)) & mask;
+    pos = (pos + step) & mask;
+  }
+}
+
+static inline size_t ac_hmap_align_up_(size_t size, size_t align) {
+  return (size + align - 1) & ~(align - 1);
+}
+
+// Table memory: the entries, then the control bytes at the next multiple of
+// the group size.
+static inline size_t ac_hmap_table_ctrl_offset_(size_t cap,
+                                                size_t entry_size) {
+  return ac_hmap_align_up_(cap * entry_size, AC_HMAP_GROUP);
+}
+
+static inline size_t ac_hmap_table_align_(size_t entry_align) {
+  return entry_align > AC_HMAP_GROUP ? entry_align : AC_HMAP_GROUP;
+}
+
+static inline ac_mem ac_hmap_table_mem_(void* entries, size_t cap,
+                                        size_t entry_size, size_t entry_align) {
+  const size_t size =
+      ac_hmap_table_ctrl_offset_(cap, entry_size) + cap + AC_HMAP_GROUP;
+  return (ac_mem){entries,
+                  ac_hmap_align_up_(size, ac_hmap_table_align_(entry_align))};
+}
+
+// Allocates a table of 'cap' empty slots. Returns the entries, or NULL.
+static inline void* ac_hmap_table_alloc_(ac_allocator2 alloc, size_t cap,
+                                         size_t entry_size, size_t entry_align,
+                                         uint8_t** ctrl) {
+  const ac_mem m = ac_alloc2_aligned(
+      alloc, ac_hmap_table_align_(entry_align),
+      ac_hmap_table_mem_(NULL, cap, entry_size, entry_align).cap);
+  if (!m.data) return NULL;
+  *ctrl = (uint8_t*)m.data + ac_hmap_table_ctrl_offset_(cap, entry_size);
+  memset(*ctrl, AC_HMAP_EMPTY, cap + AC_HMAP_GROUP);
+  return m.data;
+}
+
+#endif  // AC_HMAP_H_
@@ -0,0 +1,191 @@
+#ifndef AC_HMAP_TEST_H_
+#define AC_HMAP_TEST_H_
+
+#include "ac_alloc.h"
+#include "ac_hmap.h"
+#include "ac_test.h"
+#include "ac_tracking.h"
+
+static inline uint64_t ac_hmap_test_hash_u64_(uint64_t x) { return x; }
+static inline bool ac_hmap_test_eq_u64_(uint64_t a, uint64_t b) {
+  return a == b;
+}
+ac_hmap_define_type(uint64_t, uint64_t, ac_hmap_test_hash_u64_,
+                    ac_hmap_test_eq_u64_);
+
+// FNV-1a.
+typedef const char* ac_hmap_test_cstr_;
+static inline uint64_t ac_hmap_test_hash_cstr_(ac_hmap_test_cstr_ s) {
+  uint64_t h = 0xCBF29CE484222325ull;
+  for (; *s; ++s) h = (h ^ (unsigned char)*s) * 0x100000001B3ull;
+  return h;
+}
+static inline bool ac_hmap_test_eq_cstr_(ac_hmap_test_cstr_ a,
+                                         ac_hmap_test_cstr_ b) {
+  return !strcmp(a, b);
+}
+ac_hmap_define_type(ac_hmap_test_cstr_, int32_t, ac_hmap_test_hash_cstr_,
+                    ac_hmap_test_eq_cstr_);
+
+typedef ac_hmap(uint64_t, uint64_t) ac_hmap_test_u64_;
+#define ac_hmap_test_u64_fn_(name) ac_hmap_fn(uint64_t, uint64_t, name)
+#define ac_hmap_test_cstr_fn_(name) \
+  ac_hmap_fn(ac_hmap_test_cstr_, int32_t, name)
+
+//------------------------------------------------------------------------------
+// Hash Map
+//------------------------------------------------------------------------------
+
+static inline void hmap_insert_find_erase(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_hmap_test_u64_ map = {};
+  ac_test_equ(map.len, 0);
+  ac_test_expect(!ac_hmap_test_u64_fn_(find)(&map, 1), "Found in empty map.");
+  ac_test_expect(!ac_hmap_test_u64_fn_(erase)(&map, 1),
+                 "Erased from empty map.");
+
+  // Multiples of a power of two, to check that hashes are mixed.
+  for (uint64_t i = 0; i < 10000; ++i) {
+    if (!ac_test_expect(ac_hmap_test_u64_fn_(insert)(&map, i << 20, i),
+                        "Insert failed.")) {
+      return;
+    }
+  }
+  ac_test_equ(map.len, 10000);
+  ac_test_leu(map.len, map.cap - map.cap / 8);
+
+  size_t found = 0;
+  for (uint64_t i = 0; i < 10000; ++i) {
+    const uint64_t* v = ac_hmap_test_u64_fn_(find)(&map, i << 20);
+    found += v && *v == i;
+  }
+  ac_test_equ(found, 10000);
+  ac_test_expect(!ac_hmap_test_u64_fn_(find)(&map, 1), "Found a missing key.");
+
+  // Overwrite.
+  bool inserted = true;
+  uint64_t* v = ac_hmap_test_u64_fn_(find_or_insert)(&map, 5 << 20, &inserted);
+  ac_test_expect(v && *v == 5 && !inserted, "Existing key was inserted.");
+  ac_hmap_test_u64_fn_(insert)(&map, 5 << 20, 50);
+  ac_test_equ(*ac_hmap_test_u64_fn_(find)(&map, 5 << 20), 50);
+  ac_test_equ(map.len, 10000);
+
+  // Erase the even keys.
+  for (uint64_t i = 0; i < 10000; i += 2) {
+    ac_test_expect(ac_hmap_test_u64_fn_(erase)(&map, i << 20),
+                   "key: %" PRIu64, i << 20);
+  }
+  ac_test_expect(!ac_hmap_test_u64_fn_(erase)(&map, 0), "Erased twice.");
+  ac_test_equ(map.len, 5000);
+  found = 0;
+  for (uint64_t i = 0; i < 10000; ++i) {
+    found += ac_hmap_test_u64_fn_(find)(&map, i << 20) != NULL;
+  }
+  ac_test_equ(found, 5000);
+
+  // Iterating visits exactly the remaining entries.
+  size_t visited = 0;
+  bool all_odd = true;
+  for (size_t i = 0; i < map.cap; ++i) {
+    if (!ac_hmap_is_full(map.ctrl[i])) continue;
+    ++visited;
+    all_odd &= (map.entries[i].key >> 20) % 2 == 1;
+  }
+  ac_test_equ(visited, 5000);
+  ac_test_expect(all_odd, "Visited an erased entry.");
+
+  ac_hmap_test_u64_fn_(clear)(&map);
+  ac_test_equ(map.len, 0);
+  ac_test_expect(!ac_hmap_test_u64_fn_(find)(&map, 1 << 20),
+                 "Found a key after clearing.");
+
+  ac_hmap_test_u64_fn_(free)(&map);
+  ac_test_equ(map.cap, 0);
+}
+
+static inline void hmap_tombstones_are_reused(ac_test_state* s) {
+  ac_test_begin(s);
+
+  // A sliding window of keys leaves a tombstone behind every insert. The
+  // table must drop them rather than grow.
+  ac_hmap_test_u64_ map = {};
+  for (uint64_t i = 0; i < 100000; ++i) {
+    ac_hmap_test_u64_fn_(insert)(&map, i, i);
+    if (i >= 8) ac_hmap_test_u64_fn_(erase)(&map, i - 8);
+  }
+  ac_test_equ(map.len, 8);
+  ac_test_equ(map.cap, AC_HMAP_GROUP);
+  for (uint64_t i = 100000 - 8; i < 100000; ++i) {
+    ac_test_expect(ac_hmap_test_u64_fn_(find)(&map, i), "key: %" PRIu64, i);
+  }
+  ac_hmap_test_u64_fn_(free)(&map);
+}
+
+static inline void hmap_reserve_and_rehash(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_tracking tracking;
+  ac_tracking_init(&tracking, ac_mallocator2());
+  ac_hmap_test_u64_ map = {.alloc = ac_tracking_allocator2(&tracking)};
+
+  // No rehashing after reserving.
+  ac_test_expect(ac_hmap_test_u64_fn_(reserve)(&map, 1000), "Reserve failed.");
+  const size_t cap = map.cap;
+  for (uint64_t i = 0; i < 1000; ++i) ac_hmap_test_u64_fn_(insert)(&map, i, i);
+  ac_test_equ(map.cap, cap);
+  ac_test_equ(ac_tracking_stats_of(&tracking.counters).allocs, 1);
+
+  // Shrink to fit what's left.
+  for (uint64_t i = 10; i < 1000; ++i) ac_hmap_test_u64_fn_(erase)(&map, i);
+  ac_test_expect(ac_hmap_test_u64_fn_(rehash)(&map, 0), "Rehash failed.");
+  ac_test_equ(map.cap, AC_HMAP_GROUP);
+  ac_test_equ(map.len, 10);
+  ac_test_equ(map.growth_left, AC_HMAP_GROUP - AC_HMAP_GROUP / 8 - 10);
+  for (uint64_t i = 0; i < 10; ++i) {
+    const uint64_t* v = ac_hmap_test_u64_fn_(find)(&map, i);
+    ac_test_expect(v && *v == i, "key: %" PRIu64, i);
+  }
+
+  ac_hmap_test_u64_fn_(free)(&map);
+  ac_test_equ(ac_tracking_stats_of(&tracking.counters).live_bytes, 0);
+}
+
+static inline void hmap_string_keys(ac_test_state* s) {
+  ac_test_begin(s);
+
+  static const char* const words[] = {
+      "alpha", "beta",  "gamma", "delta",   "epsilon", "zeta",
+      "eta",   "theta", "iota",  "kappa",   "lambda",  "mu",
+      "nu",    "xi",    "pi",    "omicron", "rho",     "sigma",
+      "tau",   "phi",   "chi",   "upsilon", "psi",     "omega",
+  };
+  const size_t n = sizeof(words) / sizeof(words[0]);
+
+  ac_hmap(ac_hmap_test_cstr_, int32_t) map = {};
+  for (size_t i = 0; i < n; ++i) {
+    ac_hmap_test_cstr_fn_(insert)(&map, words[i], i);
+  }
+
+  // Look up with copies, not the inserted pointers.
+  char key[16];
+  for (size_t i = 0; i < n; ++i) {
+    strcpy(key, words[i]);
+    const int32_t* v = ac_hmap_test_cstr_fn_(find)(&map, key);
+    ac_test_expect(v && *v == (int32_t)i, "key: %s", key);
+  }
+  ac_test_expect(!ac_hmap_test_cstr_fn_(find)(&map, "beth"),
+                 "Found a missing key.");
+
+  ac_hmap_test_cstr_fn_(free)(&map);
+}
+
+static inline void ac_hmap_test(ac_test_state* s) {
+  ac_test_begin(s);
+  ac_test_run(hmap_insert_find_erase);
+  ac_test_run(hmap_tombstones_are_reused);
+  ac_test_run(hmap_reserve_and_rehash);
+  ac_test_run(hmap_string_keys);
+}
+
+#endif  // AC_HMAP_TEST_H_
@@ -0,0 +1,134 @@
+#ifndef AC_INTERN_H_
+#define AC_INTERN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ac_alloc.h"
+#include "ac_hash.h"
+#include "ac_hmap.h"
+#include "ac_mem.h"
+#include "ac_str.h"
+
+//------------------------------------------------------------------------------
+// String Interning.
+//------------------------------------------------------------------------------
+
+// An intern table gives each distinct byte string a dense id: 0, 1, 2, ... in
+// order of first appearance. Each string is stored once, in an arena, so ids
+// can be compared and hashed as integers and turned back into strings in O(1).
+//  - Stored strings never move and are NUL-terminated, though they may also
+//    contain NUL bytes.
+//  - Strings can't be removed, other than by destroying the table.
+// Uses the arena functions, so AC_MEM_IMPL must be defined in one source file.
+
+// Id returned when a string is absent, or couldn't be added.
+enum { AC_INTERN_NONE = UINT32_MAX };
+
+static inline uint64_t ac_intern_hash_(ac_span_char s) {
+  return ac_hash(s.data, s.len);
+}
+
+static inline bool ac_intern_eq_(ac_span_char a, ac_span_char b) {
+  return a.len == b.len && !memcmp(a.data, b.data, a.len);
+}
+
+ac_hmap_define_type(ac_span_char, uint32_t, ac_intern_hash_, ac_intern_eq_);
+ac_lista_define_type(ac_span_char);
+
+// Intern table options.
+typedef struct ac_intern_opts {
+  ac_arena_opts arena;  // Storage for the strings.
+  ac_allocator2 alloc;  // Storage for the lookup tables.
+} ac_intern_opts;
+
+// Intern table state.
+typedef struct ac_intern {
+  ac_arena arena;
+  ac_hmap(ac_span_char, uint32_t) ids;  // String => id.
+  ac_lista(ac_span_char) strs;          // Id => string.
+} ac_intern;
+
+// Creates an empty table. See 'ac_arena_create' for the arena defaults; the
+// lookup tables default to ac_mallocator2().
+static inline ac_intern ac_intern_create(ac_intern_opts opts);
+
+// Frees the table and all of its strings.
+static inline void ac_intern_destroy(ac_intern*);
+
+// Returns the id of a string, adding it if it's new.
+// Returns AC_INTERN_NONE if allocation failed.
+static inline uint32_t ac_intern_add(ac_intern*, const void* data, size_t len);
+
+static inline uint32_t ac_intern_add_str(ac_intern* x, ac_str str) {
+  return ac_intern_add(x, str.data, str.len);
+}
+
+// Returns the id of a string, or AC_INTERN_NONE if it was never added.
+static inline uint32_t ac_intern_find(const ac_intern*, const void* data,
+                                      size_t len);
+
+// Returns the string of an id. The id must have been returned by the table.
+static inline ac_span_char ac_intern_get(const ac_intern* x, uint32_t id) {
+  return x->strs.data[id];
+}
+
+// Returns the number of distinct strings, which is also the next id.
+static inline size_t ac_intern_count(const ac_intern* x) {
+  return x->strs.len;
+}
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+static inline ac_intern ac_intern_create(ac_intern_opts opts) {
+  if (ac_allocator2_is_empty(opts.alloc)) opts.alloc = ac_mallocator2();
+  return (ac_intern){
+      .arena = ac_arena_create(opts.arena),
+      .ids = {.alloc = opts.alloc},
+      .strs = {.alloc = opts.alloc},
+  };
+}
+
+static inline void ac_intern_destroy(ac_intern* x) {
+  ac_arena_destroy(&x->arena);
+  ac_hmap_fn(ac_span_char, uint32_t, free)(&x->ids);
+  ac_lista_free(&x->strs);
+  *x = (ac_intern){};
+}
+
+static inline uint32_t ac_intern_add(ac_intern* x, const void* data,
+                                     size_t len) {
+  const uint32_t found = ac_intern_find(x, data, len);
+  if (found != AC_INTERN_NONE) return found;
+  if (x->strs.len == AC_INTERN_NONE) return AC_INTERN_NONE;
+
+  // New strings are rare once the table warms up, so they're simply hashed
+  // again to insert them.
+  char* copy = ac_arena_alloc(&x->arena, len + 1);
+  if (!copy) return AC_INTERN_NONE;
+  if (len) memcpy(copy, data, len);
+  copy[len] = '\0';
+
+  ac_span_char* str = ac_lista_next_ex(&x->strs);
+  if (!str) return AC_INTERN_NONE;
+  *str = (ac_span_char){copy, len};
+  const uint32_t id = x->strs.len - 1;
+  if (!ac_hmap_fn(ac_span_char, uint32_t, insert)(&x->ids, *str, id)) {
+    --x->strs.len;
+    return AC_INTERN_NONE;
+  }
+  return id;
+}
+
+static inline uint32_t ac_intern_find(const ac_intern* x, const void* data,
+                                      size_t len) {
+  const uint32_t* id = ac_hmap_fn(ac_span_char, uint32_t, find)(
+      &x->ids, (ac_span_char){(char*)data, len});
+  return id ? *id : AC_INTERN_NONE;
+}
+
+#endif  // AC_INTERN_H_
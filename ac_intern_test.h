@@ -0,0 +1,85 @@
+#ifndef AC_INTERN_TEST_H_
+#define AC_INTERN_TEST_H_
+
+#include "ac_intern.h"
+#include "ac_str.h"
+#include "ac_test.h"
+
+#define AC_MEM_IMPL
+#include "ac_mem.h"
+
+//------------------------------------------------------------------------------
+// String Interning
+//------------------------------------------------------------------------------
+
+static inline void intern_dense_ids(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_intern x = ac_intern_create((ac_intern_opts){});
+  ac_test_equ(ac_intern_add(&x, "alpha", 5), 0);
+  ac_test_equ(ac_intern_add(&x, "beta", 4), 1);
+  ac_test_equ(ac_intern_add(&x, "alpha", 5), 0);
+  ac_test_equ(ac_intern_add(&x, "", 0), 2);
+  ac_test_equ(ac_intern_add(&x, "a\0b", 3), 3);
+  ac_test_equ(ac_intern_add(&x, "a", 1), 4);
+  ac_test_equ(ac_intern_count(&x), 5);
+
+  ac_test_equ(ac_intern_find(&x, "beta", 4), 1);
+  ac_test_equ(ac_intern_find(&x, "gamma", 5), AC_INTERN_NONE);
+  ac_test_equ(ac_intern_find(&x, "alph", 4), AC_INTERN_NONE);
+
+  ac_str str = ac_str_init(ac_mallocator2());
+  ac_to_str(&str, "be%s", "ta");
+  ac_test_equ(ac_intern_add_str(&x, str), 1);
+  ac_str_free(&str);
+
+  // Stored strings are NUL-terminated copies.
+  const ac_span_char alpha = ac_intern_get(&x, 0);
+  ac_test_equ(alpha.len, 5);
+  ac_test_expect(!strcmp(alpha.data, "alpha"), "Got '%s'.", alpha.data);
+  const ac_span_char ab = ac_intern_get(&x, 3);
+  ac_test_expect(ab.len == 3 && !memcmp(ab.data, "a\0b", 4), "Wrong bytes.");
+  ac_test_equ(ac_intern_get(&x, 2).len, 0);
+
+  ac_intern_destroy(&x);
+}
+
+static inline void intern_many_strings(ac_test_state* s) {
+  ac_test_begin(s);
+
+  // Small arena blocks, so the strings span many of them.
+  ac_intern x =
+      ac_intern_create((ac_intern_opts){.arena = {.alloc_size = 4096}});
+  const char* first = ac_intern_get(&x, ac_intern_add(&x, "tag0", 4)).data;
+
+  enum { count = 10000 };
+  char tag[32];
+  size_t wrong_ids = 0;
+  for (int round = 0; round < 2; ++round) {
+    for (uint32_t i = 0; i < count; ++i) {
+      const int len = snprintf(tag, sizeof(tag), "tag%u", i);
+      wrong_ids += ac_intern_add(&x, tag, len) != i;
+    }
+  }
+  ac_test_equ(wrong_ids, 0);
+  ac_test_equ(ac_intern_count(&x), count);
+
+  // Strings never move as the table grows.
+  ac_test_expect(ac_intern_get(&x, 0).data == first, "String moved.");
+  size_t wrong_strs = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    snprintf(tag, sizeof(tag), "tag%u", i);
+    wrong_strs += strcmp(ac_intern_get(&x, i).data, tag) != 0;
+  }
+  ac_test_equ(wrong_strs, 0);
+
+  ac_intern_destroy(&x);
+}
+
+static inline void ac_intern_test(ac_test_state* s) {
+  ac_test_begin(s);
+  ac_test_run(intern_dense_ids);
+  ac_test_run(intern_many_strings);
+}
+
+#endif  // AC_INTERN_TEST_H_
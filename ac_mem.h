@@ -1,11 +1,13 @@
 #ifndef AC_MEM_H_
 #define AC_MEM_H_
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "ac_alloc.h"
 #include "ac_math.h"
 
 //------------------------------------------------------------------------------
@@ -237,6 +239,130 @@ static inline ac_allocator ac_mallocator() {
   };
 }
 
+//------------------------------------------------------------------------------
+// Allocation Through an ac_allocator2.
+//------------------------------------------------------------------------------
+
+// Header before each allocation of 'ac_allocator_from2'. The union keeps what
+// follows it aligned as malloc would.
+typedef union ac_allocator_from2_header_ {
+  ac_mem mem;
+  max_align_t align;
+} ac_allocator_from2_header_;
+
+static inline void* ac_call_alloc2_(void* state, size_t size) {
+  const size_t header = sizeof(ac_allocator_from2_header_);
+  if (size > SIZE_MAX - header) return NULL;
+  const ac_mem m = ac_alloc2(*(ac_allocator2*)state, header + size);
+  if (!m.data) return NULL;
+  ((ac_allocator_from2_header_*)m.data)->mem = m;
+  return (ac_allocator_from2_header_*)m.data + 1;
+}
+
+static inline void ac_call_free2_(void* state, void* ptr) {
+  if (!ptr) return;
+  const ac_mem m = ((ac_allocator_from2_header_*)ptr - 1)->mem;
+  ac_free2(*(ac_allocator2*)state, m);
+}
+
+// Returns an 'ac_allocator' that allocates through '*a', so APIs that still
+// take one (e.g. 'ac_gzip_inflate') can use 'ac_allocator2' wrappers like
+// 'ac_tracking_allocator2'.
+//  - '*a' must outlive the returned allocator.
+//  - Frees don't pass sizes, so each allocation starts with a header holding
+//    the 'ac_mem' to free, and is that much larger through '*a'.
+static inline ac_allocator ac_allocator_from2(ac_allocator2* a) {
+  return (ac_allocator){
+      .state = a,
+      .alloc = &ac_call_alloc2_,
+      .free = &ac_call_free2_,
+  };
+}
+
+//------------------------------------------------------------------------------
+// Page Mapping.
+//------------------------------------------------------------------------------
+
+// Large working sets mapped with 4 KiB pages suffer from TLB misses. Mappings
+// can opt into huge (2 MiB) pages instead.
+
+// Huge page policy for a mapping.
+typedef enum ac_huge_pages {
+  AC_HUGE_PAGES_NONE = 0,  // Regular pages.
+  AC_HUGE_PAGES_TRY,       // MAP_HUGETLB, else madvise(MADV_HUGEPAGE).
+} ac_huge_pages;
+
+// Backing obtained for a mapping, ordered from worst to best.
+typedef enum ac_page_backing {
+  AC_PAGE_BACKING_NONE = 0,     // Nothing mapped.
+  AC_PAGE_BACKING_DEFAULT,      // Regular pages.
+  AC_PAGE_BACKING_THP_ADVISED,  // 2 MiB aligned, with madvise(MADV_HUGEPAGE)
+                                // accepted and THP not disabled. Whether
+                                // huge pages back it is up to the kernel.
+  AC_PAGE_BACKING_HUGETLB,      // Reserved huge pages (MAP_HUGETLB).
+} ac_page_backing;
+
+// Returns a short name for the backing, e.g. for logging it in production.
+static inline const char* ac_page_backing_str(ac_page_backing b) {
+  switch (b) {
+    case AC_PAGE_BACKING_NONE: return "none";
+    case AC_PAGE_BACKING_DEFAULT: return "default";
+    case AC_PAGE_BACKING_THP_ADVISED: return "thp-advised";
+    case AC_PAGE_BACKING_HUGETLB: return "hugetlb";
+  }
+  return "unknown";
+}
+
+// Size of a huge page, and the alignment of mappings that try to use them.
+enum { AC_HUGE_PAGE_SIZE = 2 * 1024 * 1024 };
+
+// A mapping along with the backing obtained.
+typedef struct ac_page_map {
+  ac_buf buf;
+  ac_page_backing backing;
+} ac_page_map;
+
+// Maps at least 'size' bytes of zeroed, readable and writable memory.
+//  - The size is rounded up to whole pages (huge pages if requested).
+//  - Returns an empty mapping if it failed.
+ac_page_map ac_page_map_alloc(size_t size, ac_huge_pages);
+
+// Unmaps the mapping if it's non-NULL and has nonzero size.
+void ac_page_unmap(ac_page_map);
+
+// Maps the memory for a fully partitioned slab in one go.
+static inline ac_page_map ac_slab_map(const ac_slab* s, ac_huge_pages huge) {
+  return ac_page_map_alloc(ac_slab_size(s), huge);
+}
+
+//------------------------------------------------------------------------------
+// Block Pool.
+//------------------------------------------------------------------------------
+
+// A process-wide cache of equally sized blocks that threads hand to each other
+// without going back to malloc. It is a lock-free stack linked through the
+// first pointer of each block.
+//  - Giving a block back is a single compare-and-swap.
+//  - Taking one swaps out the whole stack, keeps the top block and pushes the
+//    rest back, which avoids the ABA problem of popping a single node. A
+//    thread racing with that briefly sees an empty pool and mallocs instead.
+typedef struct ac_block_pool {
+  size_t block_size;
+  _Atomic(unsigned char*) blocks;
+} ac_block_pool;
+
+// Initializes an empty pool of blocks of 'block_size' bytes.
+void ac_block_pool_init(ac_block_pool*, size_t block_size);
+
+// Returns a pooled block, or a newly malloc'd one if the pool is empty.
+unsigned char* ac_block_pool_take(ac_block_pool*);
+
+// Returns a block to the pool. Safe to call from any thread.
+void ac_block_pool_give(ac_block_pool*, unsigned char* block);
+
+// Frees all pooled blocks. No other thread may be using the pool.
+void ac_block_pool_destroy(ac_block_pool*);
+
 //------------------------------------------------------------------------------
 // Arena Allocation.
 //------------------------------------------------------------------------------
@@ -247,9 +373,10 @@ static inline ac_allocator ac_mallocator() {
 // free'd all at once (ease of use).
 //
 // Allocations are usually made from the current block.
-// Entire arena must be destroyed at once (individual allocs cannot be free'd).
-// If the current block cannot fit the next 'alloc', a new block is allocated
-//   and made current.
+// Individual allocs cannot be free'd, but the arena can be rewound to a
+//   savepoint or reset, recycling its blocks instead of freeing them.
+// If the current block cannot fit the next 'alloc', a new block is taken from
+//   the spare list (or allocated) and made current.
 // Memory is only ever allocated from the current block, EXCEPT
 // Allocations of 'alloc_size' / 2 receive their own block, leaving the current
 //   block unchaged.
@@ -262,9 +389,12 @@ typedef void (*ac_arena_free_fn)(void*);
 
 // Arena allocation options.
 typedef struct ac_arena_opts {
-  size_t alloc_size;  // Minimum size of each allocation.
+  size_t alloc_size;   // Minimum size of each allocation.
+  size_t block_align;  // Alignment of the usable part of each block.
   ac_arena_alloc_fn alloc;
   ac_arena_free_fn free;
+  ac_huge_pages huge_pages;  // Maps blocks directly instead of 'alloc'.
+  ac_block_pool* pool;       // Takes blocks from and gives them to a pool.
 } ac_arena_opts;
 
 // One node in the arena linked list.
@@ -275,25 +405,425 @@ typedef struct ac_arena_node {
 } ac_arena_node;
 
 // Arena allocation state.
+// Each block begins with a node describing the next block in its list.
 typedef struct ac_arena {
   ac_arena_opts opts;
-  ac_arena_node root;
+  ac_arena_node root;       // Current block, linked to previous blocks.
+  unsigned char* large;     // Blocks holding a single large allocation.
+  unsigned char* spare;     // Empty blocks retained for reuse.
+  ac_page_backing backing;  // Worst backing of any mapped block.
 } ac_arena;
 
+// Position in an arena to rewind to.
+typedef struct ac_arena_savepoint {
+  unsigned char* block;
+  size_t pos;
+  unsigned char* large;
+} ac_arena_savepoint;
+
 // Initialize a memory arena which allocates in blocks of 'alloc_size'.
 // Defaults are used for zero-initialized fields of opts.
 //   - alloc_size => 1 MiB
+//   - block_align => none beyond what 'alloc' returns
 //   - alloc => malloc
 //   - free => free
+// A cache line or page 'block_align' lets vector kernels run over whole
+// blocks; each block is over-allocated by 'block_align' - 1 bytes for it.
+// With 'huge_pages', blocks are mapped in multiples of 2 MiB (ignoring 'alloc'
+// and 'free') and 'backing' reports what was actually obtained.
+// With a 'pool', blocks are the pool's size and all the other options are
+// ignored. Blocks the arena frees go back to the pool, large ones to free().
 ac_arena ac_arena_create(ac_arena_opts);
 
 // Allocate memory from the given arena.
+//  - Allocations are packed without padding, see 'ac_arena_alloc_aligned'.
 void* ac_arena_alloc(ac_arena*, size_t);
 ac_buf ac_arena_alloc_buf(ac_arena*, size_t);
 
+// Allocate memory aligned to 'align' (a power of two) from the given arena.
+void* ac_arena_alloc_aligned(ac_arena*, size_t align, size_t size);
+
+// Allocate an aligned array of the given type and count from the arena.
+#define ac_arena_alloc_type(arena, element_type, element_count) \
+  ((element_type*)ac_arena_alloc_aligned(                       \
+      arena, _Alignof(element_type),                            \
+      sizeof(element_type) * (element_count)))
+
 // Free the entire arena.
 void ac_arena_destroy(ac_arena*);
 
+// Empties the arena, retaining up to 'keep_blocks' blocks (at least one) for
+// reuse and freeing the rest. Large allocations are always freed.
+// With a suitable 'keep_blocks', a steady-state loop of allocate/reset makes
+// no system allocations at all.
+void ac_arena_reset(ac_arena*, size_t keep_blocks);
+
+// Returns the current position, to rewind to with 'ac_arena_rewind'.
+ac_arena_savepoint ac_arena_mark(const ac_arena*);
+
+// Discards everything allocated after the savepoint was marked.
+//  - Emptied blocks are kept as spares, large allocations are freed.
+//  - Savepoints marked after this one (or before a reset) become invalid.
+void ac_arena_rewind(ac_arena*, ac_arena_savepoint);
+
+// Allocator adapter so that e.g. ac_lista and ac_str can draw from an arena.
+//  - Allocations are aligned like malloc's; 'ac_alloc2_aligned' is supported.
+//  - Growing the most recent allocation extends it in place if it fits.
+//  - Freeing the most recent allocation rolls the arena back; other frees are
+//    no-ops (the memory is reclaimed when the arena is destroyed).
+//  - The arena must outlive everything allocated through the adapter.
+ac_allocator2 ac_arena_allocator2(ac_arena*);
+
+//------------------------------------------------------------------------------
+// Thread-Safe Arena Allocation.
+//------------------------------------------------------------------------------
+
+// An arena that any number of threads can allocate from concurrently, e.g. as
+// scratch space for a parallel phase that is freed all at once.
+//  - Allocating from the current block is a single atomic fetch-add.
+//  - When the current block runs out, the thread that notices first checks
+//    whether another thread already replaced it, and if not allocates a new
+//    block and installs it with a compare-and-swap. If another thread wins
+//    the race, the new block is freed and the allocation retried.
+//  - Large allocations get their own block, as in 'ac_arena'.
+// Contention on the current block's position grows with the thread count;
+// for many cores, prefer per-thread arenas.
+
+// Header at the beginning of each block.
+typedef struct ac_arena_mt_block {
+  struct ac_arena_mt_block* next;  // Previously current block.
+  size_t size;                     // Size of the whole block in bytes.
+  atomic_size_t pos;               // Bytes into the block that are taken.
+} ac_arena_mt_block;
+
+// Thread-safe arena allocation state.
+typedef struct ac_arena_mt {
+  ac_arena_opts opts;
+  _Atomic(ac_arena_mt_block*) root;   // Current block.
+  _Atomic(ac_arena_mt_block*) large;  // Blocks holding a single allocation.
+} ac_arena_mt;
+
+// Initialize a thread-safe arena. Only 'alloc_size', 'alloc' and 'free' of the
+// options are used, with the same defaults as 'ac_arena_create'.
+// Blocks are allocated lazily.
+void ac_arena_mt_init(ac_arena_mt*, ac_arena_opts);
+
+// Allocate memory from the arena. Safe to call from any thread.
+void* ac_arena_mt_alloc(ac_arena_mt*, size_t);
+void* ac_arena_mt_alloc_aligned(ac_arena_mt*, size_t align, size_t size);
+
+// Free the entire arena. No other thread may be using it.
+void ac_arena_mt_destroy(ac_arena_mt*);
+
+//------------------------------------------------------------------------------
+// Per-Thread Arenas.
+//------------------------------------------------------------------------------
+
+// Every thread gets its own 'ac_arena', created on first use, whose blocks come
+// from a process-wide 'ac_block_pool'. Allocation is a plain bump with no
+// atomics or contention, and blocks flow between threads through the pool.
+//  - Resetting the arena gives blocks beyond 'keep_blocks' to the pool.
+//  - When the thread exits, all of its blocks are given to the pool.
+
+// Block size of the per-thread arenas.
+enum { AC_THREAD_ARENA_BLOCK_SIZE = 1024 * 1024 };
+
+// Returns the calling thread's arena.
+ac_arena* ac_thread_arena(void);
+
+// Gives all blocks of the calling thread's arena to the pool. The arena is
+// created anew on next use.
+void ac_thread_arena_release(void);
+
+// The pool shared by all per-thread arenas.
+ac_block_pool* ac_thread_arena_pool(void);
+
+//------------------------------------------------------------------------------
+// Fixed-Size Object Pool.
+//------------------------------------------------------------------------------
+
+// A pool hands out fixed-size slots (e.g. list or tree nodes) with O(1) alloc
+// and free. Free slots form an intrusive LIFO list, so the most recently freed
+// (and likely cached) slot is reused first.
+//  - The pool grows by whole blocks, laid out like an 'ac_slab': a link to the
+//    previous block, then the slots. New blocks are carved lazily.
+//  - Memory only returns to the allocator when the pool is destroyed.
+
+// A free slot, holding the next free slot.
+typedef struct ac_pool_slot {
+  struct ac_pool_slot* next;
+} ac_pool_slot;
+
+// Pool options.
+typedef struct ac_pool_opts {
+  size_t slot_size;        // Requested bytes per slot.
+  size_t slot_align;       // Alignment of each slot.
+  size_t slots_per_block;  // Number of slots added at a time.
+  ac_allocator2 alloc;     // Allocator for the blocks.
+} ac_pool_opts;
+
+// Pool state.
+typedef struct ac_pool {
+  ac_pool_opts opts;
+  ac_pool_slot* free;    // Free list.
+  unsigned char* next;   // Next never-used slot in the newest block.
+  unsigned char* end;    // End of the newest block.
+  unsigned char* block;  // Newest block, linked to previous blocks.
+} ac_pool;
+
+// Initialize a pool. Defaults are used for zero-initialized fields of opts.
+//  - slot_size => sizeof(void*); it is then rounded up to the alignment
+//  - slot_align => _Alignof(max_align_t)
+//  - slots_per_block => as many as fit in 64 KiB, at least 16
+//  - alloc => ac_mallocator2()
+// No memory is allocated until the first slot is.
+ac_pool ac_pool_create(ac_pool_opts);
+
+// Free all blocks of the pool.
+void ac_pool_destroy(ac_pool*);
+
+// Takes a slot from a new block. Use 'ac_pool_alloc' instead.
+void* ac_pool_alloc_slow_(ac_pool*);
+
+// Allocates a slot, or returns NULL if a new block couldn't be allocated.
+static inline void* ac_pool_alloc(ac_pool* x) {
+  ac_pool_slot* slot = x->free;
+  if (!slot) return ac_pool_alloc_slow_(x);
+  x->free = slot->next;
+  return slot;
+}
+
+// Returns a slot to the pool. Nop if NULL.
+static inline void ac_pool_free(ac_pool* x, void* ptr) {
+  if (!ptr) return;
+  ac_pool_slot* slot = ptr;
+  slot->next = x->free;
+  x->free = slot;
+}
+
+// Allocator adapter for the pool.
+//  - Allocations up to the slot size (and alignment) take a slot, larger
+//    ones fail.
+ac_allocator2 ac_pool_allocator2(ac_pool*);
+
+//------------------------------------------------------------------------------
+// Shared Object Pool.
+//------------------------------------------------------------------------------
+
+// For concurrent use, a pool is shared behind a spinlock and each thread keeps
+// a magazine: a small stack of slots it allocates from and frees to without
+// synchronization. Only when a magazine runs empty or full does it move half
+// its capacity from or to the shared pool, under the lock.
+// Slots can be freed to a different thread's magazine than they came from.
+
+// Number of slots a magazine holds.
+enum { AC_POOL_MAGAZINE_SIZE = 64 };
+
+// A pool shared by many threads.
+typedef struct ac_pool_shared {
+  ac_pool pool;
+  atomic_flag lock;
+} ac_pool_shared;
+
+// Per-thread cache of slots from a shared pool.
+typedef struct ac_pool_magazine {
+  ac_pool_shared* shared;
+  size_t len;
+  void* slots[AC_POOL_MAGAZINE_SIZE];
+} ac_pool_magazine;
+
+// Initialize a shared pool, see 'ac_pool_create'.
+void ac_pool_shared_init(ac_pool_shared*, ac_pool_opts);
+
+// Free the shared pool. All magazines must have been flushed, or abandoned.
+void ac_pool_shared_destroy(ac_pool_shared*);
+
+// Returns an empty magazine for the calling thread.
+static inline ac_pool_magazine ac_pool_magazine_create(ac_pool_shared* shared) {
+  return (ac_pool_magazine){.shared = shared};
+}
+
+// Refill and spill. Use 'ac_pool_magazine_alloc' / 'ac_pool_magazine_free'.
+void* ac_pool_magazine_refill_(ac_pool_magazine*);
+void ac_pool_magazine_spill_(ac_pool_magazine*);
+
+// Allocates a slot, or returns NULL if the shared pool couldn't grow.
+static inline void* ac_pool_magazine_alloc(ac_pool_magazine* m) {
+  if (!m->len) return ac_pool_magazine_refill_(m);
+  return m->slots[--m->len];
+}
+
+// Returns a slot to the magazine. Nop if NULL.
+static inline void ac_pool_magazine_free(ac_pool_magazine* m, void* ptr) {
+  if (!ptr) return;
+  if (m->len == AC_POOL_MAGAZINE_SIZE) ac_pool_magazine_spill_(m);
+  m->slots[m->len++] = ptr;
+}
+
+// Returns all slots in the magazine to the shared pool, e.g. at thread exit.
+void ac_pool_magazine_flush(ac_pool_magazine*);
+
+//------------------------------------------------------------------------------
+// Size-Class Heap.
+//------------------------------------------------------------------------------
+
+// A general purpose allocator for many small allocations of varying size.
+//  - Sizes up to 128 bytes are rounded up to a multiple of 16, larger ones to
+//    a quarter power of two (160, 192, 224, 256, 320, ...), up to 32 KiB.
+//    Each of these size classes is a shared 'ac_pool'.
+//  - Every thread caches slots of each class in magazines, so alloc and free
+//    are usually O(1) without synchronization.
+//  - Larger sizes are mapped directly with mmap.
+// Frees must pass the size that was allocated, as 'ac_mem' does.
+
+// Number of size classes.
+enum { AC_HEAP_CLASSES = 40 };
+
+// Largest size served from a size class.
+enum { AC_HEAP_MAX_SMALL = 32 * 1024 };
+
+// Size-class heap state.
+typedef struct ac_heap {
+  ac_pool_shared classes[AC_HEAP_CLASSES];
+} ac_heap;
+
+// Returns the size class of a small allocation of 'size' bytes.
+static inline size_t ac_heap_class(size_t size) {
+  if (size <= 128) return size ? (size - 1) / 16 : 0;
+  const size_t lg = 63 - __builtin_clzll(size - 1);
+  return 8 + (lg - 7) * 4 + ((size - 1) >> (lg - 2)) - 4;
+}
+
+// Returns the slot size of a size class.
+static inline size_t ac_heap_class_size(size_t c) {
+  if (c < 8) return 16 * (c + 1);
+  const size_t lg = 7 + (c - 8) / 4;
+  return (5 + (c - 8) % 4) << (lg - 2);
+}
+
+// Initialize a heap whose size classes allocate blocks from 'alloc'.
+// Defaults to ac_mallocator2() if 'alloc' is empty.
+void ac_heap_init(ac_heap*, ac_allocator2 alloc);
+
+// Free the heap. Flushes the calling thread's cache; other threads using the
+// heap must have called 'ac_heap_flush_thread_cache' or exited.
+void ac_heap_destroy(ac_heap*);
+
+// Allocate or free memory from the heap.
+void* ac_heap_alloc(ac_heap*, size_t size);
+void ac_heap_free(ac_heap*, void* ptr, size_t size);
+
+// Returns the calling thread's cached slots to the heap. Also done
+// automatically when the thread exits.
+void ac_heap_flush_thread_cache(void);
+
+// Allocator adapter for the heap.
+//  - Resizing within the same size class is done in place.
+ac_allocator2 ac_heap_allocator2(ac_heap*);
+
+//------------------------------------------------------------------------------
+// Buddy Allocation.
+//------------------------------------------------------------------------------
+
+// A buddy allocator manages one mapped region as power-of-two blocks. A block
+// is split in halves ("buddies") to serve smaller requests, and merged with its
+// buddy again once both are free, so fragmentation stays bounded over long
+// runs. Alloc and free are O(log n) in the number of block sizes.
+//  - Every block is aligned to its own size (up to the region's alignment).
+//  - A bitmap records which blocks of each size are free; free blocks also
+//    form intrusive lists, one per size.
+// Frees must pass the size that was allocated, as 'ac_mem' does.
+
+// Buddy allocator options.
+typedef struct ac_buddy_opts {
+  size_t size;       // Size of the region, rounded up to a power of two.
+  size_t min_block;  // Smallest block, a power of two. Defaults to 64 bytes.
+  ac_huge_pages huge_pages;
+} ac_buddy_opts;
+
+// A free block, linked to the other free blocks of its size.
+typedef struct ac_buddy_block {
+  struct ac_buddy_block* prev;
+  struct ac_buddy_block* next;
+} ac_buddy_block;
+
+// Buddy allocator state.
+typedef struct ac_buddy {
+  ac_page_map region;
+  size_t size;                     // Managed bytes at 'region.buf.data'.
+  size_t min_log;                  // Log2 of the smallest block size.
+  size_t max_order;                // Order of the whole region.
+  uint64_t* free_bits;             // One bit per block of every order.
+  ac_buddy_block* free_lists[64];  // Free blocks by order.
+} ac_buddy;
+
+// Creates a buddy allocator over a newly mapped region, all of it free.
+// Returns an allocator with no region if mapping failed.
+ac_buddy ac_buddy_create(ac_buddy_opts);
+
+// Unmaps the region.
+void ac_buddy_destroy(ac_buddy*);
+
+// Returns the size of the block that serves an allocation of 'size' bytes.
+static inline size_t ac_buddy_block_size(const ac_buddy* x, size_t size) {
+  const size_t min_block = (size_t)1 << x->min_log;
+  if (size <= min_block) return min_block;
+  return (size_t)1 << (64 - __builtin_clzll(size - 1));
+}
+
+// Allocates a block of at least 'size' bytes, or returns NULL.
+void* ac_buddy_alloc(ac_buddy*, size_t size);
+
+// Frees a block allocated with 'size'. Nop if NULL.
+void ac_buddy_free(ac_buddy*, void* ptr, size_t size);
+
+// Allocator adapter for the buddy allocator.
+//  - Resizing within the same block size is done in place.
+//  - Aligned allocations round the size up to the alignment. They fail if the
+//    region isn't aligned that much: it's only sure to be page aligned.
+ac_allocator2 ac_buddy_allocator2(ac_buddy*);
+
+//------------------------------------------------------------------------------
+// Virtual Memory Arena.
+//------------------------------------------------------------------------------
+
+// A virtual memory arena reserves one contiguous range of address space up
+// front and commits pages on demand as allocations reach them. It never chains
+// blocks, so the most recent allocation can keep growing in place up to the
+// size of the reservation.
+//
+// Reserving address space is cheap: only committed pages use memory. Reserve
+// generously (e.g. many GiB on 64-bit systems).
+
+// Virtual memory arena state.
+typedef struct ac_vm_arena {
+  unsigned char* data;
+  size_t reserved;   // Bytes of address space reserved at 'data'.
+  size_t committed;  // Bytes at 'data' that are readable and writable.
+  size_t pos;        // Bytes at 'data' that are allocated.
+} ac_vm_arena;
+
+// Reserves at least 'reserve' bytes of address space, committing none of it.
+// Returns an arena with NULL data if the reservation failed.
+ac_vm_arena ac_vm_arena_create(size_t reserve);
+
+// Allocate memory from the arena, committing pages as needed.
+// Returns NULL if the reservation is exhausted or pages can't be committed.
+void* ac_vm_arena_alloc(ac_vm_arena*, size_t);
+void* ac_vm_arena_alloc_aligned(ac_vm_arena*, size_t align, size_t size);
+
+// Empties the arena and decommits its pages, returning them to the system.
+// The reservation is kept.
+void ac_vm_arena_reset(ac_vm_arena*);
+
+// Releases the reservation.
+void ac_vm_arena_destroy(ac_vm_arena*);
+
+// Allocator adapter, with the same semantics as 'ac_arena_allocator2'.
+//  - Since the arena never runs out of room in a block, a list that is the
+//    most recent allocation grows in place without copying.
+ac_allocator2 ac_vm_arena_allocator2(ac_vm_arena*);
+
 //------------------------------------------------------------------------------
 // Contiguous buffers (lists) with capacity and size.
 //------------------------------------------------------------------------------
@@ -378,6 +908,12 @@ ac_list_define_type(size_t);
 // Returns a mapped file or NULL/0-size if the mapping failed for any reason.
 ac_buf ac_file_map_read(const char* path);
 
+// Same as above, optionally advising huge pages for a 2 MiB aligned mapping.
+//  - Regular files only get huge pages from kernels that support read-only
+//    THP for file systems; 'backing' only reports that the advice was taken.
+//  - Unmapped with 'ac_page_unmap' or 'ac_file_unmap'.
+ac_page_map ac_file_map_read_ex(const char* path, ac_huge_pages);
+
 // Unmaps the buffer if it's non-NULL and has nonzero size.
 void ac_file_unmap(ac_buf buf);
 
@@ -396,68 +932,300 @@ void ac_file_unmap(ac_buf buf);
 
 #else  // NOT WINDOWS
 
-ac_arena ac_arena_create(ac_arena_opts x) {
-  if (!x.alloc_size) x.alloc_size = 1024 * 1024;
-  if (!x.alloc) x.alloc = &malloc;
-  if (!x.free) x.free = &free;
+// mmap extensions need e.g. _DEFAULT_SOURCE when building with strict POSIX.
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#if !defined(MAP_NORESERVE)
+#define MAP_NORESERVE 0
+#endif
+
+// Maps 'size' bytes (a multiple of the page size) aligned to a huge page, by
+// over-mapping and trimming the excess on both sides.
+static unsigned char* ac_page_map_aligned_(size_t size, int prot, int flags) {
+  const size_t raw_size = size + AC_HUGE_PAGE_SIZE;
+  unsigned char* raw = mmap(/*addr=*/0, raw_size, prot,
+                            MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+  if (raw == MAP_FAILED) return NULL;
+
+  const size_t head = ac_align_up((uintptr_t)raw, AC_HUGE_PAGE_SIZE) -
+                      (uintptr_t)raw;
+  if (head) munmap(raw, head);
+  if (raw_size - head - size) {
+    munmap(raw + head + size, raw_size - head - size);
+  }
+  return raw + head;
+}
+
+#if defined(MADV_HUGEPAGE)
+// Returns false if THP is disabled system-wide, where madvise(MADV_HUGEPAGE)
+// still succeeds but has no effect. Assumes enabled if the mode is unknown.
+static bool ac_page_thp_enabled_(void) {
+  const int fd = open("/sys/kernel/mm/transparent_hugepage/enabled",
+                      O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return true;
+  char mode[64] = {};
+  const ssize_t n = read(fd, mode, sizeof(mode) - 1);
+  close(fd);
+  return n <= 0 || !strstr(mode, "[never]");
+}
+#endif
+
+// Advises huge pages for an aligned mapping, returning the resulting backing.
+// The kernel doesn't report whether it will back the mapping with huge pages,
+// so at best this is AC_PAGE_BACKING_THP_ADVISED.
+static ac_page_backing ac_page_advise_huge_(void* data, size_t size) {
+#if defined(MADV_HUGEPAGE)
+  if (!madvise(data, size, MADV_HUGEPAGE) && ac_page_thp_enabled_()) {
+    return AC_PAGE_BACKING_THP_ADVISED;
+  }
+#else
+  (void)data;
+  (void)size;
+#endif
+  return AC_PAGE_BACKING_DEFAULT;
+}
+
+ac_page_map ac_page_map_alloc(size_t size, ac_huge_pages huge) {
+  if (!size) return (ac_page_map){};
+  const int prot = PROT_READ | PROT_WRITE;
+
+  if (huge == AC_HUGE_PAGES_NONE) {
+    size = ac_align_up(size, (size_t)sysconf(_SC_PAGESIZE));
+    void* data = mmap(/*addr=*/0, size, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1,
+                      /*offset=*/0);
+    if (data == MAP_FAILED) return (ac_page_map){};
+    return (ac_page_map){{data, size}, AC_PAGE_BACKING_DEFAULT};
+  }
+
+  size = ac_align_up(size, AC_HUGE_PAGE_SIZE);
+
+  // Reserved huge pages are often not configured; fall back to THP.
+#if defined(MAP_HUGETLB)
+  void* data = mmap(/*addr=*/0, size, prot,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (data != MAP_FAILED) {
+    return (ac_page_map){{data, size}, AC_PAGE_BACKING_HUGETLB};
+  }
+#endif
+
+  unsigned char* aligned = ac_page_map_aligned_(size, prot, /*flags=*/0);
+  if (!aligned) return (ac_page_map){};
+  return (ac_page_map){{aligned, size}, ac_page_advise_huge_(aligned, size)};
+}
+
+void ac_page_unmap(ac_page_map m) {
+  if (m.buf.data && m.buf.size) munmap(m.buf.data, m.buf.size);
+}
+
+void ac_block_pool_init(ac_block_pool* p, size_t block_size) {
+  p->block_size = block_size;
+  atomic_init(&p->blocks, NULL);
+}
+
+// The next block in the pool's list.
+static unsigned char** ac_block_pool_next_(unsigned char* block) {
+  return (unsigned char**)block;
+}
+
+// Pushes the list from 'first' to 'last' onto the pool.
+static void ac_block_pool_push_(ac_block_pool* p, unsigned char* first,
+                                unsigned char* last) {
+  unsigned char* top = atomic_load_explicit(&p->blocks, memory_order_relaxed);
+  do {
+    *ac_block_pool_next_(last) = top;
+  } while (!atomic_compare_exchange_weak_explicit(
+      &p->blocks, &top, first, memory_order_release, memory_order_relaxed));
+}
+
+unsigned char* ac_block_pool_take(ac_block_pool* p) {
+  unsigned char* block =
+      atomic_exchange_explicit(&p->blocks, NULL, memory_order_acquire);
+  if (!block) return malloc(p->block_size);
+
+  // Pushing the rest back walks it, but a pool rarely holds more than a few
+  // blocks per thread, and each block serves many allocations.
+  unsigned char* rest = *ac_block_pool_next_(block);
+  if (rest) {
+    unsigned char* last = rest;
+    while (*ac_block_pool_next_(last)) last = *ac_block_pool_next_(last);
+    ac_block_pool_push_(p, rest, last);
+  }
+  return block;
+}
+
+void ac_block_pool_give(ac_block_pool* p, unsigned char* block) {
+  ac_block_pool_push_(p, block, block);
+}
+
+void ac_block_pool_destroy(ac_block_pool* p) {
+  unsigned char* block =
+      atomic_exchange_explicit(&p->blocks, NULL, memory_order_acquire);
+  while (block) {
+    unsigned char* next = *ac_block_pool_next_(block);
+    free(block);
+    block = next;
+  }
+}
+
+// Size of every block except those holding a single large allocation.
+static size_t ac_arena_block_size_(const ac_arena* x) {
+  if (x->opts.pool) return x->opts.pool->block_size;
+  const size_t padding = x->opts.block_align ? x->opts.block_align - 1 : 0;
+  const size_t size = sizeof(ac_arena_node) + padding + x->opts.alloc_size;
+  if (x->opts.huge_pages) return ac_align_up(size, AC_HUGE_PAGE_SIZE);
+  return size;
+}
+
+// Allocates a block, returning its actual size in 'size'.
+static unsigned char* ac_arena_alloc_block_(ac_arena* x, size_t* size) {
+  if (x->opts.pool && *size == x->opts.pool->block_size) {
+    return ac_block_pool_take(x->opts.pool);
+  }
+  if (!x->opts.huge_pages) return x->opts.alloc(*size);
+
+  const ac_page_map m = ac_page_map_alloc(*size, x->opts.huge_pages);
+  if (!m.buf.data) return NULL;
+  if (!x->backing || m.backing < x->backing) x->backing = m.backing;
+  *size = m.buf.size;
+  return m.buf.data;
+}
 
-  const size_t size = sizeof(ac_arena_node) + x.alloc_size;
-  ac_arena_node* next = x.alloc(size);
-  *next = (ac_arena_node){};
+// Frees a block of the given size.
+static void ac_arena_free_block_(ac_arena* x, unsigned char* block,
+                                 size_t size) {
+  if (x->opts.pool && size == x->opts.pool->block_size) {
+    ac_block_pool_give(x->opts.pool, block);
+  } else if (x->opts.huge_pages) {
+    munmap(block, size);
+  } else {
+    x->opts.free(block);
+  }
+}
+
+// Offset of the first usable byte in a block.
+static size_t ac_arena_block_start_(const ac_arena* x, unsigned char* block) {
+  if (!x->opts.block_align) return sizeof(ac_arena_node);
+  const uintptr_t begin = (uintptr_t)block;
+  return ac_align_up(begin + sizeof(ac_arena_node), x->opts.block_align) -
+         begin;
+}
+
+// Padding needed to align 'ptr'.
+static size_t ac_arena_padding_(const unsigned char* ptr, size_t align) {
+  return (size_t)(-(uintptr_t)ptr & (align - 1));
+}
 
-  return (ac_arena){
-      .opts = x,
-      .root = {.data = (unsigned char*)next,
-               .size = size,
-               .pos = sizeof(ac_arena_node)},
+// Pops a spare block or allocates a new one.
+static unsigned char* ac_arena_take_block_(ac_arena* x) {
+  unsigned char* block = x->spare;
+  if (block) {
+    x->spare = ((ac_arena_node*)block)->data;
+    return block;
+  }
+  size_t size = ac_arena_block_size_(x);
+  return ac_arena_alloc_block_(x, &size);
+}
+
+// Pushes an emptied block onto the spare list.
+static void ac_arena_give_block_(ac_arena* x, unsigned char* block) {
+  *(ac_arena_node*)block = (ac_arena_node){.data = x->spare};
+  x->spare = block;
+}
+
+// Frees every block in a list of regular blocks.
+static void ac_arena_free_list_(ac_arena* x, unsigned char* block) {
+  const size_t size = ac_arena_block_size_(x);
+  while (block) {
+    unsigned char* next = ((ac_arena_node*)block)->data;
+    ac_arena_free_block_(x, block, size);
+    block = next;
+  }
+}
+
+// Frees large blocks until reaching 'end'. Each one records its own size.
+static void ac_arena_free_large_(ac_arena* x, unsigned char* end) {
+  while (x->large && x->large != end) {
+    const ac_arena_node node = *(ac_arena_node*)x->large;
+    ac_arena_free_block_(x, x->large, node.size);
+    x->large = node.data;
+  }
+}
+
+ac_arena ac_arena_create(ac_arena_opts opts) {
+  if (opts.pool) {
+    opts = (ac_arena_opts){
+        .alloc_size = opts.pool->block_size - sizeof(ac_arena_node),
+        .pool = opts.pool,
+    };
+  }
+  if (!opts.alloc_size) opts.alloc_size = 1024 * 1024;
+  if (!opts.alloc) opts.alloc = &malloc;
+  if (!opts.free) opts.free = &free;
+
+  ac_arena x = {.opts = opts};
+  unsigned char* block = ac_arena_take_block_(&x);
+  if (!block) return x;
+
+  *(ac_arena_node*)block = (ac_arena_node){};
+  x.root = (ac_arena_node){
+      .data = block,
+      .size = ac_arena_block_size_(&x),
+      .pos = ac_arena_block_start_(&x, block),
   };
+  return x;
 }
 
-void* ac_arena_alloc(ac_arena* x, size_t s) {
+void* ac_arena_alloc_aligned(ac_arena* x, size_t align, size_t s) {
   // Allocate from the root buffer.
-  if (x->root.pos + s < x->root.size) {
-    void* ret = x->root.data + x->root.pos;
-    x->root.pos += s;
+  const size_t pad = ac_arena_padding_(x->root.data + x->root.pos, align);
+  if (x->root.pos + pad + s < x->root.size) {
+    void* ret = x->root.data + x->root.pos + pad;
+    x->root.pos += pad + s;
     return ret;
   }
 
-  // Large allocations directly become the second node.
-  if (s > x->opts.alloc_size / 2) {
-    const size_t size = sizeof(ac_arena_node) + s;
-
-    // Point the new block at the third block.
-    ac_arena_node* node = x->opts.alloc(size);
-    *node = *(ac_arena_node*)x->root.data;
+  // Large allocations get their own block, leaving the root as it is (it may
+  // still have plenty of space, just not enough for such a large allocation).
+  if (s + (align - 1) > x->opts.alloc_size / 2) {
+    size_t size = sizeof(ac_arena_node) + (align - 1) + s;
+    unsigned char* block = ac_arena_alloc_block_(x, &size);
+    if (!block) return NULL;
 
-    // Point the second block at the new block.
-    // (Root still points to the second block, which may still have plenty of
-    // space, just not enough for such a large allocation).
-    *(ac_arena_node*)x->root.data = (ac_arena_node){
-        .data = (unsigned char*)node,
+    *(ac_arena_node*)block = (ac_arena_node){
+        .data = x->large,
         .size = size,
-        .pos = sizeof(ac_arena_node) + s,
+        .pos = size,
     };
-
-    // Return the new allocation.
-    return (unsigned char*)node + sizeof(ac_arena_node);
+    x->large = block;
+    unsigned char* ret = block + sizeof(ac_arena_node);
+    return ret + ac_arena_padding_(ret, align);
   }
 
-  // If there's no space in the buffer, allocate another block.
-  const size_t size = sizeof(ac_arena_node) + x->opts.alloc_size;
-  ac_arena_node* node = x->opts.alloc(size);
-
-  // Point the new block at the first block.
-  *node = x->root;
+  // If there's no space in the buffer, take another block.
+  unsigned char* block = ac_arena_take_block_(x);
+  if (!block) return NULL;
 
-  // Point root at the new block.
+  // Point the new block at the current one, then make it current.
+  const size_t start = ac_arena_block_start_(x, block);
+  const size_t block_pad = ac_arena_padding_(block + start, align);
+  *(ac_arena_node*)block = x->root;
   x->root = (ac_arena_node){
-      .data = (unsigned char*)node,
-      .size = size,
-      .pos = sizeof(ac_arena_node) + s,
+      .data = block,
+      .size = ac_arena_block_size_(x),
+      .pos = start + block_pad + s,
   };
 
   // Return the new allocation.
-  return (unsigned char*)node + sizeof(ac_arena_node);
+  return block + start + block_pad;
+}
+
+void* ac_arena_alloc(ac_arena* x, size_t s) {
+  return ac_arena_alloc_aligned(x, 1, s);
 }
 
 ac_buf ac_arena_alloc_buf(ac_arena* x, size_t s) {
@@ -465,30 +1233,796 @@ ac_buf ac_arena_alloc_buf(ac_arena* x, size_t s) {
 }
 
 void ac_arena_destroy(ac_arena* x) {
-  void* data = x->root.data;
-  do {
-    void* next = ((ac_arena_node*)data)->data;
-    free(data);
-    data = next;
-  } while (data);
+  ac_arena copy = *x;
+  ac_arena_free_large_(&copy, NULL);
+  ac_arena_free_list_(&copy, copy.spare);
+  ac_arena_free_list_(&copy, copy.root.data);
   // Don't write to 'x' again, as it might have just been free'd.
 }
 
-#include <fcntl.h>
-#include <sys/mman.h>
-#include <unistd.h>
+void ac_arena_reset(ac_arena* x, size_t keep_blocks) {
+  if (!keep_blocks) keep_blocks = 1;
 
-ac_buf ac_file_map_read(const char* path) {
+  ac_arena_free_large_(x, NULL);
+
+  // Everything becomes a spare.
+  unsigned char* block = x->root.data;
+  while (block) {
+    unsigned char* next = ((ac_arena_node*)block)->data;
+    ac_arena_give_block_(x, block);
+    block = next;
+  }
+
+  // Keep the first few spares, free the rest.
+  unsigned char* last = x->spare;
+  for (size_t i = 1; last && i < keep_blocks; ++i) {
+    last = ((ac_arena_node*)last)->data;
+  }
+  if (last) {
+    ac_arena_free_list_(x, ((ac_arena_node*)last)->data);
+    ((ac_arena_node*)last)->data = NULL;
+  }
+
+  // Start over with one of them.
+  x->root = (ac_arena_node){};
+  block = ac_arena_take_block_(x);
+  if (!block) return;
+  *(ac_arena_node*)block = (ac_arena_node){};
+  x->root = (ac_arena_node){
+      .data = block,
+      .size = ac_arena_block_size_(x),
+      .pos = ac_arena_block_start_(x, block),
+  };
+}
+
+ac_arena_savepoint ac_arena_mark(const ac_arena* x) {
+  return (ac_arena_savepoint){
+      .block = x->root.data,
+      .pos = x->root.pos,
+      .large = x->large,
+  };
+}
+
+void ac_arena_rewind(ac_arena* x, ac_arena_savepoint m) {
+  ac_arena_free_large_(x, m.large);
+
+  while (x->root.data && x->root.data != m.block) {
+    unsigned char* block = x->root.data;
+    x->root = *(ac_arena_node*)block;
+    ac_arena_give_block_(x, block);
+  }
+
+  if (x->root.data) x->root.pos = m.pos;
+}
+
+// True if 'm' ends at the current block's bump position.
+static bool ac_arena_is_top_(const ac_arena* x, ac_mem m) {
+  return m.data && (unsigned char*)m.data + m.cap == x->root.data + x->root.pos;
+}
+
+static ac_mem ac_arena_alloc2_aligned_(void* state, size_t align, size_t cap) {
+  void* data = ac_arena_alloc_aligned(state, align, cap);
+  if (!data) return (ac_mem){};
+  return (ac_mem){data, cap};
+}
+
+static ac_mem ac_arena_alloc2_(void* state, size_t cap) {
+  return ac_arena_alloc2_aligned_(state, _Alignof(max_align_t), cap);
+}
+
+static void ac_arena_free2_(void* state, ac_mem m) {
+  ac_arena* x = state;
+  if (ac_arena_is_top_(x, m)) x->root.pos -= m.cap;
+}
+
+static ac_mem ac_arena_realloc2_(void* state, ac_mem m, size_t cap) {
+  ac_arena* x = state;
+  if (!ac_arena_is_top_(x, m)) {
+    const ac_mem ret = ac_arena_alloc2_(state, cap);
+    if (ret.data && m.data) memcpy(ret.data, m.data, ac_min(m.cap, cap));
+    return ret;
+  }
+
+  // Most recent allocation: grow or shrink in place if it fits.
+  const size_t begin = x->root.pos - m.cap;
+  if (begin + cap < x->root.size) {
+    x->root.pos = begin + cap;
+    return (ac_mem){m.data, cap};
+  }
+
+  // Otherwise roll it back first. The new allocation lands in another block,
+  // so the old bytes are still intact for the copy.
+  x->root.pos = begin;
+  const ac_mem ret = ac_arena_alloc2_(state, cap);
+  if (ret.data) {
+    memcpy(ret.data, m.data, ac_min(m.cap, cap));
+  } else if (x->root.data + begin == (unsigned char*)m.data) {
+    x->root.pos = begin + m.cap;
+  }
+  return ret;
+}
+
+ac_allocator2 ac_arena_allocator2(ac_arena* x) {
+  return (ac_allocator2){
+      .state = x,
+      .alloc = &ac_arena_alloc2_,
+      .free = &ac_arena_free2_,
+      .realloc = &ac_arena_realloc2_,
+      .alloc_aligned = &ac_arena_alloc2_aligned_,
+  };
+}
+
+// Offset of the first usable byte in a thread-safe arena block.
+#define AC_ARENA_MT_START_ \
+  ac_align_up(sizeof(ac_arena_mt_block), _Alignof(max_align_t))
+
+void ac_arena_mt_init(ac_arena_mt* x, ac_arena_opts opts) {
+  if (!opts.alloc_size) opts.alloc_size = 1024 * 1024;
+  if (!opts.alloc) opts.alloc = &malloc;
+  if (!opts.free) opts.free = &free;
+  x->opts = opts;
+  atomic_init(&x->root, NULL);
+  atomic_init(&x->large, NULL);
+}
+
+// Allocates a block with the first 'taken' bytes after the header in use.
+static ac_arena_mt_block* ac_arena_mt_new_block_(ac_arena_mt* x, size_t size,
+                                                 size_t taken) {
+  ac_arena_mt_block* block = x->opts.alloc(size);
+  if (!block) return NULL;
+  block->next = NULL;
+  block->size = size;
+  atomic_init(&block->pos, AC_ARENA_MT_START_ + taken);
+  return block;
+}
+
+// Aligns an allocation at 'pos' in a block. It was reserved with padding.
+static void* ac_arena_mt_ptr_(ac_arena_mt_block* block, size_t pos,
+                              size_t align) {
+  return (void*)ac_align_up((uintptr_t)block + pos, align);
+}
+
+void* ac_arena_mt_alloc_aligned(ac_arena_mt* x, size_t align, size_t s) {
+  // Reserve enough to align within, wherever the allocation lands.
+  const size_t taken = s + (align - 1);
+
+  // Large allocations get their own block, pushed onto the 'large' stack.
+  if (taken > x->opts.alloc_size / 2) {
+    ac_arena_mt_block* block =
+        ac_arena_mt_new_block_(x, AC_ARENA_MT_START_ + taken, taken);
+    if (!block) return NULL;
+    block->next = atomic_load_explicit(&x->large, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&x->large, &block->next,
+                                                  block, memory_order_release,
+                                                  memory_order_relaxed)) {
+    }
+    return ac_arena_mt_ptr_(block, AC_ARENA_MT_START_, align);
+  }
+
+  ac_arena_mt_block* root =
+      atomic_load_explicit(&x->root, memory_order_acquire);
+  for (;;) {
+    // Allocate from the current block. Once a block overflows, its position
+    // stays past the end, so every later attempt fails too.
+    if (root) {
+      const size_t pos =
+          atomic_fetch_add_explicit(&root->pos, taken, memory_order_relaxed);
+      if (pos + taken <= root->size) return ac_arena_mt_ptr_(root, pos, align);
+    }
+
+    // Another thread may have installed a block since 'root' was loaded: try
+    // that one before allocating.
+    ac_arena_mt_block* current =
+        atomic_load_explicit(&x->root, memory_order_acquire);
+    if (current != root) {
+      root = current;
+      continue;
+    }
+
+    // Try to install a new block in place of the full one.
+    const size_t size = AC_ARENA_MT_START_ + x->opts.alloc_size;
+    ac_arena_mt_block* block = ac_arena_mt_new_block_(x, size, taken);
+    if (!block) return NULL;
+    block->next = root;
+    if (atomic_compare_exchange_strong_explicit(&x->root, &root, block,
+                                                memory_order_acq_rel,
+                                                memory_order_acquire)) {
+      return ac_arena_mt_ptr_(block, AC_ARENA_MT_START_, align);
+    }
+
+    // Another thread got there first: 'root' now holds its block.
+    x->opts.free(block);
+  }
+}
+
+void* ac_arena_mt_alloc(ac_arena_mt* x, size_t s) {
+  return ac_arena_mt_alloc_aligned(x, 1, s);
+}
+
+void ac_arena_mt_destroy(ac_arena_mt* x) {
+  ac_arena_mt_block* lists[] = {
+      atomic_load_explicit(&x->root, memory_order_acquire),
+      atomic_load_explicit(&x->large, memory_order_acquire),
+  };
+  const ac_arena_free_fn free_fn = x->opts.free;
+  for (size_t i = 0; i < ac_array_len(lists); ++i) {
+    ac_arena_mt_block* block = lists[i];
+    while (block) {
+      ac_arena_mt_block* next = block->next;
+      free_fn(block);
+      block = next;
+    }
+  }
+  // Don't write to 'x' again, as it might have just been free'd.
+}
+
+#undef AC_ARENA_MT_START_
+
+#include <pthread.h>
+
+static ac_block_pool ac_thread_arena_pool_ = {
+    .block_size = AC_THREAD_ARENA_BLOCK_SIZE,
+};
+static _Thread_local ac_arena ac_thread_arena_;
+static pthread_key_t ac_thread_arena_key_;
+static pthread_once_t ac_thread_arena_once_ = PTHREAD_ONCE_INIT;
+
+// Thread exit hook, registered by setting a non-NULL value for the key.
+static void ac_thread_arena_exit_(void* arena) { ac_arena_destroy(arena); }
+
+static void ac_thread_arena_init_key_(void) {
+  pthread_key_create(&ac_thread_arena_key_, &ac_thread_arena_exit_);
+}
+
+ac_arena* ac_thread_arena(void) {
+  ac_arena* x = &ac_thread_arena_;
+  if (!x->root.data) {
+    pthread_once(&ac_thread_arena_once_, &ac_thread_arena_init_key_);
+    *x = ac_arena_create((ac_arena_opts){.pool = &ac_thread_arena_pool_});
+    pthread_setspecific(ac_thread_arena_key_, x);
+  }
+  return x;
+}
+
+void ac_thread_arena_release(void) {
+  ac_arena* x = &ac_thread_arena_;
+  if (!x->root.data) return;
+  ac_arena_destroy(x);
+  *x = (ac_arena){};
+  pthread_setspecific(ac_thread_arena_key_, NULL);
+}
+
+ac_block_pool* ac_thread_arena_pool(void) { return &ac_thread_arena_pool_; }
+
+// Layout of one pool block: the link to the previous block, then the slots.
+typedef struct ac_pool_layout_ {
+  size_t size;
+  ac_slab_block link;
+  ac_slab_block slots;
+} ac_pool_layout_;
+
+static ac_pool_layout_ ac_pool_layout_of_(const ac_pool_opts* opts) {
+  ac_slab slab = {};
+  ac_pool_layout_ l = {
+      .link = ac_slab_alloc_type(&slab, unsigned char*, 1),
+      .slots = ac_slab_alloc_aligned(&slab, opts->slot_align,
+                                     opts->slot_size * opts->slots_per_block),
+  };
+  l.size = ac_slab_size(&slab);
+  return l;
+}
+
+ac_pool ac_pool_create(ac_pool_opts opts) {
+  if (opts.slot_size < sizeof(ac_pool_slot)) {
+    opts.slot_size = sizeof(ac_pool_slot);
+  }
+  if (!opts.slot_align) opts.slot_align = _Alignof(max_align_t);
+  opts.slot_size = ac_align_up(opts.slot_size, opts.slot_align);
+  if (!opts.slots_per_block) opts.slots_per_block = 64 * 1024 / opts.slot_size;
+  if (opts.slots_per_block < 16) opts.slots_per_block = 16;
+  if (ac_allocator2_is_empty(opts.alloc)) opts.alloc = ac_mallocator2();
+  return (ac_pool){.opts = opts};
+}
+
+void ac_pool_destroy(ac_pool* x) {
+  const ac_pool_layout_ l = ac_pool_layout_of_(&x->opts);
+  unsigned char* block = x->block;
+  while (block) {
+    unsigned char* prev = *(unsigned char**)(block + l.link.offset);
+    ac_free2(x->opts.alloc, (ac_mem){block, l.size});
+    block = prev;
+  }
+  *x = (ac_pool){.opts = x->opts};
+}
+
+void* ac_pool_alloc_slow_(ac_pool* x) {
+  if (x->next == x->end) {
+    const ac_pool_layout_ l = ac_pool_layout_of_(&x->opts);
+    unsigned char* block =
+        ac_alloc2_aligned(x->opts.alloc, x->opts.slot_align, l.size).data;
+    if (!block) return NULL;
+    *(unsigned char**)(block + l.link.offset) = x->block;
+    x->block = block;
+    x->next = block + l.slots.offset;
+    x->end = x->next + l.slots.size;
+  }
+
+  void* ret = x->next;
+  x->next += x->opts.slot_size;
+  return ret;
+}
+
+static ac_mem ac_pool_alloc2_(void* state, size_t cap) {
+  ac_pool* x = state;
+  if (cap > x->opts.slot_size) return (ac_mem){};
+  void* data = ac_pool_alloc(x);
+  if (!data) return (ac_mem){};
+  return (ac_mem){data, cap};
+}
+
+static ac_mem ac_pool_alloc2_aligned_(void* state, size_t align, size_t cap) {
+  ac_pool* x = state;
+  if (align > x->opts.slot_align) return (ac_mem){};
+  return ac_pool_alloc2_(state, cap);
+}
+
+static void ac_pool_free2_(void* state, ac_mem m) {
+  ac_pool_free(state, m.data);
+}
+
+ac_allocator2 ac_pool_allocator2(ac_pool* x) {
+  return (ac_allocator2){
+      .state = x,
+      .alloc = &ac_pool_alloc2_,
+      .free = &ac_pool_free2_,
+      .alloc_aligned = &ac_pool_alloc2_aligned_,
+  };
+}
+
+void ac_pool_shared_init(ac_pool_shared* x, ac_pool_opts opts) {
+  x->pool = ac_pool_create(opts);
+  atomic_flag_clear(&x->lock);
+}
+
+void ac_pool_shared_destroy(ac_pool_shared* x) { ac_pool_destroy(&x->pool); }
+
+static void ac_pool_shared_lock_(ac_pool_shared* x) {
+  while (atomic_flag_test_and_set_explicit(&x->lock, memory_order_acquire)) {
+  }
+}
+
+static void ac_pool_shared_unlock_(ac_pool_shared* x) {
+  atomic_flag_clear_explicit(&x->lock, memory_order_release);
+}
+
+void* ac_pool_magazine_refill_(ac_pool_magazine* m) {
+  ac_pool_shared_lock_(m->shared);
+  while (m->len < AC_POOL_MAGAZINE_SIZE / 2) {
+    void* slot = ac_pool_alloc(&m->shared->pool);
+    if (!slot) break;
+    m->slots[m->len++] = slot;
+  }
+  ac_pool_shared_unlock_(m->shared);
+  return m->len ? m->slots[--m->len] : NULL;
+}
+
+// Returns the top 'n' slots of the magazine to the shared pool.
+static void ac_pool_magazine_return_(ac_pool_magazine* m, size_t n) {
+  ac_pool_shared_lock_(m->shared);
+  for (; n; --n) ac_pool_free(&m->shared->pool, m->slots[--m->len]);
+  ac_pool_shared_unlock_(m->shared);
+}
+
+void ac_pool_magazine_spill_(ac_pool_magazine* m) {
+  ac_pool_magazine_return_(m, AC_POOL_MAGAZINE_SIZE / 2);
+}
+
+void ac_pool_magazine_flush(ac_pool_magazine* m) {
+  if (m->len) ac_pool_magazine_return_(m, m->len);
+}
+
+void ac_heap_init(ac_heap* x, ac_allocator2 alloc) {
+  for (size_t c = 0; c < AC_HEAP_CLASSES; ++c) {
+    ac_pool_shared_init(&x->classes[c],
+                        (ac_pool_opts){
+                            .slot_size = ac_heap_class_size(c),
+                            .alloc = alloc,
+                        });
+  }
+}
+
+// The calling thread's magazines, for one heap at a time.
+typedef struct ac_heap_cache_ {
+  ac_heap* heap;
+  ac_pool_magazine magazines[AC_HEAP_CLASSES];
+} ac_heap_cache_;
+
+static _Thread_local ac_heap_cache_ ac_heap_cache_tls_;
+static pthread_key_t ac_heap_cache_key_;
+static pthread_once_t ac_heap_cache_once_ = PTHREAD_ONCE_INIT;
+
+static void ac_heap_cache_exit_(void* cache) {
+  (void)cache;
+  ac_heap_flush_thread_cache();
+}
+
+static void ac_heap_cache_init_key_(void) {
+  pthread_key_create(&ac_heap_cache_key_, &ac_heap_cache_exit_);
+}
+
+void ac_heap_flush_thread_cache(void) {
+  ac_heap_cache_* cache = &ac_heap_cache_tls_;
+  if (!cache->heap) return;
+  for (size_t c = 0; c < AC_HEAP_CLASSES; ++c) {
+    ac_pool_magazine_flush(&cache->magazines[c]);
+  }
+  cache->heap = NULL;
+}
+
+// Returns the calling thread's cache, bound to 'x'.
+static ac_heap_cache_* ac_heap_bind_cache_(ac_heap* x) {
+  ac_heap_cache_* cache = &ac_heap_cache_tls_;
+  if (cache->heap == x) return cache;
+
+  // Using another heap than last time is rare: rebind the cache.
+  ac_heap_flush_thread_cache();
+  pthread_once(&ac_heap_cache_once_, &ac_heap_cache_init_key_);
+  pthread_setspecific(ac_heap_cache_key_, cache);
+  cache->heap = x;
+  for (size_t c = 0; c < AC_HEAP_CLASSES; ++c) {
+    cache->magazines[c] = ac_pool_magazine_create(&x->classes[c]);
+  }
+  return cache;
+}
+
+void ac_heap_destroy(ac_heap* x) {
+  if (ac_heap_cache_tls_.heap == x) ac_heap_flush_thread_cache();
+  for (size_t c = 0; c < AC_HEAP_CLASSES; ++c) {
+    ac_pool_shared_destroy(&x->classes[c]);
+  }
+}
+
+void* ac_heap_alloc(ac_heap* x, size_t size) {
+  if (size > AC_HEAP_MAX_SMALL) {
+    void* data = mmap(/*addr=*/0, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, /*offset=*/0);
+    return data == MAP_FAILED ? NULL : data;
+  }
+  ac_heap_cache_* cache = ac_heap_bind_cache_(x);
+  return ac_pool_magazine_alloc(&cache->magazines[ac_heap_class(size)]);
+}
+
+void ac_heap_free(ac_heap* x, void* ptr, size_t size) {
+  if (!ptr) return;
+  if (size > AC_HEAP_MAX_SMALL) {
+    munmap(ptr, size);
+    return;
+  }
+  ac_heap_cache_* cache = ac_heap_bind_cache_(x);
+  ac_pool_magazine_free(&cache->magazines[ac_heap_class(size)], ptr);
+}
+
+static ac_mem ac_heap_alloc2_(void* state, size_t cap) {
+  void* data = ac_heap_alloc(state, cap);
+  if (!data) return (ac_mem){};
+  return (ac_mem){data, cap};
+}
+
+static void ac_heap_free2_(void* state, ac_mem m) {
+  ac_heap_free(state, m.data, m.cap);
+}
+
+static ac_mem ac_heap_realloc2_(void* state, ac_mem m, size_t cap) {
+  // Same size class: the slot already fits.
+  if (m.data && m.cap <= AC_HEAP_MAX_SMALL && cap <= AC_HEAP_MAX_SMALL &&
+      ac_heap_class(m.cap) == ac_heap_class(cap)) {
+    return (ac_mem){m.data, cap};
+  }
+
+  const ac_mem ret = ac_heap_alloc2_(state, cap);
+  if (ret.data && m.data) {
+    memcpy(ret.data, m.data, ac_min(m.cap, cap));
+    ac_heap_free2_(state, m);
+  }
+  return ret;
+}
+
+ac_allocator2 ac_heap_allocator2(ac_heap* x) {
+  return (ac_allocator2){
+      .state = x,
+      .alloc = &ac_heap_alloc2_,
+      .free = &ac_heap_free2_,
+      .realloc = &ac_heap_realloc2_,
+  };
+}
+
+// Index of the free bit of block 'i' of 'order'. With N smallest blocks,
+// order 0 has N bits, order 1 has N / 2 bits after those, and so on.
+static size_t ac_buddy_bit_(const ac_buddy* x, size_t order, size_t i) {
+  const size_t n2 = (x->size >> x->min_log) * 2;
+  return n2 - (n2 >> order) + i;
+}
+
+static bool ac_buddy_is_free_(const ac_buddy* x, size_t order, size_t i) {
+  const size_t bit = ac_buddy_bit_(x, order, i);
+  return x->free_bits[bit / 64] >> (bit % 64) & 1;
+}
+
+static size_t ac_buddy_index_(const ac_buddy* x, void* block, size_t order) {
+  const size_t offset = (unsigned char*)block - x->region.buf.data;
+  return offset >> (x->min_log + order);
+}
+
+static void ac_buddy_push_(ac_buddy* x, void* ptr, size_t order) {
+  ac_buddy_block* block = ptr;
+  *block = (ac_buddy_block){.next = x->free_lists[order]};
+  if (block->next) block->next->prev = block;
+  x->free_lists[order] = block;
+
+  const size_t bit = ac_buddy_bit_(x, order, ac_buddy_index_(x, ptr, order));
+  x->free_bits[bit / 64] |= (uint64_t)1 << (bit % 64);
+}
+
+static void ac_buddy_remove_(ac_buddy* x, ac_buddy_block* block,
+                             size_t order) {
+  if (block->prev) {
+    block->prev->next = block->next;
+  } else {
+    x->free_lists[order] = block->next;
+  }
+  if (block->next) block->next->prev = block->prev;
+
+  const size_t bit = ac_buddy_bit_(x, order, ac_buddy_index_(x, block, order));
+  x->free_bits[bit / 64] &= ~((uint64_t)1 << (bit % 64));
+}
+
+ac_buddy ac_buddy_create(ac_buddy_opts opts) {
+  if (!opts.min_block) opts.min_block = 64;
+  if (opts.min_block < sizeof(ac_buddy_block)) {
+    opts.min_block = sizeof(ac_buddy_block);
+  }
+
+  ac_buddy x = {};
+  x.min_log = 63 - __builtin_clzll(ac_buddy_block_size(&x, opts.min_block));
+  x.size = ac_buddy_block_size(&x, opts.size);
+  x.max_order = 63 - __builtin_clzll(x.size) - x.min_log;
+
+  const size_t bits = (x.size >> x.min_log) * 2;
+  x.free_bits = calloc(ac_align_up(bits, 64) / 64, sizeof(uint64_t));
+  if (!x.free_bits) return (ac_buddy){};
+  x.region = ac_page_map_alloc(x.size, opts.huge_pages);
+  if (!x.region.buf.data) {
+    free(x.free_bits);
+    return (ac_buddy){};
+  }
+
+  ac_buddy_push_(&x, x.region.buf.data, x.max_order);
+  return x;
+}
+
+void ac_buddy_destroy(ac_buddy* x) {
+  ac_page_unmap(x->region);
+  free(x->free_bits);
+  *x = (ac_buddy){};
+}
+
+// Order of the block serving 'size' bytes.
+static size_t ac_buddy_order_(const ac_buddy* x, size_t size) {
+  return 63 - __builtin_clzll(ac_buddy_block_size(x, size)) - x->min_log;
+}
+
+void* ac_buddy_alloc(ac_buddy* x, size_t size) {
+  if (!x->region.buf.data || size > x->size) return NULL;
+  const size_t order = ac_buddy_order_(x, size);
+
+  // Find the smallest free block that fits.
+  size_t k = order;
+  while (k <= x->max_order && !x->free_lists[k]) ++k;
+  if (k > x->max_order) return NULL;
+
+  ac_buddy_block* block = x->free_lists[k];
+  ac_buddy_remove_(x, block, k);
+
+  // Split it down, freeing the upper halves.
+  while (k > order) {
+    --k;
+    ac_buddy_push_(x, (unsigned char*)block + ((size_t)1 << (x->min_log + k)),
+                   k);
+  }
+  return block;
+}
+
+void ac_buddy_free(ac_buddy* x, void* ptr, size_t size) {
+  if (!ptr) return;
+  size_t order = ac_buddy_order_(x, size);
+  unsigned char* block = ptr;
+
+  // Merge with the buddy for as long as it's free.
+  while (order < x->max_order) {
+    const size_t i = ac_buddy_index_(x, block, order);
+    if (!ac_buddy_is_free_(x, order, i ^ 1)) break;
+
+    const size_t block_size = (size_t)1 << (x->min_log + order);
+    unsigned char* buddy = i & 1 ? block - block_size : block + block_size;
+    ac_buddy_remove_(x, (ac_buddy_block*)buddy, order);
+    if (buddy < block) block = buddy;
+    ++order;
+  }
+  ac_buddy_push_(x, block, order);
+}
+
+static ac_mem ac_buddy_alloc2_(void* state, size_t cap) {
+  void* data = ac_buddy_alloc(state, cap);
+  if (!data) return (ac_mem){};
+  return (ac_mem){data, cap};
+}
+
+static ac_mem ac_buddy_alloc2_aligned_(void* state, size_t align,
+                                       size_t cap) {
+  // Blocks are aligned to their size relative to the region, so a block of
+  // 'align' bytes will do as long as the region itself is aligned to 'align'.
+  const ac_buddy* x = state;
+  if ((uintptr_t)x->region.buf.data % align) return (ac_mem){};
+  return ac_buddy_alloc2_(state, cap < align ? align : cap);
+}
+
+static void ac_buddy_free2_(void* state, ac_mem m) {
+  ac_buddy_free(state, m.data, m.cap);
+}
+
+static ac_mem ac_buddy_realloc2_(void* state, ac_mem m, size_t cap) {
+  ac_buddy* x = state;
+  if (m.data && ac_buddy_block_size(x, m.cap) == ac_buddy_block_size(x, cap)) {
+    return (ac_mem){m.data, cap};
+  }
+
+  const ac_mem ret = ac_buddy_alloc2_(state, cap);
+  if (ret.data && m.data) {
+    memcpy(ret.data, m.data, ac_min(m.cap, cap));
+    ac_buddy_free2_(state, m);
+  }
+  return ret;
+}
+
+ac_allocator2 ac_buddy_allocator2(ac_buddy* x) {
+  return (ac_allocator2){
+      .state = x,
+      .alloc = &ac_buddy_alloc2_,
+      .free = &ac_buddy_free2_,
+      .realloc = &ac_buddy_realloc2_,
+      .alloc_aligned = &ac_buddy_alloc2_aligned_,
+  };
+}
+
+// Pages are committed in chunks of this size to limit mprotect calls.
+enum { AC_VM_ARENA_COMMIT_SIZE = 64 * 1024 };
+
+ac_vm_arena ac_vm_arena_create(size_t reserve) {
+  const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  reserve = ac_align_up(reserve ? reserve : 1, page_size);
+
+  void* data = mmap(/*addr=*/0, reserve, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (data == MAP_FAILED) return (ac_vm_arena){};
+  return (ac_vm_arena){.data = data, .reserved = reserve};
+}
+
+// Makes sure that the first 'end' bytes are committed.
+static bool ac_vm_arena_commit_(ac_vm_arena* x, size_t end) {
+  if (end <= x->committed) return true;
+  if (end > x->reserved) return false;
+
+  size_t committed = ac_align_up(end, AC_VM_ARENA_COMMIT_SIZE);
+  if (committed > x->reserved) committed = x->reserved;
+  if (mprotect(x->data + x->committed, committed - x->committed,
+               PROT_READ | PROT_WRITE)) {
+    return false;
+  }
+  x->committed = committed;
+  return true;
+}
+
+void* ac_vm_arena_alloc_aligned(ac_vm_arena* x, size_t align, size_t s) {
+  const size_t begin = ac_align_up(x->pos, align);
+  if (begin < x->pos || begin + s < begin) return NULL;
+  if (!ac_vm_arena_commit_(x, begin + s)) return NULL;
+  x->pos = begin + s;
+  return x->data + begin;
+}
+
+void* ac_vm_arena_alloc(ac_vm_arena* x, size_t s) {
+  return ac_vm_arena_alloc_aligned(x, 1, s);
+}
+
+void ac_vm_arena_reset(ac_vm_arena* x) {
+  if (x->committed) {
+    madvise(x->data, x->committed, MADV_DONTNEED);
+    mprotect(x->data, x->committed, PROT_NONE);
+  }
+  x->committed = 0;
+  x->pos = 0;
+}
+
+void ac_vm_arena_destroy(ac_vm_arena* x) {
+  if (x->data) munmap(x->data, x->reserved);
+  *x = (ac_vm_arena){};
+}
+
+static ac_mem ac_vm_arena_alloc2_aligned_(void* state, size_t align,
+                                          size_t cap) {
+  void* data = ac_vm_arena_alloc_aligned(state, align, cap);
+  if (!data) return (ac_mem){};
+  return (ac_mem){data, cap};
+}
+
+static ac_mem ac_vm_arena_alloc2_(void* state, size_t cap) {
+  return ac_vm_arena_alloc2_aligned_(state, _Alignof(max_align_t), cap);
+}
+
+static void ac_vm_arena_free2_(void* state, ac_mem m) {
+  ac_vm_arena* x = state;
+  if (m.data && (unsigned char*)m.data + m.cap == x->data + x->pos) {
+    x->pos -= m.cap;
+  }
+}
+
+static ac_mem ac_vm_arena_realloc2_(void* state, ac_mem m, size_t cap) {
+  ac_vm_arena* x = state;
+  if (!m.data || (unsigned char*)m.data + m.cap != x->data + x->pos) {
+    const ac_mem ret = ac_vm_arena_alloc2_(state, cap);
+    if (ret.data && m.data) memcpy(ret.data, m.data, ac_min(m.cap, cap));
+    return ret;
+  }
+
+  // Most recent allocation: always resized in place.
+  const size_t begin = x->pos - m.cap;
+  if (begin + cap < begin || !ac_vm_arena_commit_(x, begin + cap)) {
+    return (ac_mem){};
+  }
+  x->pos = begin + cap;
+  return (ac_mem){m.data, cap};
+}
+
+ac_allocator2 ac_vm_arena_allocator2(ac_vm_arena* x) {
+  return (ac_allocator2){
+      .state = x,
+      .alloc = &ac_vm_arena_alloc2_,
+      .free = &ac_vm_arena_free2_,
+      .realloc = &ac_vm_arena_realloc2_,
+      .alloc_aligned = &ac_vm_arena_alloc2_aligned_,
+  };
+}
+
+ac_page_map ac_file_map_read_ex(const char* path, ac_huge_pages huge) {
   const int fd = open(path, O_RDONLY | O_NONBLOCK);
-  if (fd < 0) return (ac_buf){};
+  if (fd < 0) return (ac_page_map){};
 
   const size_t size = lseek(fd, 0, SEEK_END);
 
-  void* data = mmap(/*addr=*/0, size, PROT_READ, MAP_PRIVATE, fd, /*offset=*/0);
+  // For huge pages, map the file over an aligned reservation.
+  void* addr = NULL;
+  size_t reserved = 0;
+  int flags = MAP_PRIVATE;
+  if (huge != AC_HUGE_PAGES_NONE && size) {
+    reserved = ac_align_up(size, (size_t)sysconf(_SC_PAGESIZE));
+    addr = ac_page_map_aligned_(reserved, PROT_NONE, MAP_NORESERVE);
+    if (addr) flags |= MAP_FIXED;
+  }
+
+  void* data = mmap(addr, size, PROT_READ, flags, fd, /*offset=*/0);
   close(fd);
 
-  if (data < 0) return (ac_buf){};
-  return (ac_buf){.data = data, .size = size};
+  if (data == MAP_FAILED) {
+    if (addr) munmap(addr, reserved);
+    return (ac_page_map){};
+  }
+  const ac_page_backing backing = addr ? ac_page_advise_huge_(data, size)
+                                       : AC_PAGE_BACKING_DEFAULT;
+  return (ac_page_map){{data, size}, backing};
+}
+
+ac_buf ac_file_map_read(const char* path) {
+  return ac_file_map_read_ex(path, AC_HUGE_PAGES_NONE).buf;
 }
 
 void ac_file_unmap(ac_buf buf) {
@@ -0,0 +1,202 @@
+// Benchmarks for ac_mem.h. Only meaningful in optimized builds:
+//
+//   make OPT=1 ac_mem_bench && build/ac_mem_bench
+//
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define AC_MEM_IMPL
+#include "ac_mem.h"
+
+#define AC_TIME_IMPL
+#include "ac_time.h"
+
+enum {
+  AC_MEM_BENCH_ALLOCS = 1 << 21,  // Split between the threads.
+  AC_MEM_BENCH_MAX_THREADS = 64,  // Past the core count, to show contention.
+};
+
+static inline double ac_mem_bench_ns_(ac_cputime t0) {
+  const ac_dcputime dt = ac_cputime_diff(ac_cputime_now(), t0);
+  return 1e9 * dt.cpu_dticks / ac_cputime_freq();
+}
+
+//------------------------------------------------------------------------------
+// Thread-Safe Arena
+//------------------------------------------------------------------------------
+
+// Compares 'ac_arena_mt' with an 'ac_arena' behind a mutex, as more threads
+// allocate from one arena.
+
+typedef struct ac_mem_bench_arenas {
+  bool mt;  // Use 'ac_arena_mt', otherwise 'arena' and 'mutex'.
+  size_t allocs;
+  ac_arena_mt arena_mt;
+  ac_arena arena;
+  pthread_mutex_t mutex;
+} ac_mem_bench_arenas;
+
+static inline void* ac_mem_bench_work_(void* arg) {
+  ac_mem_bench_arenas* a = arg;
+  for (size_t i = 0; i < a->allocs; ++i) {
+    const size_t size = 8 + i % 56;
+    unsigned char* p;
+    if (a->mt) {
+      p = ac_arena_mt_alloc(&a->arena_mt, size);
+    } else {
+      pthread_mutex_lock(&a->mutex);
+      p = ac_arena_alloc(&a->arena, size);
+      pthread_mutex_unlock(&a->mutex);
+    }
+    p[0] = (unsigned char)i;  // Touch it, as a caller would.
+  }
+  return NULL;
+}
+
+// Returns the wall time per allocation, in nanoseconds.
+static inline double ac_mem_bench_run_(bool mt, size_t thread_count) {
+  static ac_mem_bench_arenas a;
+  a = (ac_mem_bench_arenas){.mt = mt,
+                            .allocs = AC_MEM_BENCH_ALLOCS / thread_count};
+  ac_arena_mt_init(&a.arena_mt, (ac_arena_opts){});
+  a.arena = ac_arena_create((ac_arena_opts){});
+  pthread_mutex_init(&a.mutex, NULL);
+
+  pthread_t threads[AC_MEM_BENCH_MAX_THREADS];
+  const ac_cputime t0 = ac_cputime_now();
+  for (size_t t = 0; t < thread_count; ++t) {
+    pthread_create(&threads[t], NULL, &ac_mem_bench_work_, &a);
+  }
+  for (size_t t = 0; t < thread_count; ++t) pthread_join(threads[t], NULL);
+  const double ns = ac_mem_bench_ns_(t0);
+
+  pthread_mutex_destroy(&a.mutex);
+  ac_arena_destroy(&a.arena);
+  ac_arena_mt_destroy(&a.arena_mt);
+  return ns / (a.allocs * thread_count);
+}
+
+//------------------------------------------------------------------------------
+// Size-Class Heap
+//------------------------------------------------------------------------------
+
+// Replays an allocation trace through 'ac_heap' and through malloc. The trace
+// keeps about half of 'AC_MEM_BENCH_LIVE' allocations alive, with mostly small
+// sizes and a tail up to 32 KiB, in a random order.
+enum { AC_MEM_BENCH_EVENTS = 1 << 21, AC_MEM_BENCH_LIVE = 4096 };
+
+// Allocates 'size' bytes into 'slot' if 'size' isn't zero, otherwise frees it.
+typedef struct ac_mem_bench_event {
+  uint32_t slot;
+  uint32_t size;
+} ac_mem_bench_event;
+
+typedef struct ac_mem_bench_replay {
+  const ac_mem_bench_event* trace;
+  size_t len;
+  ac_heap* heap;  // Malloc if null.
+} ac_mem_bench_replay;
+
+static inline uint32_t ac_mem_bench_rand_(uint64_t* state) {
+  *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+  return (uint32_t)(*state >> 33);
+}
+
+static inline void ac_mem_bench_trace_(ac_mem_bench_event* trace, size_t len) {
+  static uint32_t sizes[AC_MEM_BENCH_LIVE];
+  uint64_t rng = 1;
+  for (size_t i = 0; i < len; ++i) {
+    const uint32_t slot = ac_mem_bench_rand_(&rng) % AC_MEM_BENCH_LIVE;
+    const uint32_t r = ac_mem_bench_rand_(&rng) % 1000;
+    uint32_t size = 0;
+    if (!sizes[slot]) {
+      size = r < 800   ? 8 + r % 120
+             : r < 980 ? 128 + r * 37 % 2048
+                       : 2048 + r * 1543 % (30 * 1024);
+    }
+    sizes[slot] = size;
+    trace[i] = (ac_mem_bench_event){slot, size};
+  }
+}
+
+static inline void* ac_mem_bench_replay_(void* arg) {
+  const ac_mem_bench_replay* r = arg;
+  struct {
+    unsigned char* ptr;
+    uint32_t size;
+  } live[AC_MEM_BENCH_LIVE] = {};
+  for (size_t i = 0; i < r->len; ++i) {
+    const ac_mem_bench_event e = r->trace[i];
+    if (e.size) {
+      live[e.slot].ptr = r->heap ? ac_heap_alloc(r->heap, e.size)
+                                 : malloc(e.size);
+      live[e.slot].ptr[0] = (unsigned char)i;  // Touch it.
+      live[e.slot].size = e.size;
+    } else {
+      if (r->heap) {
+        ac_heap_free(r->heap, live[e.slot].ptr, live[e.slot].size);
+      } else {
+        free(live[e.slot].ptr);
+      }
+      live[e.slot].size = 0;
+    }
+  }
+
+  // Free what's still alive, as the end of the trace.
+  for (size_t i = 0; i < AC_MEM_BENCH_LIVE; ++i) {
+    if (!live[i].size) continue;
+    if (r->heap) {
+      ac_heap_free(r->heap, live[i].ptr, live[i].size);
+    } else {
+      free(live[i].ptr);
+    }
+  }
+  if (r->heap) ac_heap_flush_thread_cache();
+  return NULL;
+}
+
+// Returns the wall time per event, in nanoseconds. Each thread replays the
+// trace on its own.
+static inline double ac_mem_bench_heap_run_(const ac_mem_bench_event* trace,
+                                            bool heap, size_t thread_count) {
+  static ac_heap h;
+  if (heap) ac_heap_init(&h, (ac_allocator2){});
+  const ac_mem_bench_replay r = {
+      trace, AC_MEM_BENCH_EVENTS / thread_count, heap ? &h : NULL};
+
+  pthread_t threads[AC_MEM_BENCH_MAX_THREADS];
+  const ac_cputime t0 = ac_cputime_now();
+  for (size_t t = 0; t < thread_count; ++t) {
+    pthread_create(&threads[t], NULL, &ac_mem_bench_replay_, (void*)&r);
+  }
+  for (size_t t = 0; t < thread_count; ++t) pthread_join(threads[t], NULL);
+  const double ns = ac_mem_bench_ns_(t0);
+
+  if (heap) ac_heap_destroy(&h);
+  return ns / (r.len * thread_count);
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  printf("%-8s %14s %14s\n", "threads", "mt ns/alloc", "mutex ns/alloc");
+  for (size_t threads = 1; threads <= AC_MEM_BENCH_MAX_THREADS;
+       threads *= 2) {
+    const double mt = ac_mem_bench_run_(true, threads);
+    const double mutex = ac_mem_bench_run_(false, threads);
+    printf("%-8zu %14.2f %14.2f\n", threads, mt, mutex);
+  }
+
+  static ac_mem_bench_event trace[AC_MEM_BENCH_EVENTS];
+  ac_mem_bench_trace_(trace, AC_MEM_BENCH_EVENTS);
+  printf("\n%-8s %14s %14s\n", "threads", "heap ns/event",
+         "malloc ns/event");
+  for (size_t threads = 1; threads <= AC_MEM_BENCH_MAX_THREADS;
+       threads *= 2) {
+    const double heap = ac_mem_bench_heap_run_(trace, true, threads);
+    const double malloc_ns = ac_mem_bench_heap_run_(trace, false, threads);
+    printf("%-8zu %14.2f %14.2f\n", threads, heap, malloc_ns);
+  }
+  return 0;
+}
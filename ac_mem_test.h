@@ -0,0 +1,764 @@
+#ifndef AC_MEM_TEST_H_
+#define AC_MEM_TEST_H_
+
+#include <unistd.h>
+
+#if !defined(WASM)
+#include <pthread.h>
+#endif
+
+#include "ac_alloc.h"
+#include "ac_str.h"
+#include "ac_test.h"
+
+#define AC_MEM_IMPL
+#include "ac_mem.h"
+
+//------------------------------------------------------------------------------
+// Arena Reuse
+//------------------------------------------------------------------------------
+
+// Counts system allocations made by arenas in these tests.
+static size_t ac_mem_test_mallocs_ = 0;
+static size_t ac_mem_test_frees_ = 0;
+
+static inline void* ac_mem_test_malloc_(size_t size) {
+  ++ac_mem_test_mallocs_;
+  return malloc(size);
+}
+
+static inline void ac_mem_test_free_(void* ptr) {
+  ++ac_mem_test_frees_;
+  free(ptr);
+}
+
+static inline ac_arena ac_mem_test_arena_(size_t alloc_size) {
+  ac_mem_test_mallocs_ = 0;
+  ac_mem_test_frees_ = 0;
+  return ac_arena_create((ac_arena_opts){
+      .alloc_size = alloc_size,
+      .alloc = &ac_mem_test_malloc_,
+      .free = &ac_mem_test_free_,
+  });
+}
+
+static inline void arena_rewind_recycles_blocks(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_arena arena = ac_mem_test_arena_(1024);
+  ac_arena_alloc(&arena, 100);
+  const ac_arena_savepoint mark = ac_arena_mark(&arena);
+
+  // Fill a few blocks plus one large allocation, then rewind.
+  for (int i = 0; i < 20; ++i) ac_arena_alloc(&arena, 300);
+  ac_arena_alloc(&arena, 4000);
+  const size_t mallocs = ac_mem_test_mallocs_;
+  ac_test_gtu(mallocs, 5);
+
+  ac_arena_rewind(&arena, mark);
+  ac_test_expect(arena.root.data == mark.block, "Rewound to another block.");
+  ac_test_equ(arena.root.pos, mark.pos);
+  ac_test_equ(ac_mem_test_frees_, 1);  // Only the large allocation.
+
+  // The same workload again is served from spares.
+  for (int i = 0; i < 20; ++i) ac_arena_alloc(&arena, 300);
+  ac_test_equ(ac_mem_test_mallocs_, mallocs);
+
+  ac_arena_destroy(&arena);
+  ac_test_equ(ac_mem_test_frees_, ac_mem_test_mallocs_);
+}
+
+static inline void arena_reset_keeps_blocks(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_arena arena = ac_mem_test_arena_(1024);
+  for (int i = 0; i < 30; ++i) ac_arena_alloc(&arena, 300);
+  const size_t mallocs = ac_mem_test_mallocs_;
+
+  ac_arena_reset(&arena, 4);
+  ac_test_equ(ac_mem_test_frees_, mallocs - 4);
+  ac_test_equ(arena.root.pos, sizeof(ac_arena_node));
+
+  // Steady state: requests that fit in the kept blocks don't allocate.
+  for (int round = 0; round < 10; ++round) {
+    for (int i = 0; i < 12; ++i) ac_arena_alloc(&arena, 300);
+    ac_arena_reset(&arena, 4);
+  }
+  ac_test_equ(ac_mem_test_mallocs_, mallocs);
+
+  ac_arena_destroy(&arena);
+  ac_test_equ(ac_mem_test_frees_, ac_mem_test_mallocs_);
+}
+
+//------------------------------------------------------------------------------
+// Aligned Arena Allocation
+//------------------------------------------------------------------------------
+
+static inline bool ac_mem_test_aligned_(const void* ptr, size_t align) {
+  return (uintptr_t)ptr % align == 0;
+}
+
+static inline void arena_alloc_aligned(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_arena arena = ac_arena_create((ac_arena_opts){.alloc_size = 1024});
+  bool aligned = true;
+  for (int i = 0; i < 200; ++i) {
+    ac_arena_alloc(&arena, 3);
+    aligned &= ac_mem_test_aligned_(ac_arena_alloc_type(&arena, double, 5),
+                                    _Alignof(double));
+    aligned &= ac_mem_test_aligned_(ac_arena_alloc_aligned(&arena, 64, 10), 64);
+  }
+  ac_test_expect(aligned, "Misaligned allocation from the current block.");
+
+  // Large allocations, and alignments too large for a block.
+  ac_test_expect(ac_mem_test_aligned_(ac_arena_alloc_aligned(&arena, 64, 900),
+                                      64),
+                 "Misaligned large allocation.");
+  ac_test_expect(
+      ac_mem_test_aligned_(ac_arena_alloc_aligned(&arena, 4096, 16), 4096),
+      "Misaligned over-aligned allocation.");
+
+  ac_arena_destroy(&arena);
+}
+
+static inline void arena_block_align(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_arena arena = ac_arena_create((ac_arena_opts){
+      .alloc_size = 1000,
+      .block_align = 4096,
+  });
+
+  // The first allocation in every block is page aligned.
+  bool aligned = true;
+  for (int i = 0; i < 100; ++i) {
+    const unsigned char* const block = arena.root.data;
+    void* ptr = ac_arena_alloc(&arena, 300);
+    if (arena.root.data != block) aligned &= ac_mem_test_aligned_(ptr, 4096);
+  }
+  ac_test_expect(aligned, "Misaligned block.");
+
+  ac_arena_reset(&arena, 1);
+  ac_test_expect(ac_mem_test_aligned_(ac_arena_alloc(&arena, 1), 4096),
+                 "Misaligned block after reset.");
+
+  ac_arena_destroy(&arena);
+}
+
+//------------------------------------------------------------------------------
+// Arena Allocator Adapter
+//------------------------------------------------------------------------------
+
+static inline void arena_allocator2_grows_top_in_place(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_arena arena = ac_arena_create((ac_arena_opts){.alloc_size = 4096});
+  ac_str str = ac_str_init(ac_arena_allocator2(&arena));
+
+  ac_to_str(&str, "%s", "first");
+  char* const data = str.data;
+  for (int i = 0; i < 100; ++i) ac_to_str(&str, " %d", i);
+
+  ac_test_expect(str.data == data, "String moved instead of growing in place.");
+  ac_test_expect(arena.root.data + arena.root.pos == (void*)(data + str.cap),
+                 "String is not the top allocation.");
+
+  // Freeing the top allocation rolls the arena back.
+  ac_str_free(&str);
+  ac_test_expect(arena.root.data + arena.root.pos == (void*)data,
+                 "Arena was not rolled back.");
+
+  ac_arena_destroy(&arena);
+}
+
+static inline void arena_allocator2_copies_when_not_top(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_arena arena = ac_arena_create((ac_arena_opts){.alloc_size = 4096});
+  ac_lista(uint32_t) list = {.alloc = ac_arena_allocator2(&arena)};
+  for (uint32_t i = 0; i < 4; ++i) *ac_lista_next_ex(&list) = i;
+
+  // Another allocation on top prevents in-place growth.
+  ac_arena_alloc(&arena, 3);
+  const uint32_t* const data = list.data;
+  for (uint32_t i = 4; i < 1000; ++i) *ac_lista_next_ex(&list) = i;
+  ac_test_expect(list.data != data, "List should have been copied.");
+
+  bool items_ok = true;
+  for (uint32_t i = 0; i < 1000; ++i) items_ok &= list.data[i] == i;
+  ac_test_expect(items_ok, "Items changed after growing.");
+
+  ac_arena_destroy(&arena);
+}
+
+//------------------------------------------------------------------------------
+// Object Pool
+//------------------------------------------------------------------------------
+
+static inline void pool_reuses_freed_slots(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_pool pool = ac_pool_create((ac_pool_opts){
+      .slot_size = 24,
+      .slot_align = 32,
+      .slots_per_block = 100,
+  });
+  ac_test_equ(pool.opts.slot_size, 32);
+
+  // Slots are distinct and aligned across several blocks.
+  void* slots[1000];
+  bool ok = true;
+  for (int i = 0; i < 1000; ++i) {
+    slots[i] = ac_pool_alloc(&pool);
+    ok &= slots[i] && (uintptr_t)slots[i] % 32 == 0;
+    memset(slots[i], i, 32);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    ok &= ((unsigned char*)slots[i])[31] == (unsigned char)i;
+  }
+  ac_test_expect(ok, "Slots overlap or are misaligned.");
+
+  // Freed slots are reused most recent first, without growing.
+  for (int i = 0; i < 1000; ++i) ac_pool_free(&pool, slots[i]);
+  unsigned char* const block = pool.block;
+  for (int i = 999; i >= 0; --i) ok &= ac_pool_alloc(&pool) == slots[i];
+  ac_test_expect(ok, "Slots were not reused in LIFO order.");
+  ac_test_expect(pool.block == block, "Pool grew instead of reusing slots.");
+
+  ac_pool_destroy(&pool);
+}
+
+static inline void pool_allocator2(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_pool pool = ac_pool_create((ac_pool_opts){.slot_size = 64});
+  const ac_allocator2 alloc = ac_pool_allocator2(&pool);
+
+  const ac_mem m = ac_alloc2(alloc, 40);
+  ac_test_expect(m.data, "Failed to allocate a slot.");
+  ac_test_expect(!ac_alloc2(alloc, 65).data, "Allocated beyond a slot.");
+  ac_test_expect(!ac_alloc2_aligned(alloc, 64, 8).data,
+                 "Allocated beyond the slot alignment.");
+
+  ac_free2(alloc, m);
+  ac_test_expect(ac_alloc2(alloc, 8).data == m.data, "Slot wasn't reused.");
+
+  ac_pool_destroy(&pool);
+}
+
+//------------------------------------------------------------------------------
+// Size-Class Heap
+//------------------------------------------------------------------------------
+
+static inline void heap_size_classes(ac_test_state* s) {
+  ac_test_begin(s);
+
+  // Every size fits its class, and the next smaller class is too small.
+  bool ok = true;
+  for (size_t size = 1; size <= AC_HEAP_MAX_SMALL; ++size) {
+    const size_t c = ac_heap_class(size);
+    ok &= c < AC_HEAP_CLASSES && size <= ac_heap_class_size(c);
+    ok &= !c || size > ac_heap_class_size(c - 1);
+  }
+  ac_test_expect(ok, "Wrong size class.");
+  ac_test_equ(ac_heap_class_size(AC_HEAP_CLASSES - 1), AC_HEAP_MAX_SMALL);
+}
+
+static inline void heap_allocator2(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_heap heap;
+  ac_heap_init(&heap, (ac_allocator2){});
+  const ac_allocator2 alloc = ac_heap_allocator2(&heap);
+
+  // Strings of many sizes, growing through the classes and into mmap.
+  ac_str strs[100];
+  for (int i = 0; i < 100; ++i) {
+    strs[i] = ac_str_init(alloc);
+    for (int j = 0; j < 2 * i * i; ++j) ac_to_str(&strs[i], "%d,", i);
+  }
+  bool ok = true;
+  for (int i = 0; i < 100; ++i) {
+    char pattern[8];
+    const int len = snprintf(pattern, sizeof(pattern), "%d,", i);
+    ok &= strs[i].len == (size_t)(2 * i * i * len);
+    for (size_t j = 0; j < strs[i].len; ++j) {
+      ok &= strs[i].data[j] == pattern[j % len];
+    }
+  }
+  ac_test_expect(ok, "Strings were corrupted.");
+  ac_test_gtu(strs[99].cap, AC_HEAP_MAX_SMALL);
+  for (int i = 0; i < 100; ++i) ac_str_free(&strs[i]);
+
+  // Resizing within a class stays in place.
+  const ac_mem m = ac_alloc2(alloc, 200);
+  ac_test_expect(ac_realloc2(alloc, m, 220).data == m.data, "Moved in class.");
+  ac_free2(alloc, (ac_mem){m.data, 220});
+
+  ac_heap_destroy(&heap);
+}
+
+//------------------------------------------------------------------------------
+// Buddy Allocation
+//------------------------------------------------------------------------------
+
+static inline void buddy_splits_and_merges(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_buddy buddy = ac_buddy_create((ac_buddy_opts){
+      .size = 60 * 1024,
+      .min_block = 64,
+  });
+  ac_test_equ(buddy.size, 64 * 1024);
+  ac_test_equ(buddy.max_order, 10);
+
+  // The region splits into exactly size / min_block blocks.
+  static void* blocks[1024];
+  for (int i = 0; i < 1024; ++i) blocks[i] = ac_buddy_alloc(&buddy, 50);
+  ac_test_expect(blocks[1023], "Region didn't split into smallest blocks.");
+  ac_test_expect(!ac_buddy_alloc(&buddy, 1), "Allocated beyond the region.");
+
+  // Freeing everything merges back into the whole region.
+  for (int i = 0; i < 1024; i += 2) ac_buddy_free(&buddy, blocks[i], 50);
+  for (int i = 1; i < 1024; i += 2) ac_buddy_free(&buddy, blocks[i], 50);
+  ac_test_expect(buddy.free_lists[buddy.max_order] ==
+                     (void*)buddy.region.buf.data,
+                 "Blocks didn't merge.");
+
+  // Aligning past the region's own alignment fails, rather than returning a
+  // block that is only aligned relative to the region.
+  const uintptr_t base = (uintptr_t)buddy.region.buf.data;
+  const ac_mem over = ac_alloc2_aligned(ac_buddy_allocator2(&buddy),
+                                        (base & -base) * 2, 100);
+  ac_test_expect(!over.data, "Misaligned block %p.", over.data);
+  ac_test_expect(ac_buddy_alloc(&buddy, 64 * 1024), "Whole region not free.");
+
+  ac_buddy_destroy(&buddy);
+}
+
+static inline void buddy_mixed_sizes(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_buddy buddy = ac_buddy_create((ac_buddy_opts){.size = 1024 * 1024});
+
+  // Blocks of mixed sizes don't overlap and are aligned to their size.
+  static unsigned char* ptrs[256];
+  static size_t sizes[256];
+  bool ok = true;
+  uint32_t rng = 1;
+  for (int round = 0; round < 20; ++round) {
+    for (int i = 0; i < 256; ++i) {
+      if (ptrs[i] && (rng = rng * 1664525 + 1013904223) >> 31) continue;
+      ac_buddy_free(&buddy, ptrs[i], sizes[i]);
+      sizes[i] = 1 + (rng >> 8) % 3000;
+      ptrs[i] = ac_buddy_alloc(&buddy, sizes[i]);
+      ok &= ptrs[i] && (uintptr_t)ptrs[i] %
+                               ac_buddy_block_size(&buddy, sizes[i]) == 0;
+      if (ptrs[i]) memset(ptrs[i], i, sizes[i]);
+    }
+    for (int i = 0; i < 256; ++i) {
+      ok &= ptrs[i][0] == (unsigned char)i &&
+            ptrs[i][sizes[i] - 1] == (unsigned char)i;
+    }
+  }
+  ac_test_expect(ok, "Blocks overlap or are misaligned.");
+
+  for (int i = 0; i < 256; ++i) ac_buddy_free(&buddy, ptrs[i], sizes[i]);
+  ac_test_expect(buddy.free_lists[buddy.max_order], "Blocks didn't merge.");
+
+  // Through the allocator adapter.
+  const ac_allocator2 alloc = ac_buddy_allocator2(&buddy);
+  ac_lista(uint32_t) list = {.alloc = alloc};
+  for (uint32_t i = 0; i < 10000; ++i) *ac_lista_next_ex(&list) = i;
+  ac_test_equ(list.data[9999], 9999);
+  ac_lista_free(&list);
+  const ac_mem m = ac_alloc2_aligned(alloc, 4096, 100);
+  ac_test_equ((uintptr_t)m.data % 4096, 0);
+  ac_free2(alloc, m);
+  ac_test_expect(buddy.free_lists[buddy.max_order], "Blocks didn't merge.");
+
+  ac_buddy_destroy(&buddy);
+}
+
+#if !defined(WASM)
+
+//------------------------------------------------------------------------------
+// Thread-Safe Arena
+//------------------------------------------------------------------------------
+
+enum { AC_MEM_TEST_THREADS = 8, AC_MEM_TEST_ALLOCS = 20000 };
+
+typedef struct ac_mem_test_mt_worker {
+  pthread_t thread;
+  ac_arena_mt* arena;
+  unsigned char id;
+  unsigned char* ptrs[AC_MEM_TEST_ALLOCS];
+} ac_mem_test_mt_worker;
+
+static inline size_t ac_mem_test_mt_size_(size_t i) {
+  return i % 97 == 0 ? 3000 : 1 + i % 61;
+}
+
+// Fills allocations with the worker's id, to be checked once all are done.
+static inline void* ac_mem_test_mt_work_(void* arg) {
+  ac_mem_test_mt_worker* w = arg;
+  for (size_t i = 0; i < AC_MEM_TEST_ALLOCS; ++i) {
+    const size_t size = ac_mem_test_mt_size_(i);
+    w->ptrs[i] = i % 2 ? ac_arena_mt_alloc(w->arena, size)
+                       : ac_arena_mt_alloc_aligned(w->arena, 16, size);
+    if (w->ptrs[i]) memset(w->ptrs[i], w->id, size);
+  }
+  return NULL;
+}
+
+static inline void arena_mt_concurrent_alloc(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_arena_mt arena;
+  ac_arena_mt_init(&arena, (ac_arena_opts){.alloc_size = 4096});
+
+  static ac_mem_test_mt_worker workers[AC_MEM_TEST_THREADS];
+  for (int t = 0; t < AC_MEM_TEST_THREADS; ++t) {
+    workers[t] = (ac_mem_test_mt_worker){.arena = &arena, .id = t + 1};
+    pthread_create(&workers[t].thread, NULL, &ac_mem_test_mt_work_,
+                   &workers[t]);
+  }
+  for (int t = 0; t < AC_MEM_TEST_THREADS; ++t) {
+    pthread_join(workers[t].thread, NULL);
+  }
+
+  // No allocation was overwritten by another thread.
+  bool all_ok = true;
+  for (int t = 0; t < AC_MEM_TEST_THREADS; ++t) {
+    for (size_t i = 0; i < AC_MEM_TEST_ALLOCS; ++i) {
+      const unsigned char* ptr = workers[t].ptrs[i];
+      all_ok &= ptr && (i % 2 || (uintptr_t)ptr % 16 == 0);
+      for (size_t j = 0; ptr && j < ac_mem_test_mt_size_(i); ++j) {
+        all_ok &= ptr[j] == workers[t].id;
+      }
+    }
+  }
+  ac_test_expect(all_ok, "Allocations overlap or are misaligned.");
+
+  ac_arena_mt_destroy(&arena);
+}
+
+//------------------------------------------------------------------------------
+// Per-Thread Arenas
+//------------------------------------------------------------------------------
+
+static inline size_t ac_mem_test_pool_count_(ac_block_pool* p) {
+  size_t count = 0;
+  for (unsigned char* b = atomic_load(&p->blocks); b; b = *(unsigned char**)b) {
+    ++count;
+  }
+  return count;
+}
+
+// Fills about three blocks of the thread's arena, then exits.
+static inline void* ac_mem_test_thread_arena_work_(void* arg) {
+  (void)arg;
+  for (int i = 0; i < 3000; ++i) {
+    memset(ac_arena_alloc(ac_thread_arena(), 1000), 0, 1000);
+  }
+  return NULL;
+}
+
+static inline void thread_arenas_share_blocks(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_block_pool* pool = ac_thread_arena_pool();
+  const size_t before = ac_mem_test_pool_count_(pool);
+
+  pthread_t threads[4];
+  for (int t = 0; t < 4; ++t) {
+    pthread_create(&threads[t], NULL, &ac_mem_test_thread_arena_work_, NULL);
+  }
+  for (int t = 0; t < 4; ++t) pthread_join(threads[t], NULL);
+
+  // Exiting threads gave their blocks to the pool (later threads may have
+  // reused blocks given by earlier ones).
+  const size_t pooled = ac_mem_test_pool_count_(pool);
+  ac_test_geu(pooled, before + 3);
+
+  // This thread draws from the pool, and gives back on release.
+  ac_mem_test_thread_arena_work_(NULL);
+  ac_test_equ(ac_mem_test_pool_count_(pool), pooled - 3);
+  ac_thread_arena_release();
+  ac_test_equ(ac_mem_test_pool_count_(pool), pooled);
+}
+
+//------------------------------------------------------------------------------
+// Shared Object Pool
+//------------------------------------------------------------------------------
+
+typedef struct ac_mem_test_magazine_worker {
+  pthread_t thread;
+  ac_pool_shared* shared;
+  bool ok;
+} ac_mem_test_magazine_worker;
+
+// Allocates and frees in bursts, checking that no slot is handed out twice.
+static inline void* ac_mem_test_magazine_work_(void* arg) {
+  ac_mem_test_magazine_worker* w = arg;
+  ac_pool_magazine m = ac_pool_magazine_create(w->shared);
+  static _Thread_local uint64_t* slots[1000];
+  w->ok = true;
+  for (int round = 0; round < 20; ++round) {
+    for (int i = 0; i < 1000; ++i) {
+      slots[i] = ac_pool_magazine_alloc(&m);
+      *slots[i] = (uintptr_t)slots[i];
+    }
+    for (int i = 0; i < 1000; ++i) {
+      w->ok &= *slots[i] == (uintptr_t)slots[i];
+      ac_pool_magazine_free(&m, slots[i]);
+    }
+  }
+  ac_pool_magazine_flush(&m);
+  return NULL;
+}
+
+static inline void pool_magazines_concurrent(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_pool_shared shared;
+  ac_pool_shared_init(&shared, (ac_pool_opts){.slot_size = sizeof(uint64_t)});
+
+  ac_mem_test_magazine_worker workers[4];
+  for (int t = 0; t < 4; ++t) {
+    workers[t] = (ac_mem_test_magazine_worker){.shared = &shared};
+    pthread_create(&workers[t].thread, NULL, &ac_mem_test_magazine_work_,
+                   &workers[t]);
+  }
+  bool ok = true;
+  for (int t = 0; t < 4; ++t) {
+    pthread_join(workers[t].thread, NULL);
+    ok &= workers[t].ok;
+  }
+  ac_test_expect(ok, "A slot was handed out twice.");
+
+  // Every slot carved so far is back in the shared pool.
+  const ac_pool* pool = &shared.pool;
+  size_t blocks = 0;
+  for (unsigned char* b = pool->block; b; b = *(unsigned char**)b) ++blocks;
+  const size_t carved = blocks * pool->opts.slots_per_block -
+                        (pool->end - pool->next) / pool->opts.slot_size;
+  size_t free_slots = 0;
+  for (ac_pool_slot* x = pool->free; x; x = x->next) ++free_slots;
+  ac_test_equ(free_slots, carved);
+  ac_test_geu(free_slots, 1000);
+
+  ac_pool_shared_destroy(&shared);
+}
+
+typedef struct ac_mem_test_heap_worker {
+  pthread_t thread;
+  ac_heap* heap;
+  void* ptrs[1000];  // Allocated by another thread, freed by this one.
+  bool ok;
+} ac_mem_test_heap_worker;
+
+static inline void* ac_mem_test_heap_work_(void* arg) {
+  ac_mem_test_heap_worker* w = arg;
+  w->ok = true;
+  for (size_t i = 0; i < 1000; ++i) {
+    w->ok &= *(size_t*)w->ptrs[i] == i;
+    ac_heap_free(w->heap, w->ptrs[i], 8 + i % 300);
+  }
+  for (size_t i = 0; i < 1000; ++i) {
+    w->ptrs[i] = ac_heap_alloc(w->heap, 8 + i % 300);
+    *(size_t*)w->ptrs[i] = i;
+  }
+  return NULL;
+}
+
+static inline void heap_threads_free_each_others_memory(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_heap heap;
+  ac_heap_init(&heap, (ac_allocator2){});
+
+  static ac_mem_test_heap_worker workers[4];
+  for (int t = 0; t < 4; ++t) {
+    workers[t] = (ac_mem_test_heap_worker){.heap = &heap};
+    for (size_t i = 0; i < 1000; ++i) {
+      workers[t].ptrs[i] = ac_heap_alloc(&heap, 8 + i % 300);
+      *(size_t*)workers[t].ptrs[i] = i;
+    }
+  }
+  for (int t = 0; t < 4; ++t) {
+    pthread_create(&workers[t].thread, NULL, &ac_mem_test_heap_work_,
+                   &workers[t]);
+  }
+  bool ok = true;
+  for (int t = 0; t < 4; ++t) {
+    pthread_join(workers[t].thread, NULL);
+    ok &= workers[t].ok;
+    for (size_t i = 0; i < 1000; ++i) {
+      ok &= *(size_t*)workers[t].ptrs[i] == i;
+      ac_heap_free(&heap, workers[t].ptrs[i], 8 + i % 300);
+    }
+  }
+  ac_test_expect(ok, "Heap memory was corrupted across threads.");
+
+  ac_heap_destroy(&heap);
+}
+
+#endif  // !defined(WASM)
+
+//------------------------------------------------------------------------------
+// Virtual Memory Arena
+//------------------------------------------------------------------------------
+
+static inline void vm_arena_grows_list_in_place(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_vm_arena arena = ac_vm_arena_create((size_t)1 << 30);
+  ac_test_expect(arena.data, "Failed to reserve address space.");
+
+  ac_lista(uint32_t) list = {.alloc = ac_vm_arena_allocator2(&arena)};
+  *ac_lista_next_ex(&list) = 0;
+  const uint32_t* const data = list.data;
+
+  bool items_ok = true;
+  for (uint32_t i = 1; i < 1000000; ++i) *ac_lista_next_ex(&list) = i;
+  for (uint32_t i = 0; i < 1000000; ++i) items_ok &= list.data[i] == i;
+  ac_test_expect(list.data == data, "List moved instead of growing in place.");
+  ac_test_expect(items_ok, "Items changed after growing.");
+  ac_test_leu(arena.committed, arena.reserved);
+  ac_test_geu(arena.committed, arena.pos);
+
+  ac_vm_arena_reset(&arena);
+  ac_test_equ(arena.committed, 0);
+  ac_test_equ(arena.pos, 0);
+
+  // Pages are committed again after a reset.
+  uint64_t* values = ac_vm_arena_alloc_aligned(&arena, 64, 1000 * 8);
+  ac_test_expect(values == (void*)arena.data, "Reset didn't rewind.");
+  for (int i = 0; i < 1000; ++i) values[i] = i;
+
+  // Allocations beyond the reservation fail.
+  ac_test_expect(!ac_vm_arena_alloc(&arena, arena.reserved),
+                 "Allocated beyond the reservation.");
+
+  ac_vm_arena_destroy(&arena);
+}
+
+//------------------------------------------------------------------------------
+// Huge Pages
+//------------------------------------------------------------------------------
+
+// The backing a huge page mapping should report without reserved huge pages:
+// advised THP, unless THP is disabled system-wide.
+static inline ac_page_backing ac_mem_test_thp_backing_(void) {
+#if defined(MADV_HUGEPAGE)
+  char mode[64] = {};
+  FILE* f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+  if (!f) return AC_PAGE_BACKING_THP_ADVISED;
+  const bool never = fgets(mode, sizeof(mode), f) && strstr(mode, "[never]");
+  fclose(f);
+  return never ? AC_PAGE_BACKING_DEFAULT : AC_PAGE_BACKING_THP_ADVISED;
+#else
+  return AC_PAGE_BACKING_DEFAULT;
+#endif
+}
+
+static inline void page_map_huge_pages(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_slab slab = {};
+  ac_slab_block values = ac_slab_alloc_type(&slab, uint64_t, 1000000);
+  ac_page_map m = ac_slab_map(&slab, AC_HUGE_PAGES_TRY);
+
+  // Without reserved huge pages, this still gets aligned regular pages, and
+  // reports THP only as advised.
+  if (m.backing != AC_PAGE_BACKING_HUGETLB) {
+    ac_test_equ(m.backing, ac_mem_test_thp_backing_());
+  }
+  ac_test_expect(strcmp(ac_page_backing_str(m.backing), "unknown"),
+                 "Unnamed backing %d.", (int)m.backing);
+  ac_test_equ((uintptr_t)m.buf.data % AC_HUGE_PAGE_SIZE, 0);
+  ac_test_equ(m.buf.size % AC_HUGE_PAGE_SIZE, 0);
+  ac_test_geu(m.buf.size, ac_slab_size(&slab));
+
+  ac_span(uint64_t) span = ac_span_from_slab(uint64_t, m.buf.data, values);
+  for (size_t i = 0; i < span.len; ++i) span.data[i] = i;
+  ac_page_unmap(m);
+
+  m = ac_page_map_alloc(100, AC_HUGE_PAGES_NONE);
+  ac_test_equ(m.backing, AC_PAGE_BACKING_DEFAULT);
+  ac_test_expect(m.buf.data, "Failed to map regular pages.");
+  ac_page_unmap(m);
+}
+
+static inline void arena_huge_pages(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_arena arena = ac_arena_create((ac_arena_opts){
+      .alloc_size = 1024,
+      .huge_pages = AC_HUGE_PAGES_TRY,
+  });
+  if (arena.backing != AC_PAGE_BACKING_HUGETLB) {
+    ac_test_equ(arena.backing, ac_mem_test_thp_backing_());
+  }
+
+  // Blocks are whole huge pages, and large allocations work as usual.
+  ac_test_equ(arena.root.size, AC_HUGE_PAGE_SIZE);
+  const ac_arena_savepoint mark = ac_arena_mark(&arena);
+  memset(ac_arena_alloc(&arena, 3 * AC_HUGE_PAGE_SIZE), 1,
+         3 * AC_HUGE_PAGE_SIZE);
+  ac_arena_rewind(&arena, mark);
+  ac_test_expect(!arena.large, "Large allocation wasn't freed.");
+
+  ac_arena_destroy(&arena);
+}
+
+static inline void file_map_huge_pages(ac_test_state* s) {
+  ac_test_begin(s);
+
+  char path[] = "/tmp/ac_mem_test_XXXXXX";
+  const int fd = mkstemp(path);
+  ac_test_expect(fd >= 0, "Failed to create a temporary file.");
+  const char text[] = "mapped with huge pages";
+  ac_test_equ(write(fd, text, sizeof(text)), sizeof(text));
+  close(fd);
+
+  const ac_page_map m = ac_file_map_read_ex(path, AC_HUGE_PAGES_TRY);
+  unlink(path);
+  ac_test_expect(m.backing == AC_PAGE_BACKING_DEFAULT ||
+                     m.backing == AC_PAGE_BACKING_THP_ADVISED,
+                 "Wrong backing %s.", ac_page_backing_str(m.backing));
+  ac_test_equ(m.buf.size, sizeof(text));
+  ac_test_equ((uintptr_t)m.buf.data % AC_HUGE_PAGE_SIZE, 0);
+  ac_test_expect(!memcmp(m.buf.data, text, sizeof(text)), "Wrong contents.");
+  ac_page_unmap(m);
+}
+
+static inline void ac_mem_test(ac_test_state* s) {
+  ac_test_begin(s);
+  ac_test_run(arena_rewind_recycles_blocks);
+  ac_test_run(arena_reset_keeps_blocks);
+  ac_test_run(arena_alloc_aligned);
+  ac_test_run(arena_block_align);
+  ac_test_run(arena_allocator2_grows_top_in_place);
+  ac_test_run(arena_allocator2_copies_when_not_top);
+  ac_test_run(pool_reuses_freed_slots);
+  ac_test_run(pool_allocator2);
+  ac_test_run(heap_size_classes);
+  ac_test_run(heap_allocator2);
+  ac_test_run(buddy_splits_and_merges);
+  ac_test_run(buddy_mixed_sizes);
+#if !defined(WASM)
+  ac_test_run(arena_mt_concurrent_alloc);
+  ac_test_run(thread_arenas_share_blocks);
+  ac_test_run(pool_magazines_concurrent);
+  ac_test_run(heap_threads_free_each_others_memory);
+#endif
+  ac_test_run(vm_arena_grows_list_in_place);
+  ac_test_run(page_map_huge_pages);
+  ac_test_run(arena_huge_pages);
+  ac_test_run(file_map_huge_pages);
+}
+
+#endif  // AC_MEM_TEST_H_
@@ -0,0 +1,319 @@
+#ifndef AC_RING_H_
+#define AC_RING_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ac_alloc.h"
+#include "ac_mem.h"
+
+//------------------------------------------------------------------------------
+// Ring Buffers.
+//------------------------------------------------------------------------------
+
+// Bounded queues for passing fixed-size elements between threads, without
+// locks. Elements are copied in and out by value.
+//  - 'ac_spsc' has one producer and one consumer thread. Every operation is
+//    wait-free, and reads the other side's index only when its cached copy
+//    says the ring is full (or empty).
+//  - 'ac_mpmc' has any number of producers and consumers. Each slot carries a
+//    sequence number telling which lap of the ring may use it next, so threads
+//    claim slots with one compare-and-swap and only wait for each other when a
+//    claimed slot is still being filled or emptied.
+// Batch pushes and pops move many elements for the cost of one atomic update.
+//
+// Storage is either provided by the caller (an 'ac_buf', aligned for size_t)
+// or allocated. The capacity is a power of two: the requested one rounded up,
+// or as much as fits in the provided storage.
+
+// Cache line size, to keep indices written by different threads apart.
+enum { AC_CACHE_LINE = 64 };
+
+// Ring options, for both kinds of rings.
+typedef struct ac_ring_opts {
+  size_t elem_size;     // Bytes per element.
+  size_t cap;           // Number of elements to allocate. Defaults to 1024.
+  ac_buf storage;       // Caller-provided storage, instead of allocating.
+  ac_allocator2 alloc;  // Allocator for the storage. Defaults to malloc.
+} ac_ring_opts;
+
+// Single-producer single-consumer ring.
+typedef struct ac_spsc {
+  // Written by the producer.
+  _Alignas(AC_CACHE_LINE) atomic_size_t tail;
+  size_t head_cache;
+  // Written by the consumer.
+  _Alignas(AC_CACHE_LINE) atomic_size_t head;
+  size_t tail_cache;
+  // Constant.
+  _Alignas(AC_CACHE_LINE) unsigned char* data;
+  size_t mask;
+  size_t elem_size;
+  ac_allocator2 alloc;  // Set if the ring allocated 'data'.
+} ac_spsc;
+
+// Initialize an empty ring. Returns false if allocation failed or the storage
+// can't hold a single element.
+static inline bool ac_spsc_init(ac_spsc*, ac_ring_opts);
+
+// Frees the storage if the ring allocated it.
+static inline void ac_spsc_destroy(ac_spsc*);
+
+// Producer: copies in up to 'n' elements, returning how many fit.
+static inline size_t ac_spsc_push_n(ac_spsc*, const void* elems, size_t n);
+
+// Producer: copies in one element. Returns false if the ring is full.
+static inline bool ac_spsc_push(ac_spsc* x, const void* elem) {
+  return ac_spsc_push_n(x, elem, 1);
+}
+
+// Consumer: copies out up to 'n' elements, returning how many there were.
+static inline size_t ac_spsc_pop_n(ac_spsc*, void* elems, size_t n);
+
+// Consumer: copies out one element. Returns false if the ring is empty.
+static inline bool ac_spsc_pop(ac_spsc* x, void* elem) {
+  return ac_spsc_pop_n(x, elem, 1);
+}
+
+// Multi-producer multi-consumer ring.
+typedef struct ac_mpmc {
+  _Alignas(AC_CACHE_LINE) atomic_size_t tail;
+  _Alignas(AC_CACHE_LINE) atomic_size_t head;
+  // Constant. Each slot is a sequence number, then the element.
+  _Alignas(AC_CACHE_LINE) unsigned char* data;
+  size_t mask;
+  size_t elem_size;
+  size_t slot_size;
+  ac_allocator2 alloc;  // Set if the ring allocated 'data'.
+} ac_mpmc;
+
+// Initialize an empty ring. Returns false if allocation failed or the storage
+// can't hold a single element.
+static inline bool ac_mpmc_init(ac_mpmc*, ac_ring_opts);
+
+// Frees the storage if the ring allocated it.
+static inline void ac_mpmc_destroy(ac_mpmc*);
+
+// Copies in up to 'n' elements, returning how many fit. They are popped in
+// order, though elements of other producers may come between them.
+static inline size_t ac_mpmc_push_n(ac_mpmc*, const void* elems, size_t n);
+
+// Copies in one element. Returns false if the ring is full.
+static inline bool ac_mpmc_push(ac_mpmc* x, const void* elem) {
+  return ac_mpmc_push_n(x, elem, 1);
+}
+
+// Copies out up to 'n' consecutive elements, returning how many there were.
+static inline size_t ac_mpmc_pop_n(ac_mpmc*, void* elems, size_t n);
+
+// Copies out one element. Returns false if the ring is empty.
+static inline bool ac_mpmc_pop(ac_mpmc* x, void* elem) {
+  return ac_mpmc_pop_n(x, elem, 1);
+}
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// Largest power of two not above 'n', or 0.
+static inline size_t ac_ring_floor_pow2_(size_t n) {
+  return n ? (size_t)1 << (63 - __builtin_clzll(n)) : 0;
+}
+
+// Size of allocated storage, padded so the next allocation can't share its
+// last cache line.
+static inline size_t ac_ring_alloc_size_(size_t cap, size_t slot_size) {
+  return ac_align_up(cap * slot_size, AC_CACHE_LINE);
+}
+
+// Sets up storage for slots of 'slot_size' bytes. Returns the capacity, or 0.
+static inline size_t ac_ring_storage_(ac_ring_opts* opts, size_t slot_size,
+                                      unsigned char** data,
+                                      ac_allocator2* alloc) {
+  *alloc = (ac_allocator2){};
+  if (opts->storage.data) {
+    *data = opts->storage.data;
+    return ac_ring_floor_pow2_(opts->storage.size / slot_size);
+  }
+
+  if (!opts->cap) opts->cap = 1024;
+  const size_t cap =
+      opts->cap > 1 ? ac_ring_floor_pow2_(opts->cap - 1) * 2 : 1;
+  if (ac_allocator2_is_empty(opts->alloc)) opts->alloc = ac_mallocator2();
+  *data = ac_alloc2_aligned(opts->alloc, AC_CACHE_LINE,
+                            ac_ring_alloc_size_(cap, slot_size))
+              .data;
+  if (!*data) return 0;
+  *alloc = opts->alloc;
+  return cap;
+}
+
+static inline void ac_ring_free_storage_(ac_allocator2 alloc,
+                                         unsigned char* data, size_t cap,
+                                         size_t slot_size) {
+  if (ac_allocator2_is_empty(alloc)) return;
+  ac_free2(alloc, (ac_mem){data, ac_ring_alloc_size_(cap, slot_size)});
+}
+
+// Copies 'n' elements into the ring from position 'i' on, wrapping around.
+static inline void ac_ring_copy_in_(unsigned char* data, size_t mask,
+                                    size_t elem_size, size_t i,
+                                    const void* elems, size_t n) {
+  const size_t start = i & mask;
+  const size_t first = n < mask + 1 - start ? n : mask + 1 - start;
+  memcpy(data + start * elem_size, elems, first * elem_size);
+  memcpy(data, (const unsigned char*)elems + first * elem_size,
+         (n - first) * elem_size);
+}
+
+// Copies 'n' elements out of the ring from position 'i' on, wrapping around.
+static inline void ac_ring_copy_out_(const unsigned char* data, size_t mask,
+                                     size_t elem_size, size_t i, void* elems,
+                                     size_t n) {
+  const size_t start = i & mask;
+  const size_t first = n < mask + 1 - start ? n : mask + 1 - start;
+  memcpy(elems, data + start * elem_size, first * elem_size);
+  memcpy((unsigned char*)elems + first * elem_size, data,
+         (n - first) * elem_size);
+}
+
+static inline bool ac_spsc_init(ac_spsc* x, ac_ring_opts opts) {
+  *x = (ac_spsc){.elem_size = opts.elem_size};
+  if (!opts.elem_size) return false;
+  const size_t cap =
+      ac_ring_storage_(&opts, opts.elem_size, &x->data, &x->alloc);
+  if (!cap) return false;
+  x->mask = cap - 1;
+  atomic_init(&x->tail, 0);
+  atomic_init(&x->head, 0);
+  return true;
+}
+
+static inline void ac_spsc_destroy(ac_spsc* x) {
+  ac_ring_free_storage_(x->alloc, x->data, x->mask + 1, x->elem_size);
+  *x = (ac_spsc){};
+}
+
+static inline size_t ac_spsc_push_n(ac_spsc* x, const void* elems, size_t n) {
+  const size_t tail = atomic_load_explicit(&x->tail, memory_order_relaxed);
+  size_t room = x->mask + 1 - (tail - x->head_cache);
+  if (room < n) {
+    x->head_cache = atomic_load_explicit(&x->head, memory_order_acquire);
+    room = x->mask + 1 - (tail - x->head_cache);
+  }
+  if (n > room) n = room;
+  if (!n) return 0;
+
+  ac_ring_copy_in_(x->data, x->mask, x->elem_size, tail, elems, n);
+  atomic_store_explicit(&x->tail, tail + n, memory_order_release);
+  return n;
+}
+
+static inline size_t ac_spsc_pop_n(ac_spsc* x, void* elems, size_t n) {
+  const size_t head = atomic_load_explicit(&x->head, memory_order_relaxed);
+  size_t used = x->tail_cache - head;
+  if (used < n) {
+    x->tail_cache = atomic_load_explicit(&x->tail, memory_order_acquire);
+    used = x->tail_cache - head;
+  }
+  if (n > used) n = used;
+  if (!n) return 0;
+
+  ac_ring_copy_out_(x->data, x->mask, x->elem_size, head, elems, n);
+  atomic_store_explicit(&x->head, head + n, memory_order_release);
+  return n;
+}
+
+// The sequence number of the slot of position 'i'. A producer may fill the
+// slot once it equals 'i', and a consumer may empty it once it equals 'i + 1'.
+static inline atomic_size_t* ac_mpmc_seq_(const ac_mpmc* x, size_t i) {
+  return (atomic_size_t*)(x->data + (i & x->mask) * x->slot_size);
+}
+
+static inline unsigned char* ac_mpmc_elem_(const ac_mpmc* x, size_t i) {
+  return x->data + (i & x->mask) * x->slot_size + sizeof(atomic_size_t);
+}
+
+static inline bool ac_mpmc_init(ac_mpmc* x, ac_ring_opts opts) {
+  *x = (ac_mpmc){
+      .elem_size = opts.elem_size,
+      .slot_size = ac_align_up(sizeof(atomic_size_t) + opts.elem_size,
+                               _Alignof(atomic_size_t)),
+  };
+  if (!opts.elem_size) return false;
+  const size_t cap =
+      ac_ring_storage_(&opts, x->slot_size, &x->data, &x->alloc);
+  if (!cap) return false;
+  x->mask = cap - 1;
+  for (size_t i = 0; i < cap; ++i) atomic_init(ac_mpmc_seq_(x, i), i);
+  atomic_init(&x->tail, 0);
+  atomic_init(&x->head, 0);
+  return true;
+}
+
+static inline void ac_mpmc_destroy(ac_mpmc* x) {
+  ac_ring_free_storage_(x->alloc, x->data, x->mask + 1, x->slot_size);
+  *x = (ac_mpmc){};
+}
+
+// Claims up to 'n' consecutive positions from '*pos_ptr' on whose slots are
+// ready, i.e. have the sequence number 'position + lap'. Stores the first in
+// '*pos' and returns how many were claimed. A ready slot stays ready until its
+// position is claimed, so one compare-and-swap claims them all.
+static inline size_t ac_mpmc_claim_(const ac_mpmc* x, atomic_size_t* pos_ptr,
+                                    size_t lap, size_t n, size_t* pos) {
+  size_t p = atomic_load_explicit(pos_ptr, memory_order_relaxed);
+  for (;;) {
+    size_t k = 0;
+    intptr_t diff = 0;
+    for (; k < n; ++k) {
+      const size_t seq = atomic_load_explicit(ac_mpmc_seq_(x, p + k),
+                                              memory_order_acquire);
+      diff = (intptr_t)(seq - (p + k + lap));
+      if (diff) break;
+    }
+    if (k) {
+      // On failure, 'p' is reloaded.
+      if (atomic_compare_exchange_weak_explicit(pos_ptr, &p, p + k,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        *pos = p;
+        return k;
+      }
+      continue;
+    }
+    // Behind: the slot is still in use from the previous lap, so the ring is
+    // full (or empty). Ahead: another thread claimed 'p' first.
+    if (diff < 0) return 0;
+    p = atomic_load_explicit(pos_ptr, memory_order_relaxed);
+  }
+}
+
+static inline size_t ac_mpmc_push_n(ac_mpmc* x, const void* elems, size_t n) {
+  size_t pos = 0;
+  n = ac_mpmc_claim_(x, &x->tail, 0, n, &pos);
+  const unsigned char* src = elems;
+  for (size_t i = 0; i < n; ++i, src += x->elem_size) {
+    memcpy(ac_mpmc_elem_(x, pos + i), src, x->elem_size);
+    atomic_store_explicit(ac_mpmc_seq_(x, pos + i), pos + i + 1,
+                          memory_order_release);
+  }
+  return n;
+}
+
+static inline size_t ac_mpmc_pop_n(ac_mpmc* x, void* elems, size_t n) {
+  size_t pos = 0;
+  n = ac_mpmc_claim_(x, &x->head, 1, n, &pos);
+  unsigned char* dst = elems;
+  for (size_t i = 0; i < n; ++i, dst += x->elem_size) {
+    memcpy(dst, ac_mpmc_elem_(x, pos + i), x->elem_size);
+    atomic_store_explicit(ac_mpmc_seq_(x, pos + i), pos + i + x->mask + 1,
+                          memory_order_release);
+  }
+  return n;
+}
+
+#endif  // AC_RING_H_
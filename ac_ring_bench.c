@@ -0,0 +1,209 @@
+// Measures the throughput of 'ac_spsc' and 'ac_mpmc', one element and batches
+// at a time, and the round-trip latency of a pair of SPSC rings. Only
+// meaningful in optimized builds:
+//
+//   make OPT=1 ac_ring_bench && build/ac_ring_bench
+//
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ac_ring.h"
+
+#define AC_TIME_IMPL
+#include "ac_time.h"
+
+enum {
+  AC_RING_BENCH_ELEMS = 1 << 23,   // Passed through the ring per measurement.
+  AC_RING_BENCH_BATCH = 32,        // Elements per batch push or pop.
+  AC_RING_BENCH_THREADS = 4,       // Most producers, and consumers, for MPMC.
+  AC_RING_BENCH_ROUND_TRIPS = 1 << 16,
+  AC_RING_BENCH_SPINS = 1024,      // Spins before yielding the CPU.
+};
+
+static inline double ac_ring_bench_ns_(ac_cputime t0) {
+  const ac_dcputime dt = ac_cputime_diff(ac_cputime_now(), t0);
+  return 1e9 * dt.cpu_dticks / ac_cputime_freq();
+}
+
+// Spins on a full or empty ring for a while, then yields, so that both sides
+// make progress even when they share a core.
+static inline void ac_ring_bench_wait_(size_t* spins) {
+  if (++*spins < AC_RING_BENCH_SPINS) return;
+  sched_yield();
+  *spins = 0;
+}
+
+//------------------------------------------------------------------------------
+// Throughput
+//------------------------------------------------------------------------------
+
+typedef struct ac_ring_bench_side {
+  pthread_t thread;
+  ac_spsc* spsc;  // The ring, or 'mpmc'.
+  ac_mpmc* mpmc;
+  size_t count;  // Elements to push or pop.
+  size_t batch;
+  uint64_t sum;  // Of the popped elements.
+} ac_ring_bench_side;
+
+static inline size_t ac_ring_bench_push_(ac_ring_bench_side* x,
+                                         const uint64_t* elems, size_t n) {
+  return x->spsc ? ac_spsc_push_n(x->spsc, elems, n)
+                 : ac_mpmc_push_n(x->mpmc, elems, n);
+}
+
+static inline size_t ac_ring_bench_pop_(ac_ring_bench_side* x, uint64_t* elems,
+                                        size_t n) {
+  return x->spsc ? ac_spsc_pop_n(x->spsc, elems, n)
+                 : ac_mpmc_pop_n(x->mpmc, elems, n);
+}
+
+static inline void* ac_ring_bench_produce_(void* arg) {
+  ac_ring_bench_side* x = arg;
+  uint64_t elems[AC_RING_BENCH_BATCH];
+  size_t spins = 0;
+  for (size_t i = 0; i < x->count;) {
+    const size_t n = ac_min(x->batch, x->count - i);
+    for (size_t j = 0; j < n; ++j) elems[j] = i + j;
+    size_t pushed = 0;
+    while (pushed < n) {
+      const size_t k = ac_ring_bench_push_(x, elems + pushed, n - pushed);
+      if (!k) ac_ring_bench_wait_(&spins);
+      pushed += k;
+    }
+    i += n;
+  }
+  return NULL;
+}
+
+static inline void* ac_ring_bench_consume_(void* arg) {
+  ac_ring_bench_side* x = arg;
+  uint64_t elems[AC_RING_BENCH_BATCH];
+  size_t spins = 0;
+  for (size_t i = 0; i < x->count;) {
+    const size_t k =
+        ac_ring_bench_pop_(x, elems, ac_min(x->batch, x->count - i));
+    if (!k) ac_ring_bench_wait_(&spins);
+    for (size_t j = 0; j < k; ++j) x->sum += elems[j];
+    i += k;
+  }
+  return NULL;
+}
+
+// Returns millions of elements per second through the ring, with 'threads'
+// producers and as many consumers. SPSC rings only take one of each.
+static inline double ac_ring_bench_throughput_(bool mpmc, size_t threads,
+                                               size_t batch) {
+  ac_spsc spsc;
+  ac_mpmc ring;
+  const ac_ring_opts opts = {.elem_size = sizeof(uint64_t)};
+  if (mpmc ? !ac_mpmc_init(&ring, opts) : !ac_spsc_init(&spsc, opts)) {
+    return 0;
+  }
+
+  // The consumers' shares add up to the producers'.
+  const size_t per_thread = AC_RING_BENCH_ELEMS / threads;
+  ac_ring_bench_side producers[AC_RING_BENCH_THREADS];
+  ac_ring_bench_side consumers[AC_RING_BENCH_THREADS];
+  const ac_cputime t0 = ac_cputime_now();
+  for (size_t t = 0; t < threads; ++t) {
+    const ac_ring_bench_side side = {.spsc = mpmc ? NULL : &spsc,
+                                     .mpmc = mpmc ? &ring : NULL,
+                                     .count = per_thread,
+                                     .batch = batch};
+    producers[t] = consumers[t] = side;
+    pthread_create(&producers[t].thread, NULL, &ac_ring_bench_produce_,
+                   &producers[t]);
+    pthread_create(&consumers[t].thread, NULL, &ac_ring_bench_consume_,
+                   &consumers[t]);
+  }
+  uint64_t sum = 0;
+  for (size_t t = 0; t < threads; ++t) {
+    pthread_join(producers[t].thread, NULL);
+    pthread_join(consumers[t].thread, NULL);
+    sum += consumers[t].sum;
+  }
+  const double ns = ac_ring_bench_ns_(t0);
+
+  // Every element made it through once.
+  const uint64_t want = threads * (per_thread * (per_thread - 1) / 2);
+  if (sum != want) printf("Lost elements: sum %llu, want %llu.\n",
+                          (unsigned long long)sum, (unsigned long long)want);
+
+  if (mpmc) {
+    ac_mpmc_destroy(&ring);
+  } else {
+    ac_spsc_destroy(&spsc);
+  }
+  return 1e3 * per_thread * threads / ns;
+}
+
+//------------------------------------------------------------------------------
+// Latency
+//------------------------------------------------------------------------------
+
+// Echoes elements from 'rings[0]' back into 'rings[1]'.
+static inline void* ac_ring_bench_echo_(void* arg) {
+  ac_spsc* rings = arg;
+  size_t spins = 0;
+  for (size_t i = 0; i < AC_RING_BENCH_ROUND_TRIPS; ++i) {
+    uint64_t elem;
+    while (!ac_spsc_pop(&rings[0], &elem)) ac_ring_bench_wait_(&spins);
+    while (!ac_spsc_push(&rings[1], &elem)) ac_ring_bench_wait_(&spins);
+  }
+  return NULL;
+}
+
+static inline int ac_ring_bench_cmp_(const void* a, const void* b) {
+  const double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+// Prints percentiles of the time for one element to go through a ring to
+// another thread and back through a second ring.
+static inline void ac_ring_bench_latency_(void) {
+  ac_spsc rings[2];
+  const ac_ring_opts opts = {.elem_size = sizeof(uint64_t), .cap = 64};
+  if (!ac_spsc_init(&rings[0], opts) || !ac_spsc_init(&rings[1], opts)) return;
+
+  static double samples[AC_RING_BENCH_ROUND_TRIPS];
+  pthread_t echo;
+  pthread_create(&echo, NULL, &ac_ring_bench_echo_, rings);
+  size_t spins = 0;
+  for (size_t i = 0; i < AC_RING_BENCH_ROUND_TRIPS; ++i) {
+    const ac_cputime t0 = ac_cputime_now();
+    uint64_t elem = i;
+    while (!ac_spsc_push(&rings[0], &elem)) ac_ring_bench_wait_(&spins);
+    while (!ac_spsc_pop(&rings[1], &elem)) ac_ring_bench_wait_(&spins);
+    samples[i] = ac_ring_bench_ns_(t0);
+  }
+  pthread_join(echo, NULL);
+  ac_spsc_destroy(&rings[0]);
+  ac_spsc_destroy(&rings[1]);
+
+  qsort(samples, AC_RING_BENCH_ROUND_TRIPS, sizeof(*samples),
+        &ac_ring_bench_cmp_);
+  const size_t n = AC_RING_BENCH_ROUND_TRIPS;
+  printf("\nspsc round trip ns: p50 %.0f, p90 %.0f, p99 %.0f, max %.0f\n",
+         samples[n / 2], samples[n * 9 / 10], samples[n * 99 / 100],
+         samples[n - 1]);
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  printf("%-8s %-8s %14s %14s\n", "ring", "threads", "single M/s",
+         "batch M/s");
+  printf("%-8s %-8d %14.1f %14.1f\n", "spsc", 1,
+         ac_ring_bench_throughput_(false, 1, 1),
+         ac_ring_bench_throughput_(false, 1, AC_RING_BENCH_BATCH));
+  for (size_t threads = 1; threads <= AC_RING_BENCH_THREADS; threads *= 2) {
+    printf("%-8s %-8zu %14.1f %14.1f\n", "mpmc", threads,
+           ac_ring_bench_throughput_(true, threads, 1),
+           ac_ring_bench_throughput_(true, threads, AC_RING_BENCH_BATCH));
+  }
+  ac_ring_bench_latency_();
+  return 0;
+}
@@ -0,0 +1,233 @@
+#ifndef AC_RING_TEST_H_
+#define AC_RING_TEST_H_
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(WASM)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "ac_ring.h"
+#include "ac_test.h"
+
+//------------------------------------------------------------------------------
+// Ring Buffers
+//------------------------------------------------------------------------------
+
+static inline void spsc_wraps_around(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_spsc x;
+  ac_test_expect(ac_spsc_init(&x, (ac_ring_opts){.elem_size = 4, .cap = 5}),
+                 "Init failed.");
+  ac_test_equ(x.mask + 1, 8);
+
+  uint32_t v = 0;
+  ac_test_expect(!ac_spsc_pop(&x, &v), "Popped from an empty ring.");
+
+  // Push and pop past the end of the storage a few times.
+  uint32_t next_in = 0, next_out = 0;
+  for (int round = 0; round < 5; ++round) {
+    for (int i = 0; i < 6; ++i, ++next_in) {
+      ac_test_expect(ac_spsc_push(&x, &next_in), "Push %d failed.", i);
+    }
+    for (int i = 0; i < 6; ++i, ++next_out) {
+      ac_test_expect(ac_spsc_pop(&x, &v), "Pop %d failed.", i);
+      ac_test_equ(v, next_out);
+    }
+  }
+
+  // Batches take as many elements as fit.
+  uint32_t in[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9}, out[10] = {};
+  ac_test_equ(ac_spsc_push_n(&x, in, 10), 8);
+  ac_test_expect(!ac_spsc_push(&x, &in[8]), "Pushed to a full ring.");
+  ac_test_equ(ac_spsc_pop_n(&x, out, 3), 3);
+  ac_test_equ(ac_spsc_push_n(&x, in + 8, 2), 2);
+  ac_test_equ(ac_spsc_pop_n(&x, out + 3, 10), 7);
+  for (int i = 0; i < 10; ++i) ac_test_equ(out[i], in[i]);
+  ac_test_equ(ac_spsc_pop_n(&x, out, 10), 0);
+
+  ac_spsc_destroy(&x);
+}
+
+static inline void mpmc_single_thread(ac_test_state* s) {
+  ac_test_begin(s);
+
+  // Caller storage for four 3-byte elements, and some spare bytes.
+  _Alignas(size_t) unsigned char storage[4 * 16 + 10];
+  ac_mpmc x;
+  ac_test_expect(
+      ac_mpmc_init(&x, (ac_ring_opts){.elem_size = 3,
+                                      .storage = {storage, sizeof(storage)}}),
+      "Init failed.");
+  ac_test_equ(x.mask + 1, 4);
+  ac_test_expect(x.data == storage, "Storage wasn't used.");
+
+  char in[] = "abcdefghijklmnopqrstuvwxyz";
+  char out[27] = {};
+  ac_test_expect(!ac_mpmc_pop(&x, out), "Popped from an empty ring.");
+  ac_test_equ(ac_mpmc_push_n(&x, in, 3), 3);
+  ac_test_equ(ac_mpmc_push_n(&x, in + 9, 3), 1);
+  ac_test_expect(!ac_mpmc_push(&x, in + 12), "Pushed to a full ring.");
+  ac_test_equ(ac_mpmc_pop_n(&x, out, 2), 2);
+  ac_test_equ(ac_mpmc_push_n(&x, in + 12, 5), 2);
+  ac_test_equ(ac_mpmc_pop_n(&x, out + 6, 9), 4);
+  ac_test_expect(!memcmp(out, "abcdefghijklmnopqr", 18), "Got '%.18s'.",
+                 out);
+
+  // Many laps.
+  for (char i = 0; i < 100; ++i) {
+    char e[3] = {i, i, i};
+    ac_test_expect(ac_mpmc_push(&x, e), "Push %d failed.", i);
+    ac_test_expect(ac_mpmc_pop(&x, out), "Pop %d failed.", i);
+    ac_test_expect(!memcmp(e, out, 3), "Pop %d got %d.", i, out[0]);
+  }
+  ac_mpmc_destroy(&x);
+
+  // Too little storage.
+  ac_test_expect(
+      !ac_mpmc_init(&x, (ac_ring_opts){.elem_size = 16,
+                                       .storage = {storage, 20}}),
+      "Init succeeded.");
+}
+
+#if !defined(WASM)
+
+enum { AC_RING_TEST_COUNT = 200000, AC_RING_TEST_THREADS = 4 };
+
+static inline void* ac_ring_test_spsc_produce_(void* arg) {
+  ac_spsc* x = arg;
+  uint64_t batch[7];
+  for (uint64_t i = 0; i < AC_RING_TEST_COUNT;) {
+    // Alternate single pushes and batches.
+    if (i % 2) {
+      if (ac_spsc_push(x, &i)) {
+        ++i;
+      } else {
+        sched_yield();
+      }
+      continue;
+    }
+    size_t n = 0;
+    for (; n < 7 && i + n < AC_RING_TEST_COUNT; ++n) batch[n] = i + n;
+    const size_t pushed = ac_spsc_push_n(x, batch, n);
+    if (!pushed) sched_yield();
+    i += pushed;
+  }
+  return NULL;
+}
+
+static inline void spsc_threads_keep_order(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_spsc x;
+  ac_test_expect(ac_spsc_init(&x, (ac_ring_opts){.elem_size = 8, .cap = 64}),
+                 "Init failed.");
+  pthread_t producer;
+  pthread_create(&producer, NULL, &ac_ring_test_spsc_produce_, &x);
+
+  uint64_t next = 0, batch[5];
+  bool in_order = true;
+  while (next < AC_RING_TEST_COUNT) {
+    const size_t n = ac_spsc_pop_n(&x, batch, 5);
+    if (!n) sched_yield();
+    for (size_t i = 0; i < n; ++i) in_order &= batch[i] == next++;
+  }
+  pthread_join(producer, NULL);
+  ac_test_expect(in_order, "Elements arrived out of order.");
+  ac_test_expect(!ac_spsc_pop(&x, batch), "Ring wasn't empty.");
+
+  ac_spsc_destroy(&x);
+}
+
+typedef struct ac_ring_test_mpmc_worker {
+  pthread_t thread;
+  ac_mpmc* ring;
+  atomic_size_t* consumed;
+  uint64_t id;
+  uint64_t sum;
+  uint64_t count;
+} ac_ring_test_mpmc_worker;
+
+// Pushes this producer's share of the values 1 .. AC_RING_TEST_COUNT.
+static inline void* ac_ring_test_mpmc_produce_(void* arg) {
+  ac_ring_test_mpmc_worker* w = arg;
+  uint64_t batch[3];
+  size_t n = 0;
+  uint64_t v = w->id + 1;
+  while (v <= AC_RING_TEST_COUNT || n) {
+    for (; n < 3 && v <= AC_RING_TEST_COUNT; v += AC_RING_TEST_THREADS) {
+      batch[n++] = v;
+    }
+    const size_t pushed = ac_mpmc_push_n(w->ring, batch, n);
+    if (!pushed) sched_yield();
+    memmove(batch, batch + pushed, (n - pushed) * sizeof(*batch));
+    n -= pushed;
+  }
+  return NULL;
+}
+
+static inline void* ac_ring_test_mpmc_consume_(void* arg) {
+  ac_ring_test_mpmc_worker* w = arg;
+  uint64_t batch[4];
+  while (atomic_load(w->consumed) < AC_RING_TEST_COUNT) {
+    const size_t n = ac_mpmc_pop_n(w->ring, batch, w->id % 2 ? 4 : 1);
+    if (!n) sched_yield();
+    for (size_t i = 0; i < n; ++i) w->sum += batch[i];
+    w->count += n;
+    atomic_fetch_add(w->consumed, n);
+  }
+  return NULL;
+}
+
+static inline void mpmc_threads_lose_nothing(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_mpmc x;
+  ac_test_expect(ac_mpmc_init(&x, (ac_ring_opts){.elem_size = 8, .cap = 32}),
+                 "Init failed.");
+  atomic_size_t consumed = 0;
+  ac_ring_test_mpmc_worker producers[AC_RING_TEST_THREADS];
+  ac_ring_test_mpmc_worker consumers[AC_RING_TEST_THREADS];
+  for (int t = 0; t < AC_RING_TEST_THREADS; ++t) {
+    producers[t] = (ac_ring_test_mpmc_worker){.ring = &x, .id = t};
+    consumers[t] = (ac_ring_test_mpmc_worker){
+        .ring = &x, .consumed = &consumed, .id = t};
+    pthread_create(&producers[t].thread, NULL, &ac_ring_test_mpmc_produce_,
+                   &producers[t]);
+    pthread_create(&consumers[t].thread, NULL, &ac_ring_test_mpmc_consume_,
+                   &consumers[t]);
+  }
+
+  uint64_t sum = 0, count = 0;
+  for (int t = 0; t < AC_RING_TEST_THREADS; ++t) {
+    pthread_join(producers[t].thread, NULL);
+    pthread_join(consumers[t].thread, NULL);
+    sum += consumers[t].sum;
+    count += consumers[t].count;
+  }
+  ac_test_equ(count, AC_RING_TEST_COUNT);
+  const uint64_t expected =
+      (uint64_t)AC_RING_TEST_COUNT * (AC_RING_TEST_COUNT + 1) / 2;
+  ac_test_expect(sum == expected, "Sum is %" PRIu64 ", expected %" PRIu64 ".",
+                 sum, expected);
+
+  ac_mpmc_destroy(&x);
+}
+
+#endif  // !defined(WASM)
+
+static inline void ac_ring_test(ac_test_state* s) {
+  ac_test_begin(s);
+  ac_test_run(spsc_wraps_around);
+  ac_test_run(mpmc_single_thread);
+#if !defined(WASM)
+  ac_test_run(spsc_threads_keep_order);
+  ac_test_run(mpmc_threads_lose_nothing);
+#endif
+}
+
+#endif  // AC_RING_TEST_H_
@@ -0,0 +1,161 @@
+#ifndef AC_SOA_H_
+#define AC_SOA_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ac_alloc.h"
+#include "ac_mem.h"
+
+//------------------------------------------------------------------------------
+// Struct of Arrays.
+//------------------------------------------------------------------------------
+
+// Defines a list that stores each field in its own column, so passes that touch
+// one or two fields read only those. Fields are listed as '(type, field)'
+// pairs, up to 16 of them:
+//
+//   ac_soa_define_type(particles, (float, x), (float, y), (uint32_t, id));
+//
+// defines:
+//  - 'particles': the columns ('float* x', ...) with a shared 'len' and 'cap',
+//    and the allocator. Zero-initialize it to get an empty list using malloc.
+//  - 'particles_row': a struct with one value per field.
+//  - 'particles_free', 'particles_reserve', 'particles_push',
+//    'particles_get' and 'particles_swap_remove', described below.
+//
+// All columns live in one allocation, carved with an 'ac_slab', and each
+// starts on an AC_SOA_ALIGN boundary so kernels can use aligned vector loads.
+// The allocator must support 'alloc_aligned', as the mallocator and arenas do.
+#define ac_soa_define_type(name, ...)                                       \
+  typedef struct name {                                                     \
+    ac_allocator2 alloc;                                                    \
+    ac_mem mem; /* Holds every column. */                                   \
+    size_t len;                                                             \
+    size_t cap;                                                             \
+    ac_soa_each_(ac_soa_column_, __VA_ARGS__)                               \
+  } name;                                                                   \
+                                                                            \
+  typedef struct name##_row {                                               \
+    ac_soa_each_(ac_soa_row_field_, __VA_ARGS__)                            \
+  } name##_row;                                                             \
+                                                                            \
+  /* Free the columns and reset to an empty list, keeping the allocator. */ \
+  static inline void name##_free(name* x) {                                 \
+    ac_free2(x->alloc, x->mem);                                             \
+    *x = (name){.alloc = x->alloc};                                         \
+  }                                                                         \
+                                                                            \
+  /* Grow the columns to hold at least 'cap' rows. Returns false if */      \
+  /* allocation failed, and the list is untouched. */                       \
+  static inline bool name##_reserve(name* x, size_t cap) {                  \
+    if (cap <= x->cap) return true;                                         \
+    if (ac_allocator2_is_empty(x->alloc)) x->alloc = ac_mallocator2();      \
+                                                                            \
+    ac_slab slab = {};                                                      \
+    ac_soa_each_(ac_soa_column_block_, __VA_ARGS__)                         \
+    const ac_mem mem = ac_alloc2_aligned(x->alloc, AC_SOA_ALIGN,            \
+                                         ac_slab_size(&slab));              \
+    if (!mem.data) return false;                                            \
+                                                                            \
+    slab = (ac_slab){};                                                     \
+    ac_soa_each_(ac_soa_column_move_, __VA_ARGS__)                          \
+    ac_free2(x->alloc, x->mem);                                             \
+    x->mem = mem;                                                           \
+    x->cap = cap;                                                           \
+    return true;                                                            \
+  }                                                                         \
+                                                                            \
+  /* Append a row, doubling the capacity when full. Returns false if */     \
+  /* allocation failed. */                                                  \
+  static inline bool name##_push(name* x, name##_row row) {                 \
+    if (x->len == x->cap &&                                                 \
+        !name##_reserve(x, x->cap ? x->cap * 2 : AC_SOA_MIN_CAP)) {         \
+      return false;                                                         \
+    }                                                                       \
+    const size_t i = x->len++;                                              \
+    ac_soa_each_(ac_soa_column_put_, __VA_ARGS__)                           \
+    return true;                                                            \
+  }                                                                         \
+                                                                            \
+  /* Gather row 'i' from the columns. */                                    \
+  static inline name##_row name##_get(const name* x, size_t i) {            \
+    name##_row row;                                                         \
+    ac_soa_each_(ac_soa_column_get_, __VA_ARGS__)                           \
+    return row;                                                             \
+  }                                                                         \
+                                                                            \
+  /* Remove row 'i' by moving the last row into its place. */               \
+  static inline void name##_swap_remove(name* x, size_t i) {                \
+    const size_t last = --x->len;                                           \
+    ac_soa_each_(ac_soa_column_swap_, __VA_ARGS__)                          \
+  }                                                                         \
+  typedef name name
+
+// A column as an 'ac_span', for kernels over one field. The span type must be
+// defined, as it is for the basic types.
+#define ac_soa_span(element_type, soa_ptr, field) \
+  ((ac_span(element_type)){(soa_ptr)->field, (soa_ptr)->len})
+
+enum {
+  AC_SOA_ALIGN = 64,   // Column alignment, one cache line.
+  AC_SOA_MIN_CAP = 16  // Capacity of the first allocation.
+};
+
+//------------------------------------------------------------------------------
+// Implementation.
+//------------------------------------------------------------------------------
+
+// Per-field pieces of 'ac_soa_define_type'. Each gets a '(type, field)' pair
+// as its arguments, and the reserve steps share 'x', 'cap', 'slab' and 'mem'.
+#define ac_soa_column_(type, field) type* field;
+#define ac_soa_row_field_(type, field) type field;
+#define ac_soa_column_block_(type, field) \
+  ac_slab_alloc_aligned(&slab, AC_SOA_ALIGN, sizeof(type) * cap);
+#define ac_soa_column_move_(type, field)                                \
+  {                                                                     \
+    const ac_slab_block block =                                         \
+        ac_slab_alloc_aligned(&slab, AC_SOA_ALIGN, sizeof(type) * cap); \
+    type* column = (type*)((unsigned char*)mem.data + block.offset);    \
+    if (x->len) memcpy(column, x->field, sizeof(type) * x->len);        \
+    x->field = column;                                                  \
+  }
+#define ac_soa_column_put_(type, field) x->field[i] = row.field;
+#define ac_soa_column_get_(type, field) row.field = x->field[i];
+#define ac_soa_column_swap_(type, field) x->field[i] = x->field[last];
+
+// Applies 'm' to each '(type, field)' pair: 'm (type, field)' expands as a
+// call on rescan.
+#define ac_soa_each_(m, ...) \
+  ac_soa_cat_(ac_soa_each_, ac_soa_count_(__VA_ARGS__))(m, __VA_ARGS__)
+
+#define ac_soa_cat_(a, b) ac_soa_cat2_(a, b)
+#define ac_soa_cat2_(a, b) a##b
+
+#define ac_soa_count_(...)                                                  \
+  ac_soa_count2_(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, \
+                 3, 2, 1, )
+#define ac_soa_count2_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, \
+                       _13, _14, _15, _16, n, ...)                        \
+  n
+
+#define ac_soa_each_1(m, a) m a
+#define ac_soa_each_2(m, a, ...) m a ac_soa_each_1(m, __VA_ARGS__)
+#define ac_soa_each_3(m, a, ...) m a ac_soa_each_2(m, __VA_ARGS__)
+#define ac_soa_each_4(m, a, ...) m a ac_soa_each_3(m, __VA_ARGS__)
+#define ac_soa_each_5(m, a, ...) m a ac_soa_each_4(m, __VA_ARGS__)
+#define ac_soa_each_6(m, a, ...) m a ac_soa_each_5(m, __VA_ARGS__)
+#define ac_soa_each_7(m, a, ...) m a ac_soa_each_6(m, __VA_ARGS__)
+#define ac_soa_each_8(m, a, ...) m a ac_soa_each_7(m, __VA_ARGS__)
+#define ac_soa_each_9(m, a, ...) m a ac_soa_each_8(m, __VA_ARGS__)
+#define ac_soa_each_10(m, a, ...) m a ac_soa_each_9(m, __VA_ARGS__)
+#define ac_soa_each_11(m, a, ...) m a ac_soa_each_10(m, __VA_ARGS__)
+#define ac_soa_each_12(m, a, ...) m a ac_soa_each_11(m, __VA_ARGS__)
+#define ac_soa_each_13(m, a, ...) m a ac_soa_each_12(m, __VA_ARGS__)
+#define ac_soa_each_14(m, a, ...) m a ac_soa_each_13(m, __VA_ARGS__)
+#define ac_soa_each_15(m, a, ...) m a ac_soa_each_14(m, __VA_ARGS__)
+#define ac_soa_each_16(m, a, ...) m a ac_soa_each_15(m, __VA_ARGS__)
+
+#endif  // AC_SOA_H_
@@ -0,0 +1,120 @@
+#ifndef AC_SOA_TEST_H_
+#define AC_SOA_TEST_H_
+
+#include <stdint.h>
+
+#include "ac_soa.h"
+#include "ac_test.h"
+
+#define AC_MEM_IMPL
+#include "ac_mem.h"
+
+//------------------------------------------------------------------------------
+// Struct of Arrays
+//------------------------------------------------------------------------------
+
+ac_soa_define_type(ac_soa_test_particles, (float, x), (float, y),
+                   (uint8_t, flags), (double, mass));
+
+// Single field, and the most fields.
+ac_soa_define_type(ac_soa_test_ids, (uint32_t, id));
+ac_soa_define_type(ac_soa_test_wide, (char, f0), (char, f1), (char, f2),
+                   (char, f3), (char, f4), (char, f5), (char, f6), (char, f7),
+                   (char, f8), (char, f9), (char, f10), (char, f11),
+                   (char, f12), (char, f13), (char, f14), (char, f15));
+
+static inline void soa_push_get_remove(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_soa_test_particles x = {};
+  for (size_t i = 0; i < 100; ++i) {
+    const ac_soa_test_particles_row row = {
+        .x = i, .y = -(float)i, .flags = i % 3, .mass = i * 0.5};
+    ac_test_expect(ac_soa_test_particles_push(&x, row), "Push failed.");
+  }
+  ac_test_equ(x.len, 100);
+  ac_test_expect(x.cap >= 100, "Cap %zu.", x.cap);
+
+  size_t bad = 0;
+  for (size_t i = 0; i < x.len; ++i) {
+    const ac_soa_test_particles_row row = ac_soa_test_particles_get(&x, i);
+    bad += row.x != i || row.y != -(float)i || row.flags != i % 3 ||
+           row.mass != i * 0.5;
+  }
+  ac_test_equ(bad, 0);
+
+  // The last row takes the place of the removed one.
+  ac_soa_test_particles_swap_remove(&x, 10);
+  ac_test_equ(x.len, 99);
+  ac_test_expect(x.x[10] == 99 && x.y[10] == -99 && x.flags[10] == 0 &&
+                     x.mass[10] == 49.5,
+                 "Wrong row.");
+  ac_soa_test_particles_swap_remove(&x, 98);
+  ac_test_equ(x.len, 98);
+  ac_test_expect(x.x[97] == 97, "Wrong row.");
+
+  ac_soa_test_particles_free(&x);
+  ac_test_equ(x.len, 0);
+  ac_test_equ(x.cap, 0);
+  ac_soa_test_particles_free(&x);
+
+  ac_soa_test_ids ids = {};
+  ac_soa_test_wide wide = {};
+  ac_test_expect(ac_soa_test_ids_push(&ids, (ac_soa_test_ids_row){7}) &&
+                     ac_soa_test_wide_push(&wide,
+                                            (ac_soa_test_wide_row){.f15 = 'z'}),
+                 "Push failed.");
+  ac_test_expect(ids.id[0] == 7 && wide.f15[0] == 'z' && !wide.f0[0],
+                 "Wrong row.");
+  ac_soa_test_ids_free(&ids);
+  ac_soa_test_wide_free(&wide);
+}
+
+static inline void soa_columns_are_aligned(ac_test_state* s) {
+  ac_test_begin(s);
+
+  // From an arena, with an odd reservation so column sizes aren't multiples
+  // of the alignment.
+  ac_arena arena = ac_arena_create((ac_arena_opts){});
+  ac_soa_test_particles x = {.alloc = ac_arena_allocator2(&arena)};
+  ac_test_expect(ac_soa_test_particles_reserve(&x, 37), "Reserve failed.");
+  ac_test_equ(x.cap, 37);
+  ac_test_expect(ac_soa_test_particles_reserve(&x, 5), "Reserve failed.");
+  ac_test_equ(x.cap, 37);
+
+  for (size_t i = 0; i < 1000; ++i) {
+    ac_soa_test_particles_push(&x, (ac_soa_test_particles_row){.x = 1});
+  }
+  const uintptr_t columns = (uintptr_t)x.x | (uintptr_t)x.y |
+                            (uintptr_t)x.flags | (uintptr_t)x.mass;
+  ac_test_equ(columns % AC_SOA_ALIGN, 0);
+  ac_test_expect((unsigned char*)x.mass + x.cap * sizeof(double) <=
+                     (unsigned char*)x.mem.data + x.mem.cap,
+                 "Column past the allocation.");
+
+  const ac_span(float) xs = ac_soa_span(float, &x, x);
+  ac_test_equ(xs.len, 1000);
+  float sum = 0;
+  for (size_t i = 0; i < xs.len; ++i) sum += xs.data[i];
+  ac_test_expect(sum == 1000, "Sum %f.", sum);
+
+  ac_soa_test_particles_free(&x);
+  ac_arena_destroy(&arena);
+
+  // Allocators without aligned allocations fail.
+  ac_allocator2 plain = ac_mallocator2();
+  plain.alloc_aligned = NULL;
+  x = (ac_soa_test_particles){.alloc = plain};
+  ac_test_expect(!ac_soa_test_particles_push(&x,
+                                             (ac_soa_test_particles_row){}),
+                 "Push succeeded.");
+  ac_test_equ(x.len, 0);
+}
+
+static inline void ac_soa_test(ac_test_state* s) {
+  ac_test_begin(s);
+  ac_test_run(soa_push_get_remove);
+  ac_test_run(soa_columns_are_aligned);
+}
+
+#endif  // AC_SOA_TEST_H_
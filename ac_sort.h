@@ -0,0 +1,383 @@
+#ifndef AC_SORT_H_
+#define AC_SORT_H_
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ac_alloc.h"
+#include "ac_mem.h"
+#include "ac_thread.h"
+
+//------------------------------------------------------------------------------
+// Radix Sort.
+//------------------------------------------------------------------------------
+
+// Least-significant-digit radix sort of the predefined number types, with
+// 8-bit digits. Sorting never calls a comparator, so it is several times faster
+// than qsort on large arrays.
+//  - One pass over the keys counts all digits. Passes over digits that are the
+//    same in every key (e.g. the high bytes of small numbers) are skipped.
+//  - Signed integers and floats are mapped to unsigned keys whose order matches
+//    theirs, and back after sorting. Floats sort as -NaN < -inf < ... < -0 <
+//    +0 < ... < +inf < +NaN.
+//  - Sorting is stable, so a key-value sort orders equal keys by position.
+//    Values are 'uint32_t', e.g. row ids.
+//  - Scratch space for a copy of the keys (and values) comes from an
+//    'ac_allocator2', e.g. an arena's. Defaults to malloc.
+//  - The parallel version splits every pass into one chunk per thread.
+//
+//   ac_radix_sort(float, &list, (ac_allocator2){});  // Any list or span.
+//   ac_radix_sort_kv_uint64_t(keys, row_ids, len, ac_arena_allocator2(&a));
+//   ac_radix_sort_par_int32_t(&pool, keys, NULL, len, (ac_allocator2){});
+
+// Sorts a list or span of 'element_type'.
+#define ac_radix_sort(element_type, list_ptr, scratch) \
+  ac_radix_sort_##element_type((list_ptr)->data, (list_ptr)->len, scratch)
+
+// Sorts a list or span of keys of 'element_type', and 'values' alongside.
+#define ac_radix_sort_kv(element_type, list_ptr, values, scratch)            \
+  ac_radix_sort_kv_##element_type((list_ptr)->data, values, (list_ptr)->len, \
+                                  scratch)
+
+// For each predefined type T, these return false if allocation failed, leaving
+// the data as it was:
+//   bool ac_radix_sort_T(T* data, size_t len, ac_allocator2 scratch);
+//   bool ac_radix_sort_kv_T(T* keys, uint32_t* values, size_t len,
+//                           ac_allocator2 scratch);
+//   bool ac_radix_sort_par_T(ac_thread_pool*, T* keys, uint32_t* values,
+//                            size_t len, ac_allocator2 scratch);
+// 'values' may be NULL in the parallel version.
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// Arrays below this length are insertion sorted.
+enum { AC_RADIX_SMALL = 48 };
+
+// The parallel version sorts arrays below this length on one thread.
+enum { AC_RADIX_PAR_MIN = 1 << 16 };
+
+// Keys may be floats or signed integers, accessed as unsigned integers.
+typedef uint8_t __attribute__((__may_alias__)) ac_radix_u8_;
+typedef uint16_t __attribute__((__may_alias__)) ac_radix_u16_;
+typedef uint32_t __attribute__((__may_alias__)) ac_radix_u32_;
+typedef uint64_t __attribute__((__may_alias__)) ac_radix_u64_;
+
+// Scratch space: 'hist_size' bytes of histograms (and chunk tasks for the
+// parallel sort), then a copy of the keys, then of the values.
+typedef struct ac_radix_scratch_ {
+  ac_mem mem;
+  size_t (*hist)[256];
+  void* keys;
+  uint32_t* values;
+} ac_radix_scratch_;
+
+static inline bool ac_radix_scratch_alloc_(ac_radix_scratch_* x,
+                                           ac_allocator2* alloc, size_t len,
+                                           size_t key_size, bool values,
+                                           size_t hist_size) {
+  if (ac_allocator2_is_empty(*alloc)) *alloc = ac_mallocator2();
+  const size_t keys_size = ac_align_up(len * key_size, sizeof(uint32_t));
+  const size_t values_size = values ? len * sizeof(uint32_t) : 0;
+  x->mem = ac_alloc2(*alloc, hist_size + keys_size + values_size);
+  if (!x->mem.data) return false;
+  x->hist = x->mem.data;
+  x->keys = (char*)x->mem.data + hist_size;
+  x->values = values ? (uint32_t*)((char*)x->keys + keys_size) : NULL;
+  return true;
+}
+
+// State of one pass of the parallel sort.
+typedef struct ac_radix_par_ {
+  const void* src;
+  void* dst;
+  const uint32_t* src_values;
+  uint32_t* dst_values;
+  size_t shift;
+  size_t len;
+  size_t grain;         // Keys per chunk.
+  size_t (*hist)[256];  // Per chunk: counts, then offsets.
+} ac_radix_par_;
+
+// A pass over one chunk. The histogram and scatter passes must see the same
+// chunks, so each gets its own task rather than 'ac_parallel_for_n' ranges.
+typedef struct ac_radix_par_chunk_ {
+  ac_task task;
+  const ac_radix_par_* p;
+  void (*fn)(void* ctx, size_t begin, size_t end);
+  size_t chunk;
+} ac_radix_par_chunk_;
+
+static inline void ac_radix_par_chunk_run_(void* ctx) {
+  const ac_radix_par_chunk_* c = ctx;
+  const size_t begin = c->chunk * c->p->grain;
+  const size_t end = ac_min(begin + c->p->grain, c->p->len);
+  c->fn((void*)c->p, begin, end);
+}
+
+// Runs 'fn' on each of the 'chunks' chunks, spawning all but the first in
+// 'pool', with 'tasks' holding one task per chunk.
+static inline void ac_radix_par_run_(
+    ac_thread_pool* pool, const ac_radix_par_* p, ac_radix_par_chunk_* tasks,
+    size_t chunks, void (*fn)(void* ctx, size_t begin, size_t end)) {
+  ac_task_group group = ac_task_group_init(pool);
+  for (size_t c = 0; c < chunks; ++c) {
+    tasks[c] = (ac_radix_par_chunk_){
+        .task = {.fn = &ac_radix_par_chunk_run_, .ctx = &tasks[c]},
+        .p = p,
+        .fn = fn,
+        .chunk = c,
+    };
+    if (c) ac_task_group_spawn(&group, &tasks[c].task);
+  }
+  ac_radix_par_chunk_run_(&tasks[0]);
+  ac_task_group_wait(&group);
+}
+
+// Turns per-chunk digit counts into per-chunk offsets: all keys with a lower
+// digit come first, then those with the same digit in earlier chunks.
+static inline void ac_radix_par_offsets_(size_t (*hist)[256], size_t chunks) {
+  size_t sum = 0;
+  for (size_t b = 0; b < 256; ++b) {
+    for (size_t c = 0; c < chunks; ++c) {
+      const size_t count = hist[c][b];
+      hist[c][b] = sum;
+      sum += count;
+    }
+  }
+}
+
+// Defines the sorts of unsigned keys of W bits.
+#define ac_radix_define_width_(W)                                             \
+  static inline void ac_radix_insertion_u##W##_(                              \
+      ac_radix_u##W##_* keys, uint32_t* values, size_t len) {                 \
+    for (size_t i = 1; i < len; ++i) {                                        \
+      const uint##W##_t key = keys[i];                                        \
+      const uint32_t value = values ? values[i] : 0;                          \
+      size_t j = i;                                                           \
+      for (; j && keys[j - 1] > key; --j) {                                   \
+        keys[j] = keys[j - 1];                                                \
+        if (values) values[j] = values[j - 1];                                \
+      }                                                                       \
+      keys[j] = key;                                                          \
+      if (values) values[j] = value;                                          \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  /* Sorts using 'tmp' and 'tmp_values' (if 'values') of 'len' elements. */   \
+  static inline void ac_radix_sort_u##W##_(                                   \
+      ac_radix_u##W##_* keys, uint32_t* values, size_t len,                   \
+      ac_radix_u##W##_* tmp, uint32_t* tmp_values) {                          \
+    enum { DIGITS = W / 8 };                                                  \
+    size_t hist[DIGITS][256] = {};                                            \
+    for (size_t i = 0; i < len; ++i) {                                        \
+      const uint##W##_t key = keys[i];                                        \
+      for (size_t d = 0; d < DIGITS; ++d) ++hist[d][(key >> (8 * d)) & 0xFF]; \
+    }                                                                         \
+                                                                              \
+    ac_radix_u##W##_ *src = keys, *dst = tmp;                                 \
+    uint32_t *src_values = values, *dst_values = tmp_values;                  \
+    for (size_t d = 0; d < DIGITS; ++d) {                                     \
+      const size_t shift = 8 * d;                                             \
+      size_t* offsets = hist[d];                                              \
+      if (offsets[(src[0] >> shift) & 0xFF] == len) continue;                 \
+      for (size_t b = 0, sum = 0; b < 256; ++b) {                             \
+        const size_t count = offsets[b];                                      \
+        offsets[b] = sum;                                                     \
+        sum += count;                                                         \
+      }                                                                       \
+      for (size_t i = 0; i < len; ++i) {                                      \
+        const size_t pos = offsets[(src[i] >> shift) & 0xFF]++;               \
+        dst[pos] = src[i];                                                    \
+        if (values) dst_values[pos] = src_values[i];                          \
+      }                                                                       \
+      ac_radix_u##W##_* t = src;                                              \
+      src = dst;                                                              \
+      dst = t;                                                                \
+      uint32_t* tv = src_values;                                              \
+      src_values = dst_values;                                                \
+      dst_values = tv;                                                        \
+    }                                                                         \
+    if (src != keys) {                                                        \
+      memcpy(keys, src, len * sizeof(*keys));                                 \
+      if (values) memcpy(values, src_values, len * sizeof(*values));          \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  static inline void ac_radix_par_hist_u##W##_(void* ctx, size_t begin,       \
+                                               size_t end) {                  \
+    const ac_radix_par_* p = ctx;                                             \
+    const ac_radix_u##W##_* src = p->src;                                     \
+    size_t* hist = p->hist[begin / p->grain];                                 \
+    for (size_t i = begin; i < end; ++i) ++hist[(src[i] >> p->shift) & 0xFF]; \
+  }                                                                           \
+                                                                              \
+  static inline void ac_radix_par_scatter_u##W##_(void* ctx, size_t begin,    \
+                                                  size_t end) {               \
+    const ac_radix_par_* p = ctx;                                             \
+    const ac_radix_u##W##_* src = p->src;                                     \
+    ac_radix_u##W##_* dst = p->dst;                                           \
+    size_t* offsets = p->hist[begin / p->grain];                              \
+    for (size_t i = begin; i < end; ++i) {                                    \
+      const size_t pos = offsets[(src[i] >> p->shift) & 0xFF]++;              \
+      dst[pos] = src[i];                                                      \
+      if (p->src_values) p->dst_values[pos] = p->src_values[i];               \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  /* Like 'ac_radix_sort_u<W>_', also using 'hist' and 'tasks' for up to */   \
+  /* 'max_chunks' chunks. */                                                  \
+  static inline void ac_radix_par_sort_u##W##_(                               \
+      ac_thread_pool* pool, ac_radix_u##W##_* keys, uint32_t* values,         \
+      size_t len, ac_radix_u##W##_* tmp, uint32_t* tmp_values,                \
+      size_t(*hist)[256], ac_radix_par_chunk_* tasks, size_t max_chunks) {    \
+    ac_radix_par_ p = {                                                       \
+        .src = keys,                                                          \
+        .dst = tmp,                                                           \
+        .src_values = values,                                                 \
+        .dst_values = values ? tmp_values : NULL,                             \
+        .len = len,                                                           \
+        .grain = (len + max_chunks - 1) / max_chunks,                         \
+        .hist = hist,                                                         \
+    };                                                                        \
+    /* Rounding the grain up can leave fewer chunks than asked for. */        \
+    const size_t chunks = (len + p.grain - 1) / p.grain;                      \
+    for (size_t d = 0; d < W / 8; ++d) {                                      \
+      p.shift = 8 * d;                                                        \
+      memset(hist, 0, chunks * sizeof(*hist));                                \
+      ac_radix_par_run_(pool, &p, tasks, chunks, &ac_radix_par_hist_u##W##_); \
+      const ac_radix_u##W##_ key = ((const ac_radix_u##W##_*)p.src)[0];       \
+      const size_t first = (key >> p.shift) & 0xFF;                           \
+      size_t same = 0;                                                        \
+      for (size_t c = 0; c < chunks; ++c) same += hist[c][first];             \
+      if (same == len) continue;                                              \
+                                                                              \
+      ac_radix_par_offsets_(hist, chunks);                                    \
+      ac_radix_par_run_(pool, &p, tasks, chunks,                              \
+                        &ac_radix_par_scatter_u##W##_);                       \
+      const void* t = p.src;                                                  \
+      p.src = p.dst;                                                          \
+      p.dst = (void*)t;                                                       \
+      const uint32_t* tv = p.src_values;                                      \
+      p.src_values = p.dst_values;                                            \
+      p.dst_values = (uint32_t*)tv;                                           \
+    }                                                                         \
+    if (p.src != keys) {                                                      \
+      memcpy(keys, p.src, len * sizeof(*keys));                               \
+      if (values) memcpy(values, p.src_values, len * sizeof(*values));        \
+    }                                                                         \
+  }
+
+ac_radix_define_width_(8);
+ac_radix_define_width_(16);
+ac_radix_define_width_(32);
+ac_radix_define_width_(64);
+
+#undef ac_radix_define_width_
+
+// Maps keys to unsigned keys of the same order, and back.
+#define ac_radix_unsigned_enc_(x) (x)
+#define ac_radix_unsigned_dec_(x) (x)
+#define ac_radix_sign_(x) ((__typeof__(x))1 << (sizeof(x) * 8 - 1))
+#define ac_radix_signed_enc_(x) ((x) ^ ac_radix_sign_(x))
+#define ac_radix_signed_dec_(x) ((x) ^ ac_radix_sign_(x))
+// Negative floats have all bits flipped, positive ones only the sign bit.
+#define ac_radix_float_enc_(x) \
+  ((x) ^ (-((x) >> (sizeof(x) * 8 - 1)) | ac_radix_sign_(x)))
+#define ac_radix_float_dec_(x) \
+  ((x) ^ ((((x) >> (sizeof(x) * 8 - 1)) - 1) | ac_radix_sign_(x)))
+
+// Defines the sorts of 'T', sorted as unsigned keys of W bits after mapping
+// with 'ac_radix_<kind>_enc_'.
+#define ac_radix_define_type_(T, W, kind)                                      \
+  static inline void ac_radix_encode_##T##_(ac_radix_u##W##_* keys,            \
+                                            size_t len) {                      \
+    for (size_t i = 0; i < len; ++i) {                                         \
+      keys[i] = ac_radix_##kind##_enc_((uint##W##_t)keys[i]);                  \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  static inline void ac_radix_decode_##T##_(ac_radix_u##W##_* keys,            \
+                                            size_t len) {                      \
+    for (size_t i = 0; i < len; ++i) {                                         \
+      keys[i] = ac_radix_##kind##_dec_((uint##W##_t)keys[i]);                  \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  static inline bool ac_radix_sort_kv_##T(T* data, uint32_t* values,           \
+                                          size_t len, ac_allocator2 scratch) { \
+    ac_radix_u##W##_* keys = (ac_radix_u##W##_*)data;                          \
+    if (len < AC_RADIX_SMALL) {                                                \
+      ac_radix_encode_##T##_(keys, len);                                       \
+      ac_radix_insertion_u##W##_(keys, values, len);                           \
+      ac_radix_decode_##T##_(keys, len);                                       \
+      return true;                                                             \
+    }                                                                          \
+    ac_radix_scratch_ tmp;                                                     \
+    if (!ac_radix_scratch_alloc_(&tmp, &scratch, len, W / 8, values, 0)) {     \
+      return false;                                                            \
+    }                                                                          \
+    ac_radix_encode_##T##_(keys, len);                                         \
+    ac_radix_sort_u##W##_(keys, values, len, tmp.keys, tmp.values);            \
+    ac_radix_decode_##T##_(keys, len);                                         \
+    ac_free2(scratch, tmp.mem);                                                \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  static inline bool ac_radix_sort_##T(T* data, size_t len,                    \
+                                       ac_allocator2 scratch) {                \
+    return ac_radix_sort_kv_##T(data, NULL, len, scratch);                     \
+  }                                                                            \
+                                                                               \
+  static inline bool ac_radix_sort_par_##T(ac_thread_pool* pool, T* data,      \
+                                           uint32_t* values, size_t len,       \
+                                           ac_allocator2 scratch) {            \
+    if (!pool || len < AC_RADIX_PAR_MIN) {                                     \
+      return ac_radix_sort_kv_##T(data, values, len, scratch);                 \
+    }                                                                          \
+    const size_t chunks = pool->count + 1;                                     \
+    const size_t hist_size =                                                   \
+        chunks * (256 * sizeof(size_t) + sizeof(ac_radix_par_chunk_));         \
+    ac_radix_scratch_ tmp;                                                     \
+    if (!ac_radix_scratch_alloc_(&tmp, &scratch, len, W / 8, values,           \
+                                 hist_size)) {                                 \
+      return false;                                                            \
+    }                                                                          \
+    ac_radix_u##W##_* keys = (ac_radix_u##W##_*)data;                          \
+    ac_radix_par_chunk_* tasks = (ac_radix_par_chunk_*)&tmp.hist[chunks];      \
+    ac_radix_encode_##T##_(keys, len);                                         \
+    ac_radix_par_sort_u##W##_(pool, keys, values, len, tmp.keys, tmp.values,   \
+                              tmp.hist, tasks, chunks);                        \
+    ac_radix_decode_##T##_(keys, len);                                         \
+    ac_free2(scratch, tmp.mem);                                                \
+    return true;                                                               \
+  }
+
+ac_radix_define_type_(uint8_t, 8, unsigned);
+ac_radix_define_type_(uint16_t, 16, unsigned);
+ac_radix_define_type_(uint32_t, 32, unsigned);
+ac_radix_define_type_(uint64_t, 64, unsigned);
+ac_radix_define_type_(int8_t, 8, signed);
+ac_radix_define_type_(int16_t, 16, signed);
+ac_radix_define_type_(int32_t, 32, signed);
+ac_radix_define_type_(int64_t, 64, signed);
+ac_radix_define_type_(float, 32, float);
+ac_radix_define_type_(double, 64, float);
+#if CHAR_MIN < 0
+ac_radix_define_type_(char, 8, signed);
+#else
+ac_radix_define_type_(char, 8, unsigned);
+#endif
+#if SIZE_MAX == UINT64_MAX
+ac_radix_define_type_(size_t, 64, unsigned);
+#else
+ac_radix_define_type_(size_t, 32, unsigned);
+#endif
+
+#undef ac_radix_define_type_
+
+#endif  // AC_SORT_H_
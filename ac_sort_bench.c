@@ -0,0 +1,89 @@
+// Compares 'ac_radix_sort' and its parallel version with qsort, on random keys
+// of a few types and lengths. Only meaningful in optimized builds:
+//
+//   make OPT=1 ac_sort_bench && build/ac_sort_bench
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ac_sort.h"
+
+#define AC_TIME_IMPL
+#include "ac_time.h"
+
+enum { AC_SORT_BENCH_MAX_LEN = 1 << 24 };
+
+static inline double ac_sort_bench_ns_(ac_cputime t0) {
+  const ac_dcputime dt = ac_cputime_diff(ac_cputime_now(), t0);
+  return 1e9 * dt.cpu_dticks / ac_cputime_freq();
+}
+
+static inline uint64_t ac_sort_bench_rand_(uint64_t* state) {
+  *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+  return *state ^ (*state >> 29);
+}
+
+// Defines, for each key type, a comparator for qsort and a function printing
+// nanoseconds per key of qsort, the radix sort and the parallel radix sort.
+// 'key(r)' makes a key from random bits 'r'.
+#define AC_SORT_BENCH_DEFINE(T, key)                                         \
+  static inline int ac_sort_bench_cmp_##T(const void* a, const void* b) {    \
+    const T x = *(const T*)a, y = *(const T*)b;                              \
+    return (x > y) - (x < y);                                                \
+  }                                                                          \
+                                                                             \
+  static inline void ac_sort_bench_##T(ac_thread_pool* pool, size_t len,     \
+                                       T* keys, T* input) {                  \
+    uint64_t rng = len;                                                      \
+    for (size_t i = 0; i < len; ++i) {                                       \
+      input[i] = key(ac_sort_bench_rand_(&rng));                             \
+    }                                                                        \
+                                                                             \
+    memcpy(keys, input, len * sizeof(T));                                    \
+    ac_cputime t0 = ac_cputime_now();                                        \
+    qsort(keys, len, sizeof(T), &ac_sort_bench_cmp_##T);                     \
+    const double qsort_ns = ac_sort_bench_ns_(t0);                           \
+                                                                             \
+    memcpy(keys, input, len * sizeof(T));                                    \
+    t0 = ac_cputime_now();                                                   \
+    const bool radix_ok = ac_radix_sort_##T(keys, len, (ac_allocator2){});   \
+    const double radix_ns = ac_sort_bench_ns_(t0);                           \
+                                                                             \
+    memcpy(keys, input, len * sizeof(T));                                    \
+    t0 = ac_cputime_now();                                                   \
+    const bool par_ok =                                                      \
+        ac_radix_sort_par_##T(pool, keys, NULL, len, (ac_allocator2){});     \
+    const double par_ns = ac_sort_bench_ns_(t0);                             \
+                                                                             \
+    bool sorted = radix_ok && par_ok;                                        \
+    for (size_t i = 1; i < len; ++i) sorted &= !(keys[i] < keys[i - 1]);     \
+    printf("%-10s %-10zu %10.2f %10.2f %10.2f%s\n", #T, len, qsort_ns / len, \
+           radix_ns / len, par_ns / len, sorted ? "" : "  NOT SORTED");      \
+  }
+
+#define AC_SORT_BENCH_U32(r) ((uint32_t)(r))
+#define AC_SORT_BENCH_U64(r) (r)
+#define AC_SORT_BENCH_FLOAT(r) ((float)(int64_t)(r) * 0x1p-40f)  // No NaNs.
+
+AC_SORT_BENCH_DEFINE(uint32_t, AC_SORT_BENCH_U32)
+AC_SORT_BENCH_DEFINE(uint64_t, AC_SORT_BENCH_U64)
+AC_SORT_BENCH_DEFINE(float, AC_SORT_BENCH_FLOAT)
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  ac_thread_pool pool;
+  if (!ac_thread_pool_init(&pool, (ac_thread_pool_opts){})) return 1;
+
+  static uint64_t keys[AC_SORT_BENCH_MAX_LEN], input[AC_SORT_BENCH_MAX_LEN];
+  printf("%-10s %-10s %10s %10s %10s  (ns/key, %zu workers)\n", "type", "len",
+         "qsort", "radix", "parallel", pool.count);
+  for (size_t len = 1 << 10; len <= AC_SORT_BENCH_MAX_LEN; len <<= 7) {
+    ac_sort_bench_uint32_t(&pool, len, (uint32_t*)keys, (uint32_t*)input);
+    ac_sort_bench_uint64_t(&pool, len, keys, input);
+    ac_sort_bench_float(&pool, len, (float*)keys, (float*)input);
+  }
+  ac_thread_pool_destroy(&pool);
+  return 0;
+}
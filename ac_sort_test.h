@@ -0,0 +1,230 @@
+#ifndef AC_SORT_TEST_H_
+#define AC_SORT_TEST_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "ac_sort.h"
+#include "ac_test.h"
+
+#define AC_MEM_IMPL
+#include "ac_mem.h"
+
+//------------------------------------------------------------------------------
+// Radix Sort
+//------------------------------------------------------------------------------
+
+static inline uint64_t ac_sort_test_rand_(uint64_t* state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+// Fills 'data' with random bytes, then sorts it and checks the order, for
+// each listed length.
+#define ac_sort_test_check_(s, T, data, lens, less)                   \
+  do {                                                                \
+    uint64_t rng = 1;                                                 \
+    for (size_t l = 0; l < sizeof(lens) / sizeof(*lens); ++l) {       \
+      const size_t len = lens[l];                                     \
+      for (size_t i = 0; i < len; ++i) {                              \
+        const uint64_t r = ac_sort_test_rand_(&rng);                  \
+        memcpy(&data[i], &r, sizeof(T));                              \
+      }                                                               \
+      ac_test_expect(ac_radix_sort_##T(data, len, (ac_allocator2){}), \
+                     "Sort failed.");                                 \
+      size_t unordered = 0;                                           \
+      for (size_t i = 1; i < len; ++i) {                              \
+        unordered += less(data[i], data[i - 1]);                      \
+      }                                                               \
+      ac_test_expect(!unordered, #T " len %zu: %zu unordered.", len,  \
+                     unordered);                                      \
+    }                                                                 \
+  } while (false)
+
+#define ac_sort_test_less_(a, b) ((a) < (b))
+
+static inline void radix_sort_types(ac_test_state* s) {
+  ac_test_begin(s);
+
+  static union {
+    uint8_t u8[20000];
+    uint16_t u16[20000];
+    uint32_t u32[20000];
+    uint64_t u64[20000];
+    int8_t i8[20000];
+    int16_t i16[20000];
+    int32_t i32[20000];
+    int64_t i64[20000];
+    char c[20000];
+    size_t z[20000];
+  } data;
+  const size_t lens[] = {0, 1, 2, 47, 48, 1000, 20000};
+  ac_sort_test_check_(s, uint8_t, data.u8, lens, ac_sort_test_less_);
+  ac_sort_test_check_(s, uint16_t, data.u16, lens, ac_sort_test_less_);
+  ac_sort_test_check_(s, uint32_t, data.u32, lens, ac_sort_test_less_);
+  ac_sort_test_check_(s, uint64_t, data.u64, lens, ac_sort_test_less_);
+  ac_sort_test_check_(s, int8_t, data.i8, lens, ac_sort_test_less_);
+  ac_sort_test_check_(s, int16_t, data.i16, lens, ac_sort_test_less_);
+  ac_sort_test_check_(s, int32_t, data.i32, lens, ac_sort_test_less_);
+  ac_sort_test_check_(s, int64_t, data.i64, lens, ac_sort_test_less_);
+  ac_sort_test_check_(s, char, data.c, lens, ac_sort_test_less_);
+  ac_sort_test_check_(s, size_t, data.z, lens, ac_sort_test_less_);
+
+  // Small numbers skip the passes over their high bytes.
+  uint64_t rng = 2;
+  for (size_t i = 0; i < 1000; ++i) {
+    data.u64[i] = ac_sort_test_rand_(&rng) % 300;
+  }
+  ac_test_expect(ac_radix_sort_uint64_t(data.u64, 1000, (ac_allocator2){}),
+                 "Sort failed.");
+  size_t unordered = 0;
+  for (size_t i = 1; i < 1000; ++i) unordered += data.u64[i] < data.u64[i - 1];
+  ac_test_equ(unordered, 0);
+}
+
+static inline void radix_sort_floats(ac_test_state* s) {
+  ac_test_begin(s);
+
+  static float f[5000];
+  static double d[5000];
+  uint64_t rng = 3;
+  for (size_t i = 0; i < 5000; ++i) {
+    const double r = (double)(int64_t)ac_sort_test_rand_(&rng);
+    f[i] = i % 7 ? (float)(r * 1e-15) : (float)(i % 3) - 1.0f;
+    d[i] = i % 5 ? r * 1e-300 : r;
+  }
+  f[10] = -0.0f;
+  f[11] = INFINITY;
+  f[12] = -INFINITY;
+  d[10] = -0.0;
+  d[11] = -INFINITY;
+  d[12] = 5e-324;  // Subnormal.
+
+  ac_span(float) span = {f, 5000};
+  ac_test_expect(ac_radix_sort(float, &span, (ac_allocator2){}),
+                 "Sort failed.");
+  ac_test_expect(ac_radix_sort_double(d, 5000, (ac_allocator2){}),
+                 "Sort failed.");
+  size_t unordered = 0;
+  for (size_t i = 1; i < 5000; ++i) {
+    unordered += f[i] < f[i - 1] || d[i] < d[i - 1];
+  }
+  ac_test_equ(unordered, 0);
+  ac_test_expect(f[0] == -INFINITY && f[4999] == INFINITY, "Infinities.");
+  ac_test_expect(d[0] == -INFINITY, "Infinities.");
+
+  // Negative zero comes before zero, NaNs at the ends by sign.
+  float z[] = {0.0f, NAN, -0.0f, -NAN, 1.0f};
+  ac_test_expect(ac_radix_sort_float(z, 5, (ac_allocator2){}), "Sort failed.");
+  ac_test_expect(isnan(z[0]) && signbit(z[0]), "Got %f.", z[0]);
+  ac_test_expect(z[1] == 0.0f && signbit(z[1]), "Got %f.", z[1]);
+  ac_test_expect(z[2] == 0.0f && !signbit(z[2]), "Got %f.", z[2]);
+  ac_test_expect(isnan(z[4]) && !signbit(z[4]), "Got %f.", z[4]);
+}
+
+static inline void radix_sort_kv_is_stable(ac_test_state* s) {
+  ac_test_begin(s);
+
+  enum { LEN = 10000 };
+  static int32_t keys[LEN];
+  static uint32_t values[LEN];
+  uint64_t rng = 4;
+  for (size_t i = 0; i < LEN; ++i) {
+    keys[i] = (int32_t)(ac_sort_test_rand_(&rng) % 100) - 50;
+    values[i] = i;
+  }
+
+  // Scratch from an arena.
+  ac_arena arena = ac_arena_create((ac_arena_opts){});
+  ac_list(int32_t) list = {keys, LEN, LEN};
+  ac_test_expect(
+      ac_radix_sort_kv(int32_t, &list, values, ac_arena_allocator2(&arena)),
+      "Sort failed.");
+  ac_arena_destroy(&arena);
+
+  size_t bad = 0;
+  for (size_t i = 1; i < LEN; ++i) {
+    bad += keys[i] < keys[i - 1] ||
+           (keys[i] == keys[i - 1] && values[i] < values[i - 1]);
+  }
+  ac_test_equ(bad, 0);
+}
+
+static inline void radix_sort_parallel(ac_test_state* s) {
+  ac_test_begin(s);
+
+  enum { LEN = 300000 };
+  static uint64_t keys[LEN], original[LEN];
+  static uint32_t values[LEN];
+  uint64_t rng = 5;
+  for (size_t i = 0; i < LEN; ++i) {
+    // Many duplicates among the even keys.
+    keys[i] = original[i] = ac_sort_test_rand_(&rng) >> (i % 2 ? 0 : 50);
+    values[i] = i;
+  }
+
+  ac_thread_pool* pool = NULL;
+#if !defined(WASM)
+  ac_thread_pool thread_pool;
+  ac_test_expect(ac_thread_pool_init(&thread_pool,
+                                     (ac_thread_pool_opts){.threads = 3}),
+                 "Init failed.");
+  pool = &thread_pool;
+#endif
+  ac_test_expect(
+      ac_radix_sort_par_uint64_t(pool, keys, values, LEN, (ac_allocator2){}),
+      "Sort failed.");
+
+  // Each value still goes with its key, and equal keys keep their order.
+  size_t bad = 0;
+  for (size_t i = 0; i < LEN; ++i) {
+    bad += values[i] >= LEN || keys[i] != original[values[i]];
+    if (i) {
+      bad += keys[i] < keys[i - 1] ||
+             (keys[i] == keys[i - 1] && values[i] <= values[i - 1]);
+    }
+  }
+  ac_test_equ(bad, 0);
+#if !defined(WASM)
+  ac_thread_pool_destroy(pool);
+#endif
+}
+
+static inline void radix_sort_parallel_many_threads(ac_test_state* s) {
+  ac_test_begin(s);
+
+#if !defined(WASM)
+  // With 512 chunks, the grain of 129 keys covers the keys in 509 chunks.
+  enum { LEN = 65537 };
+  static uint32_t keys[LEN];
+  uint64_t rng = 6;
+  for (size_t i = 0; i < LEN; ++i) keys[i] = ac_sort_test_rand_(&rng);
+
+  ac_thread_pool pool;
+  ac_test_expect(
+      ac_thread_pool_init(&pool, (ac_thread_pool_opts){.threads = 511}),
+      "Init failed.");
+  ac_test_expect(
+      ac_radix_sort_par_uint32_t(&pool, keys, NULL, LEN, (ac_allocator2){}),
+      "Sort failed.");
+  ac_thread_pool_destroy(&pool);
+
+  size_t unordered = 0;
+  for (size_t i = 1; i < LEN; ++i) unordered += keys[i] < keys[i - 1];
+  ac_test_equ(unordered, 0);
+#endif
+}
+
+static inline void ac_sort_test(ac_test_state* s) {
+  ac_test_begin(s);
+  ac_test_run(radix_sort_types);
+  ac_test_run(radix_sort_floats);
+  ac_test_run(radix_sort_kv_is_stable);
+  ac_test_run(radix_sort_parallel);
+  ac_test_run(radix_sort_parallel_many_threads);
+}
+
+#endif  // AC_SORT_TEST_H_
@@ -1,6 +1,7 @@
 #ifndef AC_STR_H_
 #define AC_STR_H_
 
+#include <inttypes.h>
 #include <limits.h>
 #include <stdio.h>
 
@@ -15,6 +16,22 @@ static inline ac_str ac_str_init(ac_allocator2 alloc);
 // Frees the string using its allocator and clears all fields.
 static inline void ac_str_free(ac_str* s);
 
+// A string that holds up to AC_STR_SMALL_CAP bytes, including the null
+// terminator, without allocating. Use it through 'str', with every 'ac_str'
+// function and macro; it only allocates once it outgrows the inline bytes.
+// 'str' allocates through hooks that pass the inline bytes over, and forward
+// everything else to 'alloc'.
+// NOTE: 'str' points into the struct, so don't copy it by value.
+enum { AC_STR_SMALL_CAP = 32 };
+typedef struct ac_str_small {
+  ac_str str;
+  ac_allocator2 alloc;
+  char small[AC_STR_SMALL_CAP];
+} ac_str_small;
+
+// Initialize an empty small string, and return its 'str'.
+static inline ac_str* ac_str_small_init(ac_str_small* s, ac_allocator2 alloc);
+
 // Maximum number of characters that can be printed.
 #if defined RSIZE_MAX
 enum : size_t { AC_PRINT_MAX = RSIZE_MAX };
@@ -34,10 +51,47 @@ static inline ac_str ac_str_init(ac_allocator2 alloc) {
 }
 
 static inline void ac_str_free(ac_str* s) {
-  ac_free2(s->alloc, ac_lista_mem(s));
+  ac_lista_free(s);
   *s = (ac_str){};
 }
 
+static inline ac_mem ac_str_small_alloc_(void* state, size_t cap) {
+  return ac_alloc2(((ac_str_small*)state)->alloc, cap);
+}
+
+static inline void ac_str_small_free_(void* state, ac_mem m) {
+  ac_str_small* s = state;
+  if (m.data != s->small) ac_free2(s->alloc, m);
+}
+
+static inline ac_mem ac_str_small_realloc_(void* state, ac_mem m, size_t cap) {
+  ac_str_small* s = state;
+  if (m.data != s->small) return ac_realloc2(s->alloc, m, cap);
+
+  const ac_mem ret = ac_alloc2(s->alloc, cap);
+  if (ret.data) memcpy(ret.data, m.data, m.cap < cap ? m.cap : cap);
+  return ret;
+}
+
+static inline ac_mem ac_str_small_alloc_aligned_(void* state, size_t align,
+                                                 size_t cap) {
+  return ac_alloc2_aligned(((ac_str_small*)state)->alloc, align, cap);
+}
+
+static inline ac_str* ac_str_small_init(ac_str_small* s, ac_allocator2 alloc) {
+  s->alloc = ac_allocator2_is_empty(alloc) ? ac_mallocator2() : alloc;
+  const ac_allocator2 hooks = {
+      .state = s,
+      .alloc = &ac_str_small_alloc_,
+      .free = &ac_str_small_free_,
+      .realloc = &ac_str_small_realloc_,
+      .alloc_aligned = &ac_str_small_alloc_aligned_,
+  };
+  s->str = (ac_str){hooks, s->small, 0, AC_STR_SMALL_CAP};
+  s->small[0] = '\0';
+  return &s->str;
+}
+
 // Formatted string printing to an extensible buffer (using snprintf).
 // Returns the number of characters printed, omitting the null terminator.
 // If the buffer is too small and allocation fails, returns 0.
@@ -84,6 +84,7 @@
 
 #include "ac_alloc.h"
 #include "ac_str.h"
+#include "ac_tracking.h"
 
 //------------------------------------------------------------------------------
 // Source Location.
@@ -183,12 +184,16 @@ typedef struct ac_test_opts {
   ac_allocator2 alloc;
   // Right-alignment of the FAILED message. If default, 80 is used.
   size_t failed_msg_column;
+  // Tracks allocations made by code under test, see 'ac_test_alloc()'.
+  // Required by allocation budgets. Internal memory is never tracked.
+  ac_tracking* tracking;
 } ac_test_opts;
 
 // State for a group of test cases.
 typedef struct ac_test_state {
   size_t failed_msg_column;
   FILE* out;
+  ac_tracking* tracking;
   ac_str scratch;
   ac_str names;
   ac_lista(ac_test_stack_node) stack;
@@ -237,6 +242,7 @@ static inline void ac_test_state_init_(ac_test_state* s, ac_test_opts opts) {
   s->failed_msg_column = opts.failed_msg_column ? opts.failed_msg_column : 80;
   // Output defaults to stdout.
   s->out = opts.output ? opts.output : stdout;
+  s->tracking = opts.tracking;
   // Set the allocators to the user-specified one.
   // If ops.alloc is empty, lista defaults to malloc internally.
   s->stack.alloc = opts.alloc;
@@ -416,6 +422,41 @@ static inline bool ac_test_after_call_(ac_test_state* s) {
                    #b, #a, (type)a_, #b, (type)b_); /* Evalutes to T/F. */     \
   })
 
+// State of an allocation budget scope.
+typedef struct ac_test_alloc_scope_ {
+  size_t budget;
+  // Allocations (incl. reallocs) made before the scope began.
+  size_t allocs_before;
+  bool done;
+} ac_test_alloc_scope_;
+
+// Allocations and reallocs made through the tracking allocator so far.
+static inline size_t ac_test_allocs_(const ac_test_state* s) {
+  if (!s->tracking) return 0;
+  const ac_tracking_stats stats = ac_tracking_stats_of(&s->tracking->counters);
+  return stats.allocs + stats.reallocs;
+}
+
+static inline ac_test_alloc_scope_ ac_test_alloc_scope_begin_(
+    const ac_test_state* s, size_t budget) {
+  return (ac_test_alloc_scope_){budget, ac_test_allocs_(s)};
+}
+
+// Fails the test case if the scope went over budget.
+#define ac_test_alloc_scope_end_(scope)                                    \
+  ({                                                                       \
+    const size_t allocs_ =                                                 \
+        ac_test_allocs_(ac_test_s_) - (scope).allocs_before;               \
+    (scope).done = true;                                                   \
+    if (!ac_test_s_->tracking) {                                           \
+      ac_test_fail("Allocation budgets require 'ac_test_opts.tracking'."); \
+    } else if (allocs_ > (scope).budget) {                                 \
+      ac_test_fail("Allocation budget exceeded\n  allocations: %zu\n"      \
+                   "  budget: %zu",                                        \
+                   allocs_, (scope).budget);                               \
+    }                                                                      \
+  })
+
 static inline void ac_test_begin_params_(ac_test_state* s) {
   ac_to_str(&s->names, "(");
   fprintf(s->out, "(");  // NOTE: Don't update print count.
@@ -578,6 +619,30 @@ static inline void ac_test_log_param_direct_str_(ac_test_state* s, ac_str str) {
 // Fails the test case but doesn't return. Always evalutes to 'false'.
 #define ac_test_fail(...) ac_test_fail_(__VA_ARGS__)
 
+// Allocator for code under test. Allocations through it count towards budgets.
+// Without 'ac_test_opts.tracking', it's ac_mallocator2().
+#define ac_test_alloc()                                                \
+  (ac_test_s_->tracking ? ac_tracking_allocator2(ac_test_s_->tracking) \
+                        : ac_mallocator2())
+
+// Runs the following statement or block, then fails the test case if it made
+// more than 'max_allocs' allocations (or reallocs) through 'ac_test_alloc()'.
+// Frees aren't counted. Leaving the block with break/return skips the check.
+//
+//   ac_test_expect_alloc_budget(1) { *ac_lista_next_ex(&list) = x; }
+//
+#define ac_test_expect_alloc_budget(max_allocs)                  \
+  for (ac_test_alloc_scope_ ac_test_scope_ =                     \
+           ac_test_alloc_scope_begin_(ac_test_s_, (max_allocs)); \
+       !ac_test_scope_.done; ac_test_alloc_scope_end_(ac_test_scope_))
+
+// Fails the test case if the following statement or block allocates, e.g. to
+// guard a hot path that is meant to be allocation free.
+//
+//   ac_test_expect_no_alloc { ac_to_str(&reserved_str, "abc"); }
+//
+#define ac_test_expect_no_alloc ac_test_expect_alloc_budget(0)
+
 // Fails the test case if 'cond' is false.
 #define ac_test_expect(cond, ...) ac_test_expect_(cond, __VA_ARGS__)
 
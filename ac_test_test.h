@@ -294,6 +294,71 @@ static inline void lef_fail(ac_test_state* s) {
   ac_test_lef(4.1, 3.1);
 }
 
+//------------------------------------------------------------------------------
+// Allocation Budgets
+//------------------------------------------------------------------------------
+
+static inline void no_alloc_ok(ac_test_state* s) {
+  ac_test_begin(s);
+  ac_tracking tracking;
+  ac_tracking_init(&tracking, ac_mallocator2());
+  s->tracking = &tracking;
+
+  ac_lista(int32_t) list = {.alloc = ac_test_alloc()};
+  ac_lista_realloc(&list, 16);
+  ac_test_expect_no_alloc {
+    for (int32_t i = 0; i < 16; ++i) *ac_lista_next_ex(&list) = i;
+  }
+  ac_lista_free(&list);
+  s->tracking = NULL;
+}
+
+static inline void no_alloc_fail(ac_test_state* s) {
+  ac_test_begin(s);
+  ac_tracking tracking;
+  ac_tracking_init(&tracking, ac_mallocator2());
+  s->tracking = &tracking;
+
+  ac_lista(int32_t) list = {.alloc = ac_test_alloc()};
+  ac_test_expect_no_alloc { *ac_lista_next_ex(&list) = 1; }
+  ac_lista_free(&list);
+  s->tracking = NULL;
+}
+
+static inline void alloc_budget_ok(ac_test_state* s) {
+  ac_test_begin(s);
+  ac_tracking tracking;
+  ac_tracking_init(&tracking, ac_mallocator2());
+  s->tracking = &tracking;
+
+  // Grows 1 => 2 => 4 elements: an alloc and two reallocs.
+  ac_lista(int32_t) list = {.alloc = ac_test_alloc()};
+  ac_test_expect_alloc_budget(3) {
+    for (int32_t i = 0; i < 4; ++i) *ac_lista_next_ex(&list) = i;
+  }
+  ac_lista_free(&list);
+  s->tracking = NULL;
+}
+
+static inline void alloc_budget_fail(ac_test_state* s) {
+  ac_test_begin(s);
+  ac_tracking tracking;
+  ac_tracking_init(&tracking, ac_mallocator2());
+  s->tracking = &tracking;
+
+  ac_lista(int32_t) list = {.alloc = ac_test_alloc()};
+  ac_test_expect_alloc_budget(2) {
+    for (int32_t i = 0; i < 4; ++i) *ac_lista_next_ex(&list) = i;
+  }
+  ac_lista_free(&list);
+  s->tracking = NULL;
+}
+
+static inline void no_alloc_without_tracking_fails(ac_test_state* s) {
+  ac_test_begin(s);
+  ac_test_expect_no_alloc {}
+}
+
 //------------------------------------------------------------------------------
 // Harness
 //------------------------------------------------------------------------------
@@ -422,6 +487,13 @@ static inline void ac_test_test(ac_test_state* s) {
   run_case_(/*cases=*/1, /*failures=*/0, lef_ok);
   run_case_(/*cases=*/1, /*failures=*/1, lef_fail);
 
+  // Allocation budgets.
+  run_case_(/*cases=*/1, /*failures=*/0, no_alloc_ok);
+  run_case_(/*cases=*/1, /*failures=*/1, no_alloc_fail);
+  run_case_(/*cases=*/1, /*failures=*/0, alloc_budget_ok);
+  run_case_(/*cases=*/1, /*failures=*/1, alloc_budget_fail);
+  run_case_(/*cases=*/1, /*failures=*/1, no_alloc_without_tracking_fails);
+
 #undef run_case_
 
   ac_str_free(&out_str);
@@ -0,0 +1,441 @@
+#ifndef AC_THREAD_H_
+#define AC_THREAD_H_
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#include "ac_alloc.h"
+#include "ac_mem.h"
+#include "ac_ring.h"
+
+//------------------------------------------------------------------------------
+// Thread Pool.
+//------------------------------------------------------------------------------
+
+// A fixed pool of worker threads running fork-join tasks.
+//  - Each worker keeps its own tasks in a Chase-Lev deque: it pushes and pops
+//    at the bottom, without contention, while idle workers steal the oldest
+//    tasks from the top. Old tasks tend to be the biggest, so few steals are
+//    needed to spread the work.
+//  - Threads outside the pool submit tasks through a shared 'ac_mpmc' queue.
+//  - A thread waiting for a task group runs tasks until the group is done,
+//    so tasks may spawn and wait for other tasks without deadlocking.
+//  - Workers sleep when they find nothing to run.
+// Tasks are owned by the caller and must stay alive until their group is done.
+// A task that can't be queued (the queue is full) runs right away.
+
+// Options for a thread pool.
+typedef struct ac_thread_pool_opts {
+  size_t threads;       // Defaults to one less than the number of CPUs.
+  bool pin;             // Pin worker i to CPU i. Only supported on Linux.
+  ac_allocator2 alloc;  // Defaults to malloc.
+} ac_thread_pool_opts;
+
+typedef struct ac_task_group ac_task_group;
+
+// A unit of work. Set 'fn' and 'ctx', then spawn it in a group.
+typedef struct ac_task {
+  void (*fn)(void* ctx);
+  void* ctx;
+  ac_task_group* group;  // Set by 'ac_task_group_spawn'.
+} ac_task;
+
+// Tasks per worker deque.
+enum { AC_THREAD_DEQUE_CAP = 256 };
+
+// A worker and its deque.
+typedef struct ac_thread_worker_ {
+  _Alignas(AC_CACHE_LINE) atomic_ptrdiff_t top;
+  _Alignas(AC_CACHE_LINE) atomic_ptrdiff_t bottom;
+  _Atomic(ac_task*) tasks[AC_THREAD_DEQUE_CAP];
+  struct ac_thread_pool* pool;
+  pthread_t thread;
+  size_t index;
+  uint64_t rng;
+} ac_thread_worker_;
+
+typedef struct ac_thread_pool {
+  ac_thread_worker_* workers;
+  size_t count;
+  ac_mpmc injected;  // Tasks spawned from outside the pool.
+  bool pin;
+  ac_allocator2 alloc;
+  // Sleeping workers wait for 'epoch' to change.
+  _Alignas(AC_CACHE_LINE) atomic_size_t epoch;
+  atomic_size_t sleeping;
+  atomic_bool stop;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+} ac_thread_pool;
+
+// Tasks that can be waited for together.
+struct ac_task_group {
+  ac_thread_pool* pool;
+  atomic_size_t pending;
+};
+
+// Starts the workers. Returns false if allocation or thread creation failed.
+static inline bool ac_thread_pool_init(ac_thread_pool*, ac_thread_pool_opts);
+
+// Stops and joins the workers. All task groups must be done.
+static inline void ac_thread_pool_destroy(ac_thread_pool*);
+
+static inline ac_task_group ac_task_group_init(ac_thread_pool* pool) {
+  return (ac_task_group){.pool = pool};
+}
+
+// Queues a task to run in the pool.
+static inline void ac_task_group_spawn(ac_task_group*, ac_task*);
+
+// Runs tasks of the pool until all tasks of the group are done.
+static inline void ac_task_group_wait(ac_task_group*);
+
+// Runs 'fn' on consecutive ranges covering [0, len), each at most 'grain' long
+// (defaults to 1), in parallel. Returns once all ranges are done. Runs on the
+// calling thread alone if 'pool' is NULL or allocation fails.
+static inline void ac_parallel_for_n(ac_thread_pool* pool, size_t len,
+                                     size_t grain,
+                                     void (*fn)(void* ctx, size_t begin,
+                                                size_t end),
+                                     void* ctx);
+
+// Runs 'fn' on index ranges of any 'ac_span'.
+#define ac_parallel_for(pool, span, grain, fn, ctx) \
+  ac_parallel_for_n(pool, (span).len, grain, fn, ctx)
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// The worker running on this thread, if any.
+static _Thread_local ac_thread_worker_* ac_thread_worker_tls_;
+
+// Owner: pushes a task at the bottom. Returns false if the deque is full.
+static inline bool ac_thread_deque_push_(ac_thread_worker_* w, ac_task* task) {
+  const ptrdiff_t b = atomic_load_explicit(&w->bottom, memory_order_relaxed);
+  const ptrdiff_t t = atomic_load_explicit(&w->top, memory_order_acquire);
+  if (b - t >= AC_THREAD_DEQUE_CAP) return false;
+  atomic_store_explicit(&w->tasks[b % AC_THREAD_DEQUE_CAP], task,
+                        memory_order_relaxed);
+  atomic_store_explicit(&w->bottom, b + 1, memory_order_release);
+  return true;
+}
+
+// Owner: pops the newest task, racing thieves for the last one.
+static inline ac_task* ac_thread_deque_pop_(ac_thread_worker_* w) {
+  const ptrdiff_t b =
+      atomic_load_explicit(&w->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&w->bottom, b, memory_order_seq_cst);
+  ptrdiff_t t = atomic_load_explicit(&w->top, memory_order_seq_cst);
+  if (t > b) {
+    atomic_store_explicit(&w->bottom, b + 1, memory_order_relaxed);
+    return NULL;
+  }
+  ac_task* task = atomic_load_explicit(&w->tasks[b % AC_THREAD_DEQUE_CAP],
+                                       memory_order_relaxed);
+  if (t == b) {
+    if (!atomic_compare_exchange_strong_explicit(&w->top, &t, t + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+      task = NULL;
+    }
+    atomic_store_explicit(&w->bottom, b + 1, memory_order_relaxed);
+  }
+  return task;
+}
+
+// Thief: takes the oldest task. Returns NULL if there is none, or another
+// thread took it first.
+static inline ac_task* ac_thread_deque_steal_(ac_thread_worker_* w) {
+  ptrdiff_t t = atomic_load_explicit(&w->top, memory_order_seq_cst);
+  const ptrdiff_t b = atomic_load_explicit(&w->bottom, memory_order_seq_cst);
+  if (t >= b) return NULL;
+  ac_task* task = atomic_load_explicit(&w->tasks[t % AC_THREAD_DEQUE_CAP],
+                                       memory_order_relaxed);
+  if (!atomic_compare_exchange_strong_explicit(&w->top, &t, t + 1,
+                                               memory_order_seq_cst,
+                                               memory_order_relaxed)) {
+    return NULL;
+  }
+  return task;
+}
+
+static inline uint64_t ac_thread_rand_(uint64_t* rng) {
+  *rng ^= *rng << 13;
+  *rng ^= *rng >> 7;
+  *rng ^= *rng << 17;
+  return *rng;
+}
+
+// Finds a task: from the own deque, then the shared queue, then a victim
+// starting at a random worker. 'w' is NULL outside the pool.
+static inline ac_task* ac_thread_find_task_(ac_thread_pool* x,
+                                            ac_thread_worker_* w,
+                                            uint64_t* rng) {
+  ac_task* task = w ? ac_thread_deque_pop_(w) : NULL;
+  if (task) return task;
+  if (ac_mpmc_pop(&x->injected, &task)) return task;
+  const size_t start = ac_thread_rand_(rng) % x->count;
+  for (size_t i = 0; i < x->count; ++i) {
+    ac_thread_worker_* victim = &x->workers[(start + i) % x->count];
+    if (victim == w) continue;
+    task = ac_thread_deque_steal_(victim);
+    if (task) return task;
+  }
+  return NULL;
+}
+
+static inline void ac_thread_run_task_(ac_task* task) {
+  // The task may be freed once the group is done, so don't touch it after.
+  ac_task_group* group = task->group;
+  task->fn(task->ctx);
+  atomic_fetch_sub_explicit(&group->pending, 1, memory_order_release);
+}
+
+static inline void ac_thread_wake_(ac_thread_pool* x) {
+  atomic_fetch_add(&x->epoch, 1);
+  if (atomic_load(&x->sleeping)) {
+    pthread_mutex_lock(&x->lock);
+    pthread_cond_signal(&x->wake);
+    pthread_mutex_unlock(&x->lock);
+  }
+}
+
+static inline void ac_thread_pin_(size_t cpu) {
+#if defined(__linux__)
+  unsigned long mask[16] = {};
+  const size_t bits = sizeof(*mask) * 8;
+  if (cpu >= sizeof(mask) * 8) return;
+  mask[cpu / bits] = 1ul << (cpu % bits);
+  syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask);
+#else
+  (void)cpu;
+#endif
+}
+
+// Idle rounds before a worker goes to sleep.
+enum { AC_THREAD_SPINS = 64 };
+
+static inline void* ac_thread_worker_main_(void* arg) {
+  ac_thread_worker_* w = arg;
+  ac_thread_pool* x = w->pool;
+  ac_thread_worker_tls_ = w;
+  if (x->pin) ac_thread_pin_(w->index);
+
+  size_t idle = 0;
+  while (!atomic_load_explicit(&x->stop, memory_order_acquire)) {
+    // A spawn after this load changes the epoch, so the sleep below can't
+    // miss it.
+    const size_t epoch = atomic_load(&x->epoch);
+    ac_task* task = ac_thread_find_task_(x, w, &w->rng);
+    if (task) {
+      ac_thread_run_task_(task);
+      idle = 0;
+      continue;
+    }
+    if (++idle < AC_THREAD_SPINS) {
+      sched_yield();
+      continue;
+    }
+
+    pthread_mutex_lock(&x->lock);
+    atomic_fetch_add(&x->sleeping, 1);
+    while (atomic_load(&x->epoch) == epoch && !atomic_load(&x->stop)) {
+      pthread_cond_wait(&x->wake, &x->lock);
+    }
+    atomic_fetch_sub(&x->sleeping, 1);
+    pthread_mutex_unlock(&x->lock);
+    idle = 0;
+  }
+  return NULL;
+}
+
+// Stops and joins the first 'started' workers.
+static inline void ac_thread_pool_stop_(ac_thread_pool* x, size_t started) {
+  atomic_store(&x->stop, true);
+  pthread_mutex_lock(&x->lock);
+  pthread_cond_broadcast(&x->wake);
+  pthread_mutex_unlock(&x->lock);
+  for (size_t i = 0; i < started; ++i) {
+    pthread_join(x->workers[i].thread, NULL);
+  }
+  pthread_mutex_destroy(&x->lock);
+  pthread_cond_destroy(&x->wake);
+}
+
+static inline void ac_thread_pool_free_(ac_thread_pool* x) {
+  const size_t size = x->count * sizeof(ac_thread_worker_);
+  ac_free2(x->alloc, (ac_mem){x->workers, size});
+  ac_mpmc_destroy(&x->injected);
+  *x = (ac_thread_pool){};
+}
+
+static inline bool ac_thread_pool_init(ac_thread_pool* x,
+                                       ac_thread_pool_opts opts) {
+  if (!opts.threads) {
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    opts.threads = cpus > 1 ? (size_t)cpus - 1 : 1;
+  }
+  if (ac_allocator2_is_empty(opts.alloc)) opts.alloc = ac_mallocator2();
+  *x = (ac_thread_pool){.pin = opts.pin, .alloc = opts.alloc};
+
+  const ac_ring_opts injected = {.elem_size = sizeof(ac_task*),
+                                 .alloc = opts.alloc};
+  if (!ac_mpmc_init(&x->injected, injected)) return false;
+  x->workers = ac_alloc2_aligned(opts.alloc, AC_CACHE_LINE,
+                                 opts.threads * sizeof(ac_thread_worker_))
+                   .data;
+  if (!x->workers) {
+    ac_mpmc_destroy(&x->injected);
+    return false;
+  }
+  atomic_init(&x->epoch, 0);
+  atomic_init(&x->sleeping, 0);
+  atomic_init(&x->stop, false);
+  pthread_mutex_init(&x->lock, NULL);
+  pthread_cond_init(&x->wake, NULL);
+
+  // Workers steal from each other, so all are set up before any starts.
+  x->count = opts.threads;
+  for (size_t i = 0; i < x->count; ++i) {
+    ac_thread_worker_* w = &x->workers[i];
+    *w = (ac_thread_worker_){
+        .pool = x,
+        .index = i,
+        .rng = 0x9E3779B97F4A7C15ull * (i + 1),
+    };
+    atomic_init(&w->top, 0);
+    atomic_init(&w->bottom, 0);
+    for (size_t j = 0; j < AC_THREAD_DEQUE_CAP; ++j) {
+      atomic_init(&w->tasks[j], NULL);
+    }
+  }
+  for (size_t i = 0; i < x->count; ++i) {
+    ac_thread_worker_* w = &x->workers[i];
+    if (pthread_create(&w->thread, NULL, &ac_thread_worker_main_, w)) {
+      ac_thread_pool_stop_(x, i);
+      ac_thread_pool_free_(x);
+      return false;
+    }
+  }
+  return true;
+}
+
+static inline void ac_thread_pool_destroy(ac_thread_pool* x) {
+  if (!x->workers) return;
+  ac_thread_pool_stop_(x, x->count);
+  ac_thread_pool_free_(x);
+}
+
+static inline void ac_task_group_spawn(ac_task_group* g, ac_task* task) {
+  task->group = g;
+  atomic_fetch_add_explicit(&g->pending, 1, memory_order_relaxed);
+  ac_thread_worker_* w = ac_thread_worker_tls_;
+  const bool queued = w && w->pool == g->pool
+                          ? ac_thread_deque_push_(w, task)
+                          : ac_mpmc_push(&g->pool->injected, &task);
+  if (!queued) {
+    ac_thread_run_task_(task);
+    return;
+  }
+  ac_thread_wake_(g->pool);
+}
+
+static inline void ac_task_group_wait(ac_task_group* g) {
+  ac_thread_worker_* w = ac_thread_worker_tls_;
+  if (w && w->pool != g->pool) w = NULL;
+  uint64_t rng = (uintptr_t)g | 1;
+  while (atomic_load_explicit(&g->pending, memory_order_acquire)) {
+    ac_task* task = ac_thread_find_task_(g->pool, w, w ? &w->rng : &rng);
+    if (task) {
+      ac_thread_run_task_(task);
+    } else {
+      sched_yield();
+    }
+  }
+}
+
+// A range of a parallel for loop, split in halves as long as other threads
+// are around to take one.
+typedef struct ac_parallel_range_ {
+  ac_task task;
+  struct ac_parallel_for_* loop;
+  size_t begin;
+  size_t end;
+} ac_parallel_range_;
+
+typedef struct ac_parallel_for_ {
+  ac_task_group group;
+  void (*fn)(void* ctx, size_t begin, size_t end);
+  void* ctx;
+  size_t grain;
+  ac_parallel_range_* ranges;
+  atomic_size_t next_range;
+} ac_parallel_for_;
+
+static inline void ac_parallel_range_run_(void* arg) {
+  ac_parallel_range_* r = arg;
+  ac_parallel_for_* loop = r->loop;
+  size_t begin = r->begin, end = r->end;
+  // Spawns the upper half until a single grain is left, rounding the split to
+  // whole grains. A loop of n grains spawns at most n - 1 ranges.
+  while (end - begin > loop->grain) {
+    const size_t grains = (end - begin + loop->grain - 1) / loop->grain;
+    const size_t mid = begin + grains / 2 * loop->grain;
+    ac_parallel_range_* half = &loop->ranges[atomic_fetch_add_explicit(
+        &loop->next_range, 1, memory_order_relaxed)];
+    *half = (ac_parallel_range_){
+        .task = {.fn = &ac_parallel_range_run_, .ctx = half},
+        .loop = loop,
+        .begin = mid,
+        .end = end,
+    };
+    ac_task_group_spawn(&loop->group, &half->task);
+    end = mid;
+  }
+  loop->fn(loop->ctx, begin, end);
+}
+
+static inline void ac_parallel_for_n(ac_thread_pool* pool, size_t len,
+                                     size_t grain,
+                                     void (*fn)(void* ctx, size_t begin,
+                                                size_t end),
+                                     void* ctx) {
+  if (!grain) grain = 1;
+  if (!len) return;
+  if (!pool || len <= grain) {
+    fn(ctx, 0, len);
+    return;
+  }
+
+  const size_t grains = (len - 1) / grain + 1;
+  const ac_mem ranges =
+      ac_alloc2(pool->alloc, (grains - 1) * sizeof(ac_parallel_range_));
+  if (!ranges.data) {
+    fn(ctx, 0, len);
+    return;
+  }
+  ac_parallel_for_ loop = {
+      .group = ac_task_group_init(pool),
+      .fn = fn,
+      .ctx = ctx,
+      .grain = grain,
+      .ranges = ranges.data,
+  };
+  atomic_init(&loop.next_range, 0);
+  ac_parallel_range_ all = {.loop = &loop, .end = len};
+  ac_parallel_range_run_(&all);
+  ac_task_group_wait(&loop.group);
+  ac_free2(pool->alloc, ranges);
+}
+
+#endif  // AC_THREAD_H_
@@ -0,0 +1,114 @@
+// Measures how 'ac_parallel_for_n' scales with the number of threads, on a
+// compute-bound and a memory-bound loop, and how the grain affects it. Only
+// meaningful in optimized builds:
+//
+//   make OPT=1 ac_thread_bench && build/ac_thread_bench
+//
+#include <stdio.h>
+#include <unistd.h>
+
+#include "ac_thread.h"
+
+#define AC_TIME_IMPL
+#include "ac_time.h"
+
+enum {
+  AC_THREAD_BENCH_LEN = 1 << 24,  // Elements per loop.
+  AC_THREAD_BENCH_GRAIN = 1 << 14,
+  AC_THREAD_BENCH_MIN_GRAIN = 256,
+  AC_THREAD_BENCH_ROUNDS = 5,  // Loops per measurement; the fastest is kept.
+};
+
+typedef struct ac_thread_bench_loop {
+  float* data;
+  uint64_t* sums;  // Per grain, for the compute-bound loop.
+  size_t grain;
+} ac_thread_bench_loop;
+
+// Compute-bound: many multiplies per element, few memory accesses.
+static inline void ac_thread_bench_compute_(void* ctx, size_t begin,
+                                            size_t end) {
+  ac_thread_bench_loop* x = ctx;
+  uint64_t sum = 0;
+  for (size_t i = begin; i < end; ++i) {
+    uint64_t h = i;
+    for (int k = 0; k < 16; ++k) h = (h ^ (h >> 29)) * 0xbf58476d1ce4e5b9ull;
+    sum += h;
+  }
+  x->sums[begin / x->grain] = sum;
+}
+
+// Memory-bound: one multiply-add per element loaded and stored.
+static inline void ac_thread_bench_memory_(void* ctx, size_t begin,
+                                           size_t end) {
+  ac_thread_bench_loop* x = ctx;
+  for (size_t i = begin; i < end; ++i) x->data[i] = x->data[i] * 0.5f + 1.0f;
+}
+
+// Returns the fastest of a few runs of the loop, in milliseconds.
+static inline double ac_thread_bench_run_(ac_thread_pool* pool,
+                                          ac_thread_bench_loop* x,
+                                          void (*fn)(void*, size_t, size_t)) {
+  double best = 0;
+  for (size_t r = 0; r < AC_THREAD_BENCH_ROUNDS; ++r) {
+    const ac_cputime t0 = ac_cputime_now();
+    ac_parallel_for_n(pool, AC_THREAD_BENCH_LEN, x->grain, fn, x);
+    const ac_dcputime dt = ac_cputime_diff(ac_cputime_now(), t0);
+    const double ms = 1e3 * dt.cpu_dticks / ac_cputime_freq();
+    if (!r || ms < best) best = ms;
+  }
+  return best;
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  static float data[AC_THREAD_BENCH_LEN];
+  static uint64_t sums[AC_THREAD_BENCH_LEN / AC_THREAD_BENCH_MIN_GRAIN];
+  ac_thread_bench_loop x = {data, sums, AC_THREAD_BENCH_GRAIN};
+
+  // Serial first, then pools of up to twice as many workers as CPUs. The
+  // calling thread runs ranges too while it waits.
+  const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  const double compute_1 = ac_thread_bench_run_(NULL, &x,
+                                                &ac_thread_bench_compute_);
+  const double memory_1 = ac_thread_bench_run_(NULL, &x,
+                                               &ac_thread_bench_memory_);
+  printf("%-8s %12s %8s %12s %8s\n", "workers", "compute ms", "speedup",
+         "memory ms", "speedup");
+  printf("%-8s %12.2f %8.2f %12.2f %8.2f\n", "serial", compute_1, 1.0,
+         memory_1, 1.0);
+  for (size_t workers = 1; workers <= (size_t)ac_max(2 * cpus, 2);
+       workers *= 2) {
+    ac_thread_pool pool;
+    if (!ac_thread_pool_init(&pool,
+                             (ac_thread_pool_opts){.threads = workers})) {
+      printf("Pool of %zu workers failed.\n", workers);
+      return 1;
+    }
+    const double compute =
+        ac_thread_bench_run_(&pool, &x, &ac_thread_bench_compute_);
+    const double memory =
+        ac_thread_bench_run_(&pool, &x, &ac_thread_bench_memory_);
+    printf("%-8zu %12.2f %8.2f %12.2f %8.2f\n", workers, compute,
+           compute_1 / compute, memory, memory_1 / memory);
+    ac_thread_pool_destroy(&pool);
+  }
+
+  // The grain trades scheduling overhead against load balance.
+  ac_thread_pool pool;
+  if (!ac_thread_pool_init(&pool, (ac_thread_pool_opts){})) return 1;
+  printf("\n%-8s %12s %12s  (%zu workers)\n", "grain", "compute ms",
+         "memory ms", pool.count);
+  for (size_t grain = AC_THREAD_BENCH_MIN_GRAIN;
+       grain <= AC_THREAD_BENCH_LEN / 4; grain *= 8) {
+    x.grain = grain;
+    const double compute =
+        ac_thread_bench_run_(&pool, &x, &ac_thread_bench_compute_);
+    const double memory =
+        ac_thread_bench_run_(&pool, &x, &ac_thread_bench_memory_);
+    printf("%-8zu %12.2f %12.2f\n", grain, compute, memory);
+  }
+  ac_thread_pool_destroy(&pool);
+  return 0;
+}
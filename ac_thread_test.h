@@ -0,0 +1,146 @@
+#ifndef AC_THREAD_TEST_H_
+#define AC_THREAD_TEST_H_
+
+#include <stdint.h>
+
+#include "ac_mem.h"
+#include "ac_test.h"
+#include "ac_thread.h"
+
+//------------------------------------------------------------------------------
+// Thread Pool
+//------------------------------------------------------------------------------
+
+#if !defined(WASM)
+
+enum { AC_THREAD_TEST_LEN = 100003, AC_THREAD_TEST_GRAIN = 64 };
+
+typedef struct ac_thread_test_loop_ {
+  ac_span(int32_t) values;
+  atomic_size_t calls;
+  atomic_bool too_long;
+} ac_thread_test_loop_;
+
+static inline void ac_thread_test_loop_body_(void* ctx, size_t begin,
+                                             size_t end) {
+  ac_thread_test_loop_* loop = ctx;
+  if (end - begin > AC_THREAD_TEST_GRAIN) atomic_store(&loop->too_long, true);
+  for (size_t i = begin; i < end; ++i) ++loop->values.data[i];
+  atomic_fetch_add(&loop->calls, 1);
+}
+
+static inline void parallel_for_covers_range(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_thread_pool pool;
+  ac_test_expect(ac_thread_pool_init(&pool, (ac_thread_pool_opts){
+                                                .threads = 4}),
+                 "Init failed.");
+  static int32_t values[AC_THREAD_TEST_LEN];
+  ac_thread_test_loop_ loop = {.values = {values, AC_THREAD_TEST_LEN}};
+
+  // Every element is visited exactly once, in ranges of at most a grain.
+  for (int round = 0; round < 3; ++round) {
+    ac_parallel_for(&pool, loop.values, AC_THREAD_TEST_GRAIN,
+                    &ac_thread_test_loop_body_, &loop);
+  }
+  bool all_three = true;
+  for (size_t i = 0; i < AC_THREAD_TEST_LEN; ++i) all_three &= values[i] == 3;
+  ac_test_expect(all_three, "Some elements weren't visited 3 times.");
+  ac_test_expect(!atomic_load(&loop.too_long), "A range exceeds the grain.");
+  ac_test_equ(atomic_load(&loop.calls),
+              3 * ((AC_THREAD_TEST_LEN - 1) / AC_THREAD_TEST_GRAIN + 1));
+
+  // Without a pool, the loop runs as a single range.
+  atomic_store(&loop.calls, 0);
+  ac_parallel_for_n(NULL, 10, 0, &ac_thread_test_loop_body_, &loop);
+  ac_test_equ(atomic_load(&loop.calls), 1);
+  ac_parallel_for_n(&pool, 0, 1, &ac_thread_test_loop_body_, &loop);
+  ac_test_equ(atomic_load(&loop.calls), 1);
+
+  ac_thread_pool_destroy(&pool);
+}
+
+typedef struct ac_thread_test_fib_ {
+  ac_task task;
+  ac_thread_pool* pool;
+  int n;
+  uint64_t result;
+} ac_thread_test_fib_;
+
+// Spawns one half of the recursion and waits for it, from inside the pool.
+static inline void ac_thread_test_fib_run_(void* ctx) {
+  ac_thread_test_fib_* x = ctx;
+  if (x->n < 2) {
+    x->result = x->n;
+    return;
+  }
+  ac_thread_test_fib_ a = {.pool = x->pool, .n = x->n - 1};
+  ac_thread_test_fib_ b = {.pool = x->pool, .n = x->n - 2};
+  a.task = (ac_task){.fn = &ac_thread_test_fib_run_, .ctx = &a};
+  ac_task_group group = ac_task_group_init(x->pool);
+  ac_task_group_spawn(&group, &a.task);
+  ac_thread_test_fib_run_(&b);
+  ac_task_group_wait(&group);
+  x->result = a.result + b.result;
+}
+
+static inline void task_group_nested(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_thread_pool pool;
+  ac_test_expect(ac_thread_pool_init(&pool, (ac_thread_pool_opts){
+                                                .threads = 3, .pin = true}),
+                 "Init failed.");
+  ac_thread_test_fib_ fib = {.pool = &pool, .n = 22};
+  fib.task = (ac_task){.fn = &ac_thread_test_fib_run_, .ctx = &fib};
+  ac_task_group group = ac_task_group_init(&pool);
+  ac_task_group_spawn(&group, &fib.task);
+  ac_task_group_wait(&group);
+  ac_test_equ(fib.result, 17711);
+
+  ac_thread_pool_destroy(&pool);
+}
+
+static inline void ac_thread_test_count_(void* ctx) {
+  atomic_fetch_add((atomic_size_t*)ctx, 1);
+}
+
+static inline void task_group_from_outside(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_thread_pool pool;
+  ac_test_expect(ac_thread_pool_init(&pool, (ac_thread_pool_opts){}),
+                 "Init failed.");
+
+  // More tasks than the shared queue holds: the rest run right away.
+  enum { TASKS = 5000 };
+  static ac_task tasks[TASKS];
+  atomic_size_t count = 0;
+  ac_task_group group = ac_task_group_init(&pool);
+  for (size_t i = 0; i < TASKS; ++i) {
+    tasks[i] = (ac_task){.fn = &ac_thread_test_count_, .ctx = &count};
+    ac_task_group_spawn(&group, &tasks[i]);
+  }
+  ac_task_group_wait(&group);
+  ac_test_equ(atomic_load(&count), TASKS);
+
+  // An empty group is done right away.
+  ac_task_group empty = ac_task_group_init(&pool);
+  ac_task_group_wait(&empty);
+
+  ac_thread_pool_destroy(&pool);
+}
+
+#endif  // !defined(WASM)
+
+static inline void ac_thread_test(ac_test_state* s) {
+  ac_test_begin(s);
+#if !defined(WASM)
+  ac_test_run(parallel_for_covers_range);
+  ac_test_run(task_group_nested);
+  ac_test_run(task_group_from_outside);
+#endif
+}
+
+#endif  // AC_THREAD_TEST_H_
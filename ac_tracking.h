@@ -0,0 +1,332 @@
+#ifndef AC_TRACKING_H_
+#define AC_TRACKING_H_
+
+#include <stdatomic.h>
+
+#include "ac_alloc.h"
+#include "ac_str.h"
+
+//------------------------------------------------------------------------------
+// Allocation Tracking.
+//------------------------------------------------------------------------------
+
+// A tracking allocator wraps any 'ac_allocator2' and records what goes through
+// it: call counts, live and peak bytes, and a log2 histogram of sizes.
+//  - Counters are relaxed atomics, cheap enough to leave on in production and
+//    safe to share between threads.
+//  - Tags attribute allocations to call sites (e.g. "parser", "gzip"). Each
+//    tag has its own counters, and also counts towards the totals.
+//  - Sizes are those passed through 'ac_mem', so frees must pass them along.
+
+// Number of histogram buckets. Bucket i counts sizes in [2^(i-1), 2^i).
+enum { AC_TRACKING_BUCKETS = 48 };
+
+// Counters for all allocations, or those of one tag.
+typedef struct ac_tracking_counters {
+  atomic_size_t allocs;
+  atomic_size_t frees;
+  atomic_size_t reallocs;
+  atomic_size_t failures;
+  atomic_size_t live_bytes;
+  atomic_size_t peak_bytes;
+  atomic_size_t total_bytes;  // Sum of all allocated sizes.
+  atomic_size_t histogram[AC_TRACKING_BUCKETS];
+} ac_tracking_counters;
+
+// Snapshot of a set of counters, without the histogram.
+typedef struct ac_tracking_stats {
+  size_t allocs;
+  size_t frees;
+  size_t reallocs;
+  size_t failures;
+  size_t live_bytes;
+  size_t peak_bytes;
+  size_t total_bytes;
+} ac_tracking_stats;
+
+struct ac_tracking_tag;
+
+// Tracking allocator state.
+typedef struct ac_tracking {
+  ac_allocator2 inner;
+  ac_tracking_counters counters;
+  _Atomic(struct ac_tracking_tag*) tags;
+} ac_tracking;
+
+// Counters for allocations made through one tagged allocator.
+typedef struct ac_tracking_tag {
+  ac_tracking* tracking;
+  const char* name;
+  ac_tracking_counters counters;
+  struct ac_tracking_tag* next;
+} ac_tracking_tag;
+
+// Initialize tracking of allocations made from 'inner'.
+// Defaults to ac_mallocator2() if 'inner' is empty.
+static inline void ac_tracking_init(ac_tracking* t, ac_allocator2 inner);
+
+// Returns the allocator to allocate through, tracked under no tag.
+static inline ac_allocator2 ac_tracking_allocator2(ac_tracking* t);
+
+// Registers a tag, which must outlive the tracking (e.g. static storage).
+// Safe to call from any thread.
+static inline void ac_tracking_tag_init(ac_tracking_tag* tag, ac_tracking* t,
+                                        const char* name);
+
+// Returns the allocator to allocate through, tracked under 'tag'.
+static inline ac_allocator2 ac_tracking_tag_allocator2(ac_tracking_tag* tag);
+
+// Returns a snapshot of the counters.
+static inline ac_tracking_stats ac_tracking_stats_of(
+    const ac_tracking_counters* c);
+
+// Appends a human readable report of the totals, the histogram and all tags.
+static inline void ac_tracking_to_str(ac_str* str, ac_tracking* t);
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+static inline size_t ac_tracking_load_(const atomic_size_t* x) {
+  return atomic_load_explicit((atomic_size_t*)x, memory_order_relaxed);
+}
+
+static inline void ac_tracking_add_(atomic_size_t* x, size_t n) {
+  atomic_fetch_add_explicit(x, n, memory_order_relaxed);
+}
+
+static inline void ac_tracking_sub_(atomic_size_t* x, size_t n) {
+  atomic_fetch_sub_explicit(x, n, memory_order_relaxed);
+}
+
+// Histogram bucket of a size: the number of bits needed to represent it.
+static inline size_t ac_tracking_bucket_(size_t size) {
+  const size_t bits = size ? 64 - __builtin_clzll(size) : 0;
+  return bits < AC_TRACKING_BUCKETS ? bits : AC_TRACKING_BUCKETS - 1;
+}
+
+// Counts an allocated size, without counting the call.
+static inline void ac_tracking_count_bytes_(ac_tracking_counters* c,
+                                            size_t size) {
+  ac_tracking_add_(&c->total_bytes, size);
+  ac_tracking_add_(&c->histogram[ac_tracking_bucket_(size)], 1);
+
+  const size_t live =
+      atomic_fetch_add_explicit(&c->live_bytes, size, memory_order_relaxed) +
+      size;
+  size_t peak = ac_tracking_load_(&c->peak_bytes);
+  while (peak < live && !atomic_compare_exchange_weak_explicit(
+                            &c->peak_bytes, &peak, live, memory_order_relaxed,
+                            memory_order_relaxed)) {
+  }
+}
+
+static inline void ac_tracking_count_alloc_(ac_tracking_counters* c,
+                                            size_t size) {
+  ac_tracking_add_(&c->allocs, 1);
+  ac_tracking_count_bytes_(c, size);
+}
+
+static inline void ac_tracking_count_free_(ac_tracking_counters* c,
+                                           size_t size) {
+  ac_tracking_add_(&c->frees, 1);
+  ac_tracking_sub_(&c->live_bytes, size);
+}
+
+static inline void ac_tracking_count_realloc_(ac_tracking_counters* c,
+                                              ac_mem m, size_t cap) {
+  ac_tracking_add_(&c->reallocs, 1);
+  ac_tracking_sub_(&c->live_bytes, m.cap);
+  ac_tracking_count_bytes_(c, cap);
+}
+
+// Counters to update for an allocator state: the tracking's and maybe a tag's.
+typedef struct ac_tracking_target_ {
+  ac_tracking* tracking;
+  ac_tracking_counters* tag;
+} ac_tracking_target_;
+
+static inline ac_mem ac_tracking_alloc_(ac_tracking_target_ x, size_t cap) {
+  const ac_mem m = ac_alloc2(x.tracking->inner, cap);
+  if (!m.data) {
+    ac_tracking_add_(&x.tracking->counters.failures, 1);
+    if (x.tag) ac_tracking_add_(&x.tag->failures, 1);
+    return m;
+  }
+  ac_tracking_count_alloc_(&x.tracking->counters, m.cap);
+  if (x.tag) ac_tracking_count_alloc_(x.tag, m.cap);
+  return m;
+}
+
+static inline void ac_tracking_free_(ac_tracking_target_ x, ac_mem m) {
+  if (!m.data) return;
+  ac_free2(x.tracking->inner, m);
+  ac_tracking_count_free_(&x.tracking->counters, m.cap);
+  if (x.tag) ac_tracking_count_free_(x.tag, m.cap);
+}
+
+static inline ac_mem ac_tracking_realloc_(ac_tracking_target_ x, ac_mem m,
+                                          size_t cap) {
+  if (!m.data) return ac_tracking_alloc_(x, cap);
+  const ac_mem ret = ac_realloc2(x.tracking->inner, m, cap);
+  if (!ret.data) {
+    ac_tracking_add_(&x.tracking->counters.failures, 1);
+    if (x.tag) ac_tracking_add_(&x.tag->failures, 1);
+    return ret;
+  }
+  ac_tracking_count_realloc_(&x.tracking->counters, m, ret.cap);
+  if (x.tag) ac_tracking_count_realloc_(x.tag, m, ret.cap);
+  return ret;
+}
+
+static inline ac_mem ac_tracking_alloc_aligned_(ac_tracking_target_ x,
+                                                size_t align, size_t cap) {
+  const ac_mem m = ac_alloc2_aligned(x.tracking->inner, align, cap);
+  if (!m.data) {
+    ac_tracking_add_(&x.tracking->counters.failures, 1);
+    if (x.tag) ac_tracking_add_(&x.tag->failures, 1);
+    return m;
+  }
+  ac_tracking_count_alloc_(&x.tracking->counters, m.cap);
+  if (x.tag) ac_tracking_count_alloc_(x.tag, m.cap);
+  return m;
+}
+
+// Allocator callbacks without a tag.
+static inline ac_tracking_target_ ac_tracking_untagged_(void* state) {
+  return (ac_tracking_target_){.tracking = state};
+}
+
+static inline ac_mem ac_tracking_alloc2_(void* state, size_t cap) {
+  return ac_tracking_alloc_(ac_tracking_untagged_(state), cap);
+}
+
+static inline void ac_tracking_free2_(void* state, ac_mem m) {
+  ac_tracking_free_(ac_tracking_untagged_(state), m);
+}
+
+static inline ac_mem ac_tracking_realloc2_(void* state, ac_mem m, size_t cap) {
+  return ac_tracking_realloc_(ac_tracking_untagged_(state), m, cap);
+}
+
+static inline ac_mem ac_tracking_alloc2_aligned_(void* state, size_t align,
+                                                 size_t cap) {
+  return ac_tracking_alloc_aligned_(ac_tracking_untagged_(state), align, cap);
+}
+
+// Allocator callbacks with a tag.
+static inline ac_tracking_target_ ac_tracking_tagged_(void* state) {
+  ac_tracking_tag* tag = state;
+  return (ac_tracking_target_){tag->tracking, &tag->counters};
+}
+
+static inline ac_mem ac_tracking_tag_alloc2_(void* state, size_t cap) {
+  return ac_tracking_alloc_(ac_tracking_tagged_(state), cap);
+}
+
+static inline void ac_tracking_tag_free2_(void* state, ac_mem m) {
+  ac_tracking_free_(ac_tracking_tagged_(state), m);
+}
+
+static inline ac_mem ac_tracking_tag_realloc2_(void* state, ac_mem m,
+                                               size_t cap) {
+  return ac_tracking_realloc_(ac_tracking_tagged_(state), m, cap);
+}
+
+static inline ac_mem ac_tracking_tag_alloc2_aligned_(void* state, size_t align,
+                                                     size_t cap) {
+  return ac_tracking_alloc_aligned_(ac_tracking_tagged_(state), align, cap);
+}
+
+static inline void ac_tracking_counters_init_(ac_tracking_counters* c) {
+  atomic_init(&c->allocs, 0);
+  atomic_init(&c->frees, 0);
+  atomic_init(&c->reallocs, 0);
+  atomic_init(&c->failures, 0);
+  atomic_init(&c->live_bytes, 0);
+  atomic_init(&c->peak_bytes, 0);
+  atomic_init(&c->total_bytes, 0);
+  for (size_t i = 0; i < AC_TRACKING_BUCKETS; ++i) {
+    atomic_init(&c->histogram[i], 0);
+  }
+}
+
+static inline void ac_tracking_init(ac_tracking* t, ac_allocator2 inner) {
+  t->inner = ac_allocator2_is_empty(inner) ? ac_mallocator2() : inner;
+  ac_tracking_counters_init_(&t->counters);
+  atomic_init(&t->tags, NULL);
+}
+
+static inline ac_allocator2 ac_tracking_allocator2(ac_tracking* t) {
+  return (ac_allocator2){
+      .state = t,
+      .alloc = &ac_tracking_alloc2_,
+      .free = &ac_tracking_free2_,
+      .realloc = &ac_tracking_realloc2_,
+      .alloc_aligned = &ac_tracking_alloc2_aligned_,
+  };
+}
+
+static inline void ac_tracking_tag_init(ac_tracking_tag* tag, ac_tracking* t,
+                                        const char* name) {
+  tag->tracking = t;
+  tag->name = name;
+  ac_tracking_counters_init_(&tag->counters);
+  tag->next = atomic_load_explicit(&t->tags, memory_order_relaxed);
+  while (!atomic_compare_exchange_weak_explicit(
+      &t->tags, &tag->next, tag, memory_order_release, memory_order_relaxed)) {
+  }
+}
+
+static inline ac_allocator2 ac_tracking_tag_allocator2(ac_tracking_tag* tag) {
+  return (ac_allocator2){
+      .state = tag,
+      .alloc = &ac_tracking_tag_alloc2_,
+      .free = &ac_tracking_tag_free2_,
+      .realloc = &ac_tracking_tag_realloc2_,
+      .alloc_aligned = &ac_tracking_tag_alloc2_aligned_,
+  };
+}
+
+static inline ac_tracking_stats ac_tracking_stats_of(
+    const ac_tracking_counters* c) {
+  return (ac_tracking_stats){
+      .allocs = ac_tracking_load_(&c->allocs),
+      .frees = ac_tracking_load_(&c->frees),
+      .reallocs = ac_tracking_load_(&c->reallocs),
+      .failures = ac_tracking_load_(&c->failures),
+      .live_bytes = ac_tracking_load_(&c->live_bytes),
+      .peak_bytes = ac_tracking_load_(&c->peak_bytes),
+      .total_bytes = ac_tracking_load_(&c->total_bytes),
+  };
+}
+
+static inline void ac_tracking_stats_to_str_(ac_str* str,
+                                             const ac_tracking_counters* c) {
+  const ac_tracking_stats s = ac_tracking_stats_of(c);
+  ac_to_str(str,
+            "allocs: %zu  frees: %zu  reallocs: %zu  failures: %zu\n"
+            "live: %zu B  peak: %zu B  total: %zu B\n",
+            s.allocs, s.frees, s.reallocs, s.failures, s.live_bytes,
+            s.peak_bytes, s.total_bytes);
+}
+
+static inline void ac_tracking_to_str(ac_str* str, ac_tracking* t) {
+  ac_tracking_stats_to_str_(str, &t->counters);
+
+  ac_to_str(str, "sizes:\n");
+  for (size_t i = 0; i < AC_TRACKING_BUCKETS; ++i) {
+    const size_t n = ac_tracking_load_(&t->counters.histogram[i]);
+    if (!n) continue;
+    const size_t lo = i ? (size_t)1 << (i - 1) : 0;
+    ac_to_str(str, "  [%zu, %zu): %zu\n", lo, (size_t)1 << i, n);
+  }
+
+  ac_tracking_tag* tag = atomic_load_explicit(&t->tags, memory_order_acquire);
+  for (; tag; tag = tag->next) {
+    ac_to_str(str, "tag %s:\n", tag->name);
+    ac_tracking_stats_to_str_(str, &tag->counters);
+  }
+}
+
+#endif  // AC_TRACKING_H_
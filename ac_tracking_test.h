@@ -0,0 +1,110 @@
+#ifndef AC_TRACKING_TEST_H_
+#define AC_TRACKING_TEST_H_
+
+#include "ac_alloc.h"
+#include "ac_mem.h"
+#include "ac_str.h"
+#include "ac_test.h"
+#include "ac_tracking.h"
+
+//------------------------------------------------------------------------------
+// Allocation Tracking
+//------------------------------------------------------------------------------
+
+static inline void tracking_counts_lista_growth(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_tracking tracking;
+  ac_tracking_init(&tracking, (ac_allocator2){});
+
+  ac_lista(uint32_t) list = {.alloc = ac_tracking_allocator2(&tracking)};
+  for (uint32_t i = 0; i < 1000; ++i) *ac_lista_next_ex(&list) = i;
+
+  // One allocation, then a realloc for every doubling up to 1024.
+  ac_tracking_stats stats = ac_tracking_stats_of(&tracking.counters);
+  ac_test_equ(stats.allocs, 1);
+  ac_test_equ(stats.reallocs, 10);
+  ac_test_equ(stats.live_bytes, 1024 * sizeof(uint32_t));
+  ac_test_equ(stats.peak_bytes, 1024 * sizeof(uint32_t));
+  ac_test_equ(tracking.counters.histogram[3], 1);   // 4 bytes.
+  ac_test_equ(tracking.counters.histogram[13], 1);  // 4096 bytes.
+
+  ac_lista_free(&list);
+  stats = ac_tracking_stats_of(&tracking.counters);
+  ac_test_equ(stats.frees, 1);
+  ac_test_equ(stats.live_bytes, 0);
+  ac_test_equ(stats.peak_bytes, 1024 * sizeof(uint32_t));
+}
+
+static inline void tracking_counts_legacy_allocator(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_tracking tracking;
+  ac_tracking_init(&tracking, (ac_allocator2){});
+  ac_allocator2 tracked = ac_tracking_allocator2(&tracking);
+  ac_allocator alloc = ac_allocator_from2(&tracked);
+
+  // Each allocation also carries its header.
+  const size_t header = sizeof(ac_allocator_from2_header_);
+  ac_list(uint32_t) list = {};
+  ac_list_realloc(&list, &alloc, 16);
+  ac_list_realloc(&list, &alloc, 64);
+  ac_test_equ((uintptr_t)list.data % _Alignof(max_align_t), 0);
+  ac_tracking_stats stats = ac_tracking_stats_of(&tracking.counters);
+  ac_test_equ(stats.allocs, 2);
+  ac_test_equ(stats.frees, 1);
+  ac_test_equ(stats.live_bytes, 64 * sizeof(uint32_t) + header);
+
+  ac_free(&alloc, list.data);
+  stats = ac_tracking_stats_of(&tracking.counters);
+  ac_test_equ(stats.frees, 2);
+  ac_test_equ(stats.live_bytes, 0);
+}
+
+static inline void tracking_tags_and_report(ac_test_state* s) {
+  ac_test_begin(s);
+
+  ac_tracking tracking;
+  ac_tracking_init(&tracking, (ac_allocator2){});
+  static ac_tracking_tag parser;
+  static ac_tracking_tag printer;
+  ac_tracking_tag_init(&parser, &tracking, "parser");
+  ac_tracking_tag_init(&printer, &tracking, "printer");
+
+  ac_str a = ac_str_init(ac_tracking_tag_allocator2(&parser));
+  ac_str b = ac_str_init(ac_tracking_tag_allocator2(&printer));
+  ac_to_str(&a, "%s", "some text");
+  ac_to_str(&b, "%s", "more text");
+  ac_to_str(&b, "%s", ", and then some more text");
+  ac_str_free(&a);
+
+  const ac_tracking_stats p = ac_tracking_stats_of(&parser.counters);
+  const ac_tracking_stats q = ac_tracking_stats_of(&printer.counters);
+  const ac_tracking_stats t = ac_tracking_stats_of(&tracking.counters);
+  ac_test_equ(p.allocs, 1);
+  ac_test_equ(p.live_bytes, 0);
+  ac_test_equ(q.allocs + q.reallocs, 2);
+  ac_test_equ(q.live_bytes, b.cap);
+  ac_test_equ(t.allocs, p.allocs + q.allocs);
+  ac_test_equ(t.live_bytes, b.cap);
+
+  ac_str report = ac_str_init(ac_mallocator2());
+  ac_tracking_to_str(&report, &tracking);
+  ac_test_expect(strstr(report.data, "allocs: 2  frees: 1"),
+                 "Missing totals in:\n%s", report.data);
+  ac_test_expect(strstr(report.data, "tag parser:"), "Missing tag in:\n%s",
+                 report.data);
+  ac_test_expect(strstr(report.data, "[8, 16): 2"), "Missing sizes in:\n%s",
+                 report.data);
+  ac_str_free(&report);
+  ac_str_free(&b);
+}
+
+static inline void ac_tracking_test(ac_test_state* s) {
+  ac_test_begin(s);
+  ac_test_run(tracking_counts_lista_growth);
+  ac_test_run(tracking_counts_legacy_allocator);
+  ac_test_run(tracking_tags_and_report);
+}
+
+#endif  // AC_TRACKING_TEST_H_
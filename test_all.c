@@ -1,13 +1,39 @@
 #include "test_all.h"
 
 #include "ac_alloc.h"
+#include "ac_alloc_test.h"
+#include "ac_bitset_test.h"
+#include "ac_cpu_test.h"
+#include "ac_gzip_test.h"
+#include "ac_hash_test.h"
+#include "ac_hmap_test.h"
+#include "ac_intern_test.h"
+#include "ac_mem_test.h"
+#include "ac_ring_test.h"
+#include "ac_soa_test.h"
+#include "ac_sort_test.h"
 #include "ac_test.h"
 #include "ac_test_test.h"
+#include "ac_thread_test.h"
+#include "ac_tracking_test.h"
 
 int main(int argc, char** argv) {
   (void)argc;
   (void)argv;
   ac_test_init((ac_test_opts){});
   ac_test_run(ac_test_test);
+  ac_test_run(ac_alloc_test);
+  ac_test_run(ac_mem_test);
+  ac_test_run(ac_tracking_test);
+  ac_test_run(ac_hmap_test);
+  ac_test_run(ac_hash_test);
+  ac_test_run(ac_intern_test);
+  ac_test_run(ac_ring_test);
+  ac_test_run(ac_thread_test);
+  ac_test_run(ac_cpu_test);
+  ac_test_run(ac_bitset_test);
+  ac_test_run(ac_sort_test);
+  ac_test_run(ac_soa_test);
+  ac_test_run(ac_gzip_test);
   return ac_test_done() ? 0 : 1;
 }